@@ -0,0 +1,277 @@
+//
+// autotune.c
+//
+// autotuner for the sort thresholds: sweeps the quicksort_opt and
+// merge_sort_opt cutoffs on this machine and writes the fastest
+// combination to sorts_tuned.h (see "make autotune")
+//
+// the library objects it links with are built with -DSORT_AUTOTUNE,
+// which turns the thresholds in sorts.h into the fields of
+// sort_tunables
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h" /* elapsed */
+
+enum {
+  TUNE_NSIZES     = 3,
+  TUNE_REPS       = 3,   // best of this many runs per measurement
+  TUNE_MAX_VALS   = 16,
+  TUNE_MAX_PARAMS = 8
+};
+
+// a change is only kept if it's at least this much faster, so noise
+// doesn't move the thresholds around
+static const double TUNE_MIN_GAIN = 0.02;
+
+sort_tunables_t sort_tunables = {
+  .min_merge_sort_nelts   = TUNED_MIN_MERGE_SORT_NELTS,
+  .min_quicksort_nelts    = TUNED_MIN_QUICKSORT_NELTS,
+  .qsort_thread_threshold = TUNED_QSORT_THREAD_THRESHOLD,
+  .qsort_depth_factor     = TUNED_QSORT_DEPTH_FACTOR,
+  .qsort_base_case        = TUNED_QSORT_BASE_CASE
+};
+
+typedef enum {
+  TUNE_QSORT,
+  TUNE_QSORT_MT,
+  TUNE_MERGE
+} tune_sort_t;
+
+// one threshold to sweep, and the sort whose time it affects
+typedef struct {
+  const char  *name;
+  size_t      *field;
+  tune_sort_t  sort;
+  size_t       nvals;
+  size_t       vals[TUNE_MAX_VALS];
+} tune_param_t;
+
+static size_t   tune_sizes[TUNE_NSIZES] = { 64 * K, M, 16 * M };
+static long    *tune_orig;
+static long    *tune_data;
+static long    *tune_tmp;
+
+// best time of TUNE_REPS sorts of the first nelts random elements
+static double
+time_sort(tune_sort_t sort, size_t nelts)
+{
+  struct timeval tv_start, tv_end;
+  double best = 0, t;
+  int    rep;
+
+  for (rep = 0; rep < TUNE_REPS; rep++) {
+    memcpy(tune_data, tune_orig, nelts * sizeof(long));
+
+    gettimeofday(&tv_start, NULL);
+    switch (sort) {
+      case TUNE_QSORT:
+      quicksort_opt(tune_data, 0, nelts - 1, false);
+      break;
+
+      case TUNE_QSORT_MT:
+      quicksort_opt(tune_data, 0, nelts - 1, true);
+      break;
+
+      case TUNE_MERGE:
+      merge_sort_opt(tune_data, tune_tmp, 0, nelts - 1);
+      break;
+    }
+    gettimeofday(&tv_end, NULL);
+
+    if (!check_sort(tune_data, nelts)) {
+      printf("error: sort failed while tuning\n");
+      exit(-1);
+    }
+
+    t = elapsed(&tv_start, &tv_end);
+    if (rep == 0 || t < best)
+      best = t;
+  }
+
+  return best;
+}
+
+// the multithreaded sort is only timed at the largest size, the only
+// one where it spawns enough threads for the threshold to matter
+static bool
+timed(tune_sort_t sort, size_t s)
+{
+  return sort != TUNE_QSORT_MT || s == TUNE_NSIZES - 1;
+}
+
+// score of the current settings: the time of each size relative to
+// base[], summed (sizes that aren't timed count as 1)
+static double
+score(tune_sort_t sort, const double *base, double *times)
+{
+  double total = 0;
+  size_t s;
+
+  for (s = 0; s < TUNE_NSIZES; s++) {
+    times[s] = timed(sort, s) ? time_sort(sort, tune_sizes[s]) : base[s];
+    total += times[s] / base[s];
+  }
+
+  return total;
+}
+
+// sweep one parameter with all the others fixed; the fastest value is
+// kept if it beats the current one by TUNE_MIN_GAIN
+static void
+tune(tune_param_t *param, size_t best_per_size[][TUNE_NSIZES], size_t p)
+{
+  double base[TUNE_NSIZES], times[TUNE_NSIZES], best_times[TUNE_NSIZES];
+  size_t orig = *param->field;
+  size_t best = orig;
+  double best_score = 0, sc;
+  size_t v, s;
+
+  for (s = 0; s < TUNE_NSIZES; s++)
+    base[s] = 1.0;
+  score(param->sort, base, base);
+  for (s = 0; s < TUNE_NSIZES; s++) {
+    best_times[s] = base[s];
+    best_per_size[p][s] = orig;
+  }
+
+  printf("tuning %s (currently %zu)\n", param->name, orig);
+  for (v = 0; v < param->nvals; v++) {
+    *param->field = param->vals[v];
+    sc = score(param->sort, base, times);
+
+    printf("  %-10zu", param->vals[v]);
+    for (s = 0; s < TUNE_NSIZES; s++) {
+      if (!timed(param->sort, s))
+        printf(" %10s", "-");
+      else
+        printf(" %9.4fs", times[s]);
+    }
+    printf("   score %.3f\n", sc);
+
+    for (s = 0; s < TUNE_NSIZES; s++) {
+      if (timed(param->sort, s) && times[s] < best_times[s]) {
+        best_times[s] = times[s];
+        best_per_size[p][s] = param->vals[v];
+      }
+    }
+    if (v == 0 || sc < best_score) {
+      best_score = sc;
+      best = param->vals[v];
+    }
+  }
+
+  // the current value scores TUNE_NSIZES by definition
+  if (best_score > TUNE_NSIZES * (1 - TUNE_MIN_GAIN))
+    best = orig;
+
+  *param->field = best;
+  printf("  -> %zu\n\n", best);
+}
+
+static void
+write_header(const char *path, tune_param_t *params, size_t nparams,
+             size_t best_per_size[][TUNE_NSIZES])
+{
+  FILE  *f = fopen(path, "w");
+  char   host[256];
+  time_t now = time(NULL);
+  size_t p, s;
+
+  if (f == NULL) {
+    printf("error: cannot write %s\n", path);
+    exit(-1);
+  }
+
+  if (gethostname(host, sizeof(host)) != 0)
+    strcpy(host, "unknown");
+  host[sizeof(host) - 1] = '\0';
+
+  fprintf(f, "//\n// sorts_tuned.h\n//\n");
+  fprintf(f, "// generated by sorttune on %s, %s", host, ctime(&now));
+  fprintf(f, "// (\"make autotune\"); do not edit\n//\n");
+  fprintf(f, "// fastest value per size (");
+  for (s = 0; s < TUNE_NSIZES; s++)
+    fprintf(f, "%s%zu", s ? ", " : "", tune_sizes[s]);
+  fprintf(f, " elements):\n");
+  for (p = 0; p < nparams; p++) {
+    fprintf(f, "//   %-24s", params[p].name);
+    for (s = 0; s < TUNE_NSIZES; s++) {
+      if (!timed(params[p].sort, s))
+        fprintf(f, " %8s", "-");
+      else
+        fprintf(f, " %8zu", best_per_size[p][s]);
+    }
+    fprintf(f, "\n");
+  }
+  fprintf(f, "//\n\n#ifndef SORTS_TUNED_H\n#define SORTS_TUNED_H\n\n");
+  for (p = 0; p < nparams; p++)
+    fprintf(f, "#define TUNED_%-24s %zu\n", params[p].name, *params[p].field);
+  fprintf(f, "\n#endif /* SORTS_TUNED_H */\n");
+
+  fclose(f);
+}
+
+int main(int argc, char * argv[])
+{
+  const char *path = "sorts_tuned.h";
+  size_t      i, p, maxsize;
+  size_t      best_per_size[TUNE_MAX_PARAMS][TUNE_NSIZES];
+
+  tune_param_t params[] = {
+    { "QSORT_BASE_CASE", &sort_tunables.qsort_base_case, TUNE_QSORT,
+      2, { SORT_BASE_INSERTION, SORT_BASE_INSERTION_OPT } },
+    { "MIN_QUICKSORT_NELTS", &sort_tunables.min_quicksort_nelts, TUNE_QSORT,
+      9, { 8, 12, 16, 24, 32, 48, 64, 96, 128 } },
+    { "QSORT_DEPTH_FACTOR", &sort_tunables.qsort_depth_factor, TUNE_QSORT,
+      4, { 1, 2, 3, 4 } },
+    { "QSORT_THREAD_THRESHOLD", &sort_tunables.qsort_thread_threshold,
+      TUNE_QSORT_MT,
+      7, { 8 * K, 16 * K, 32 * K, 64 * K, 128 * K, 256 * K, M } },
+    { "MIN_MERGE_SORT_NELTS", &sort_tunables.min_merge_sort_nelts, TUNE_MERGE,
+      8, { 4, 8, 12, 16, 24, 32, 48, 64 } },
+  };
+  size_t nparams = sizeof(params) / sizeof(params[0]);
+
+  assert(nparams <= TUNE_MAX_PARAMS);
+
+  if (argc > 1)
+    path = argv[1];
+
+  maxsize = tune_sizes[TUNE_NSIZES - 1];
+  tune_orig = calloc(maxsize, sizeof(long));
+  tune_data = calloc(maxsize, sizeof(long));
+  tune_tmp = calloc(maxsize, sizeof(long));
+  if (tune_orig == NULL || tune_data == NULL || tune_tmp == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  srandom(1);
+  for (i = 0; i < maxsize; i++)
+    tune_orig[i] = random();
+
+  // coordinate descent: sweep each threshold with the others at their
+  // best value so far; the base case goes first since it changes the
+  // best cutoff
+  for (p = 0; p < nparams; p++)
+    tune(&params[p], best_per_size, p);
+
+  write_header(path, params, nparams, best_per_size);
+  printf("wrote %s; build with \"make clean; make TUNED=1\" to use it\n",
+         path);
+
+  free(tune_orig);
+  free(tune_data);
+  free(tune_tmp);
+  return 0;
+}
@@ -0,0 +1,67 @@
+//
+// bench.h
+//
+// declaration of the extra sortbench modes, and their timing helper
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h> /* size_t */
+#include <sys/time.h>
+#include "sorts.h"    /* sort_affinity_t */
+
+// seconds from tv_start to tv_end, as gettimeofday() gives them
+static inline double
+elapsed(struct timeval *tv_start, struct timeval *tv_end)
+{
+  return
+    (double)  (tv_end->tv_sec - tv_start->tv_sec) +
+    ((double) (tv_end->tv_usec - tv_start->tv_usec)) / 1E6;
+}
+
+// segmented sort of nelts elements with segment lengths drawn from
+// dist ("fixed", "small", "uniform" or "skewed")
+extern
+int segment_bench(size_t nelts, const char *dist);
+
+// sort_unique/sort_count of origdata[0 .. nelts - 1]
+extern
+int unique_bench(long *origdata, size_t nelts);
+
+// inserting batches of batch_nelts generated elements into the sorted
+// origdata[0 .. nelts - 1]
+extern
+int incremental_bench(long *origdata, size_t nelts, size_t batch_nelts);
+
+// thread scaling of the parallel sorts on origdata[0 .. nelts - 1],
+// with the sort threads placed on cpus according to affinity
+extern
+int scaling_bench(long *origdata, size_t nelts, sort_affinity_t affinity);
+
+// pipe_sort of nelts elements generated on the fly, against generating
+// them all and then sorting
+extern
+int pipe_bench(size_t nelts);
+
+// shm_sort of origdata[0 .. nelts - 1] at 1, 2, 4 ... ncpus processes
+extern
+int shm_bench(long *origdata, size_t nelts);
+
+// sort_doubles/sort_floats of nelts generated values against qsort
+extern
+int float_bench(size_t nelts);
+
+// the string sorts on nstrs generated strings, drawn from dataset
+// ("random", "prefix" or "url")
+extern
+int string_bench(size_t nstrs, const char *dataset);
+
+// read the integers in the text file inpath, sort them and write them
+// to outpath (only timed if outpath is NULL)
+extern
+int text_bench(const char *inpath, const char *outpath);
+
+#endif /* BENCH_H */
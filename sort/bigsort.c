@@ -0,0 +1,162 @@
+//
+// bigsort.c
+//
+// large-array regression benchmark: sorts more than 4G elements
+// through an mmap-backed buffer, to make sure nothing in the library
+// still truncates sizes or indices to 32 bits
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h" /* elapsed */
+
+enum {
+  // just past 4G elements, so that every index above UINT_MAX is used
+  DEFAULT_BIG_NELTS = 4L * K * M + 16 * M
+};
+
+static
+void usage()
+{
+  printf(
+         "usage:\n\n"
+         "bigsort [-n nelts] [-f file] [-s]\n\n"
+         "sort nelts random longs (default %ld, i.e., just past 4G elements)\n"
+         "in an anonymous mapping, or in a shared mapping of file if -f is\n"
+         "given (useful when nelts * 8 bytes doesn't fit in RAM);\n"
+         "-s sorts with a single thread\n\n",
+         (long) DEFAULT_BIG_NELTS);
+  exit(-1);
+}
+
+// map nelts longs, either anonymously or backed by path
+static long *
+map_data(size_t nelts, const char *path)
+{
+  size_t len = nelts * sizeof(long);
+  void  *p;
+  int    fd;
+
+  if (path == NULL) {
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p != MAP_FAILED)
+      madvise(p, len, MADV_HUGEPAGE);
+  }
+  else {
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+      printf("error: cannot open %s: %s\n", path, strerror(errno));
+      return NULL;
+    }
+    if (ftruncate(fd, (off_t) len) != 0) {
+      printf("error: cannot size %s: %s\n", path, strerror(errno));
+      close(fd);
+      return NULL;
+    }
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+  }
+
+  if (p == MAP_FAILED) {
+    printf("error: cannot map %zu bytes: %s\n", len, strerror(errno));
+    return NULL;
+  }
+
+  return (long *) p;
+}
+
+int main(int argc, char * argv[])
+{
+  struct timeval tv_start, tv_end;
+  size_t    nelts = DEFAULT_BIG_NELTS;
+  const char *path = NULL;
+  bool      multithread = true;
+  long     *data;
+  size_t    i;
+  uint64_t  x;
+  uint64_t  sum_before = 0;
+  uint64_t  sum_after;
+  char     *end;
+  int       argi;
+
+  for (argi = 1; argi < argc; argi++) {
+    if (strcmp(argv[argi], "-n") == 0 && argi + 1 < argc) {
+      nelts = strtoull(argv[++argi], &end, 10);
+      if (*end != '\0' || nelts < 2 || nelts > SIZE_MAX / sizeof(long))
+        usage();
+    }
+    else if (strcmp(argv[argi], "-f") == 0 && argi + 1 < argc) {
+      path = argv[++argi];
+    }
+    else if (strcmp(argv[argi], "-s") == 0) {
+      multithread = false;
+    }
+    else {
+      usage();
+    }
+  }
+
+  printf("main: sorting %zu elements (%.2f GB) in %s mapping\n\n", nelts,
+         (double) (nelts * sizeof(long)) / ((double) M * K),
+         path ? "a file-backed" : "an anonymous");
+
+  data = map_data(nelts, path);
+  if (data == NULL)
+    return -1;
+
+  // populate data: random() is far too slow for billions of elements,
+  // so use a xorshift generator, keeping random()'s 31-bit range; keep
+  // a wrapping sum as a cheap check that the sort is a permutation of
+  // the input
+  gettimeofday(&tv_start, NULL);
+  x = 88172645463325252ULL;
+  for (i = 0; i < nelts; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    data[i] = (long) (x >> 33);
+    sum_before += (uint64_t) data[i];
+  }
+  gettimeofday(&tv_end, NULL);
+  printf("populate: %.2f seconds\n", elapsed(&tv_start, &tv_end));
+
+  printf("sorting: sort method is quicksort opt%s\n", multithread ? " mt" : "");
+  gettimeofday(&tv_start, NULL);
+  quicksort_opt(data, 0, nelts - 1, multithread);
+  gettimeofday(&tv_end, NULL);
+  printf("finished: sorted %zu elements in %.2f seconds\n\n", nelts,
+         elapsed(&tv_start, &tv_end));
+
+  // NB: not check_sort(), which would print all 4G elements on failure
+  sum_after = (uint64_t) data[0];
+  for (i = 1; i < nelts; i++) {
+    if (data[i] < data[i - 1])
+      break;
+    sum_after += (uint64_t) data[i];
+  }
+
+  if (i < nelts) {
+    printf("**** large array is not sorted at element %zu\n", i);
+    return -1;
+  }
+  if (sum_before != sum_after) {
+    printf("**** large array is not a permutation of the input\n");
+    return -1;
+  }
+
+  printf("verified: data is sorted and is a permutation of the input\n");
+
+  munmap(data, nelts * sizeof(long));
+  return 0;
+}
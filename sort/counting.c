@@ -12,6 +12,8 @@
 #include <string.h> /* memset */
 #include <assert.h>
 #include "sorts.h"
+#include "sortstats.h"
+#include "kernels.h"
 
 // counting sort subroutine
 //
@@ -21,15 +23,15 @@
 // data_len: # of elements in data
 // tmpdata: array of integers for counting values in data
 // maxval: maximum value that is stored in data (minval is always 0)
-static void
-count_values(long *data, uint data_len, uint *tmpdata, uint maxval)
+SORT_KERNEL void
+count_values(long *data, size_t data_len, size_t *tmpdata, uint maxval)
 {
-  uint i;
-  long val;
-  uint tmpsz = maxval+1;
+  size_t i;
+  long   val;
+  size_t tmpsz = (size_t) maxval + 1;
 
   // first memset tmpdata
-  memset(tmpdata, 0, tmpsz * sizeof(long));
+  memset(tmpdata, 0, tmpsz * sizeof(size_t));
 
   // now fill tmpdata with counts of values in data
   for (i = 0; i < data_len; i++) {
@@ -52,25 +54,27 @@ count_values(long *data, uint data_len, uint *tmpdata, uint maxval)
 //   data is sorted
 
 void
-counting_sort(long *data, uint lo_ix, uint hi_ix, uint maxval)
+counting_sort(long *data, size_t lo_ix, size_t hi_ix, uint maxval)
 {
-  long nvals = maxval+1;
-  uint nelts = hi_ix - lo_ix + 1;
-  uint i, j;
-  uint val;
-  uint count;
+  size_t nvals = (size_t) maxval + 1;
+  size_t nelts = hi_ix - lo_ix + 1;
+  size_t i, j;
+  uint   val;
+  size_t count;
 
-  uint *tmpdata = calloc(nvals, sizeof(uint));
+  // NB: with more than 4G elements a single value can be seen more
+  // than UINT_MAX times, so the counts have to be size_t
+  size_t *tmpdata = calloc(nvals, sizeof(size_t));
 
   // first we count how many copies there are of each value;
   // store into tmpdata
-  count_values(data, nelts, tmpdata, maxval);
+  count_values(&data[lo_ix], nelts, tmpdata, maxval);
 
   // now we walk through the tmpdata array and use it to overwrite the
   // data array with the sorted numbers
 
   // iterate over tmpdata array
-  for (i = 0, j = 0; i <= nvals; i++) {
+  for (i = 0, j = lo_ix; i < nvals; i++) {
 
     // fill in data array
     val = i;
@@ -84,7 +88,8 @@ counting_sort(long *data, uint lo_ix, uint hi_ix, uint maxval)
 
   // sanity check: make sure we wrote the correct number of
   // elements into data[]
-  assert(j == nelts);
+  assert(j == hi_ix + 1);
+  SORT_STAT_ADD(bytes_moved, nelts * sizeof(long));
 
   // free our temp storage
   free(tmpdata);
@@ -0,0 +1,157 @@
+//
+// floatbench.c
+//
+// benchmarking sort_doubles/sort_floats against libc qsort with a
+// floating-point comparator
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+#include "sortstats.h"
+
+// the order sort_doubles sorts in: -0.0 before +0.0, NaNs last
+static int
+compare_double(const void *left, const void *right)
+{
+  double l = *(const double *) left;
+  double r = *(const double *) right;
+
+  if (isnan(l) || isnan(r))
+    return isnan(l) - isnan(r);
+  if (l != r)
+    return (l > r) - (l < r);
+  return (signbit(r) != 0) - (signbit(l) != 0);
+}
+
+static int
+compare_float(const void *left, const void *right)
+{
+  float l = *(const float *) left;
+  float r = *(const float *) right;
+
+  if (isnan(l) || isnan(r))
+    return isnan(l) - isnan(r);
+  if (l != r)
+    return (l > r) - (l < r);
+  return (signbit(r) != 0) - (signbit(l) != 0);
+}
+
+// mixed-sign values over a wide range of magnitudes, with a sprinkling
+// of zeros of both signs, infinities and NaNs
+static double
+random_double(void)
+{
+  long r = random() % 1000;
+
+  switch (r) {
+    case 0: return -0.0;
+    case 1: return 0.0;
+    case 2: return -INFINITY;
+    case 3: return INFINITY;
+    case 4: return NAN;
+  }
+
+  return ((double) random() / RAND_MAX - 0.5) * pow(10.0, random() % 40 - 20);
+}
+
+int
+float_bench(size_t nelts)
+{
+  struct timeval tv_start, tv_end;
+  double *ddata, *dorig, *dcmp;
+  float  *fdata, *forig, *fcmp;
+  size_t  i;
+  int     method;
+  bool    same;
+
+  ddata = calloc(nelts, sizeof(double));
+  dorig = calloc(nelts, sizeof(double));
+  dcmp = calloc(nelts, sizeof(double));
+  fdata = calloc(nelts, sizeof(float));
+  forig = calloc(nelts, sizeof(float));
+  fcmp = calloc(nelts, sizeof(float));
+  if (ddata == NULL || dorig == NULL || dcmp == NULL ||
+      fdata == NULL || forig == NULL || fcmp == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  for (i = 0; i < nelts; i++) {
+    dorig[i] = random_double();
+    forig[i] = (float) dorig[i];
+  }
+
+  for (method = 0; method < 6; method++) {
+    memcpy(ddata, dorig, nelts * sizeof(double));
+    memcpy(fdata, forig, nelts * sizeof(float));
+
+    sort_stats_reset();
+    gettimeofday(&tv_start, NULL);
+    switch (method) {
+      case 0:
+      printf("sorting: sort method is libc qsort() of doubles\n");
+      qsort(ddata, nelts, sizeof(double), &compare_double);
+      break;
+
+      case 1:
+      printf("sorting: sort method is sort_doubles\n");
+      sort_doubles(ddata, nelts, false);
+      break;
+
+      case 2:
+      printf("sorting: sort method is sort_doubles mt\n");
+      sort_doubles(ddata, nelts, true);
+      break;
+
+      case 3:
+      printf("sorting: sort method is libc qsort() of floats\n");
+      qsort(fdata, nelts, sizeof(float), &compare_float);
+      break;
+
+      case 4:
+      printf("sorting: sort method is sort_floats\n");
+      sort_floats(fdata, nelts, false);
+      break;
+
+      case 5:
+      printf("sorting: sort method is sort_floats mt\n");
+      sort_floats(fdata, nelts, true);
+      break;
+    }
+    gettimeofday(&tv_end, NULL);
+
+    // qsort's result is the reference (all the NaNs have the same bits,
+    // so their order doesn't matter)
+    if (method == 0)
+      memcpy(dcmp, ddata, nelts * sizeof(double));
+    else if (method == 3)
+      memcpy(fcmp, fdata, nelts * sizeof(float));
+
+    if (method < 3)
+      same = (memcmp(dcmp, ddata, nelts * sizeof(double)) == 0);
+    else
+      same = (memcmp(fcmp, fdata, nelts * sizeof(float)) == 0);
+    if (!same)
+      printf("\n**** sorted data is different than qsort's!\n");
+
+    printf("finished: sorted %zu elements in %.2f seconds\n", nelts,
+           elapsed(&tv_start, &tv_end));
+    sort_stats_print();
+    printf("\n");
+  }
+
+  free(ddata);
+  free(dorig);
+  free(dcmp);
+  free(fdata);
+  free(forig);
+  free(fcmp);
+  return 0;
+}
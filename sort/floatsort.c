@@ -0,0 +1,154 @@
+//
+// floatsort.c
+//
+// sorting doubles and floats with the integer sorts: every value is
+// mapped to a long whose order is the value's (-inf < ... < -0.0 <
+// +0.0 < ... < +inf), radix sorted, and mapped back. NaNs don't
+// compare with anything, so they're moved to the end first, untouched
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <stdint.h>
+#include <math.h>   /* isnan */
+#include <assert.h>
+#include "sorts.h"
+
+// a negative float's bits order backwards, so flip all but the sign bit
+static inline long
+double_to_key(double d)
+{
+  int64_t bits;
+
+  memcpy(&bits, &d, sizeof(bits));
+  return (long) (bits ^ ((bits >> 63) & INT64_MAX));
+}
+
+static inline double
+key_to_double(long key)
+{
+  int64_t bits = (int64_t) key;
+  double  d;
+
+  bits ^= (bits >> 63) & INT64_MAX;
+  memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+// floats map to [0 .. 2^32), so the radix sort skips the upper passes
+static inline long
+float_to_key(float f)
+{
+  int32_t bits;
+
+  memcpy(&bits, &f, sizeof(bits));
+  return (long) ((uint32_t) (bits ^ ((bits >> 31) & INT32_MAX)) ^ 0x80000000U);
+}
+
+static inline float
+key_to_float(long key)
+{
+  int32_t bits = (int32_t) ((uint32_t) key ^ 0x80000000U);
+  float   f;
+
+  bits ^= (bits >> 31) & INT32_MAX;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// move the NaNs in data[0 .. nelts - 1] to the end, returning how many
+// elements are left in front of them
+static size_t
+nans_to_end_double(double *data, size_t nelts)
+{
+  size_t i = 0, j = nelts;
+  double t;
+
+  while (i < j) {
+    if (!isnan(data[i])) {
+      i++;
+    }
+    else {
+      j--;
+      t = data[i];
+      data[i] = data[j];
+      data[j] = t;
+    }
+  }
+
+  return i;
+}
+
+static size_t
+nans_to_end_float(float *data, size_t nelts)
+{
+  size_t i = 0, j = nelts;
+  float  t;
+
+  while (i < j) {
+    if (!isnan(data[i])) {
+      i++;
+    }
+    else {
+      j--;
+      t = data[i];
+      data[i] = data[j];
+      data[j] = t;
+    }
+  }
+
+  return i;
+}
+
+// sort data[0 .. nelts - 1] in ascending order, -0.0 before +0.0, NaNs
+// (in no particular order) at the end
+void
+sort_doubles(double *data, size_t nelts, bool multithread)
+{
+  long  *keys, *tmpkeys;
+  size_t n, i;
+
+  n = nans_to_end_double(data, nelts);
+  if (n < 2)
+    return;
+
+  keys = malloc(n * sizeof(long));
+  tmpkeys = malloc(n * sizeof(long));
+  assert(keys != NULL && tmpkeys != NULL);
+
+  for (i = 0; i < n; i++)
+    keys[i] = double_to_key(data[i]);
+  radix_sort(keys, tmpkeys, n, multithread);
+  for (i = 0; i < n; i++)
+    data[i] = key_to_double(keys[i]);
+
+  free(keys);
+  free(tmpkeys);
+}
+
+// as sort_doubles, for floats
+void
+sort_floats(float *data, size_t nelts, bool multithread)
+{
+  long  *keys, *tmpkeys;
+  size_t n, i;
+
+  n = nans_to_end_float(data, nelts);
+  if (n < 2)
+    return;
+
+  keys = malloc(n * sizeof(long));
+  tmpkeys = malloc(n * sizeof(long));
+  assert(keys != NULL && tmpkeys != NULL);
+
+  for (i = 0; i < n; i++)
+    keys[i] = float_to_key(data[i]);
+  radix_sort(keys, tmpkeys, n, multithread);
+  for (i = 0; i < n; i++)
+    data[i] = key_to_float(keys[i]);
+
+  free(keys);
+  free(tmpkeys);
+}
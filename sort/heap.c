@@ -7,16 +7,46 @@
 //
 
 #include "sorts.h"
+#include "kernels.h"
+
+// insert operation: push t down the heap arr[0 .. n - 1] from index,
+// moving larger children up, until it can replace the parent
+SORT_KERNEL void
+heap_sift_down(long *arr, size_t n, size_t index, long t)
+{
+  size_t child = index * 2 + 1; // get its left child index
+
+  while (child < n) {
+    // choose the largest child
+    if ((child + 1 < n)  &&
+        // (arr[child + 1] > arr[child])
+        (compare(&(arr[child + 1]), &(arr[child])) > 0)) {
+      child++; // right child exists and is bigger
+    }
+
+    // is the largest child larger than the entry?
+    if (// (arr[child] > t)
+        compare(&(arr[child]), &t) > 0) {
+      arr[index] = arr[child]; // overwrite entry with child
+      index = child;           // move index to the child
+      child = index * 2 + 1;   // get the left child and go around again
+    }
+    else {
+      break; // we found where t belongs
+    }
+  }
+
+  // store the temporary value at its new location
+  arr[index] = t;
+}
 
 // basic heapsort without recursion
-void heapsort(long *arr, uint lo_ix, uint hi_ix)
+void heapsort(long *arr, size_t lo_ix, size_t hi_ix)
 {
-  long t; /* the temporary value */
-  uint nelts = hi_ix - lo_ix + 1;
-  int  n = nelts;
-  uint parent = n / 2;
-  uint index;
-  uint child;
+  long   t; /* the temporary value */
+  size_t nelts = hi_ix - lo_ix + 1;
+  size_t n = nelts;
+  size_t parent = n / 2;
 
   // loop until array is sorted
   while (true) {
@@ -35,30 +65,6 @@ void heapsort(long *arr, uint lo_ix, uint hi_ix)
       arr[n] = arr[0];    // save root entry beyond heap
     }
 
-    // insert operation: pushing t down the heap to replace the parent
-    index = parent;        // start at the parent index
-    child = index * 2 + 1; // get its left child index
-    while (child < n) {
-      // choose the largest child
-      if ((child + 1 < n)  &&
-          // (arr[child + 1] > arr[child])
-          (compare(&(arr[child + 1]), &(arr[child])) > 0)) {
-        child++; // right child exists and is bigger
-      }
-
-      // is the largest child larger than the entry?
-      if (// (arr[child] > t)
-          compare(&(arr[child]), &t) > 0) {
-        arr[index] = arr[child]; // overwrite entry with child
-        index = child;           // move index to the child
-        child = index * 2 + 1;   // get the left child and go around again
-      }
-      else {
-        break; // we found where t belongs
-      }
-    }
-
-    // store the temporary value at its new location
-    arr[index] = t;
+    heap_sift_down(arr, n, parent, t);
   }
 }
@@ -0,0 +1,171 @@
+//
+// incbench.c
+//
+// benchmarking batched inserts into a sorted array: re-sorting after
+// every batch, sorted_insert_batch, and the log-structured sorted_lsm_t,
+// by insert throughput and by the latency of lookups afterwards
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+#include "sortstats.h"
+
+enum {
+  INC_NBATCHES = 16,
+  INC_NQUERIES = M
+};
+
+static bool
+array_contains(const long *data, size_t nelts, long val)
+{
+  size_t lo = 0, hi = nelts, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (data[mid] < val)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo < nelts && data[lo] == val;
+}
+
+int
+incremental_bench(long *origdata, size_t nelts, size_t batch_nelts)
+{
+  struct timeval tv_start, tv_end;
+  sorted_lsm_t *lsm = NULL;
+  const long   *sorted;
+  long   *data, *batches, *batch, *queries;
+  size_t  total = nelts + INC_NBATCHES * batch_nelts;
+  size_t  b, i, n, found;
+  uint64_t fingerprint;
+  double  secs;
+  int     method;
+
+  data = calloc(total, sizeof(long));
+  batches = calloc(INC_NBATCHES * batch_nelts, sizeof(long));
+  batch = calloc(batch_nelts, sizeof(long));
+  queries = calloc(INC_NQUERIES, sizeof(long));
+  if (data == NULL || batches == NULL || batch == NULL || queries == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  for (i = 0; i < INC_NBATCHES * batch_nelts; i++)
+    batches[i] = random();
+  for (i = 0; i < INC_NQUERIES; i++)
+    queries[i] = random();
+
+  // fingerprints add up, so the result's is the base's plus the batches'
+  fingerprint = sort_fingerprint(origdata, nelts) +
+                sort_fingerprint(batches, INC_NBATCHES * batch_nelts);
+
+  printf("inserting: %d batches of %zu elements into %zu sorted elements\n\n",
+         INC_NBATCHES, batch_nelts, nelts);
+
+  for (method = 0; method < 4; method++) {
+    memcpy(data, origdata, nelts * sizeof(long));
+    quicksort_opt(data, 0, nelts - 1, true);
+    n = nelts;
+    if (method == 3) {
+      lsm = sorted_lsm_create();
+      sorted_lsm_insert(lsm, data, nelts, true);
+    }
+
+    switch (method) {
+      case 0:
+      printf("inserting: method is append + quicksort opt mt\n");
+      break;
+
+      case 1:
+      printf("inserting: method is sorted_insert_batch\n");
+      break;
+
+      case 2:
+      printf("inserting: method is sorted_insert_batch mt\n");
+      break;
+
+      case 3:
+      printf("inserting: method is sorted_lsm_insert mt\n");
+      break;
+    }
+
+    sort_stats_reset();
+    gettimeofday(&tv_start, NULL);
+    for (b = 0; b < INC_NBATCHES; b++) {
+      memcpy(batch, &batches[b * batch_nelts], batch_nelts * sizeof(long));
+      switch (method) {
+        case 0:
+        memcpy(&data[n], batch, batch_nelts * sizeof(long));
+        quicksort_opt(data, 0, n + batch_nelts - 1, true);
+        break;
+
+        case 1:
+        sorted_insert_batch(data, n, batch, batch_nelts, false);
+        break;
+
+        case 2:
+        sorted_insert_batch(data, n, batch, batch_nelts, true);
+        break;
+
+        case 3:
+        sorted_lsm_insert(lsm, batch, batch_nelts, true);
+        break;
+      }
+      n += batch_nelts;
+    }
+    gettimeofday(&tv_end, NULL);
+
+    secs = elapsed(&tv_start, &tv_end);
+    printf("finished: inserted %zu elements in %.3f seconds "
+           "(%.1f M elements/s)\n", INC_NBATCHES * batch_nelts, secs,
+           INC_NBATCHES * batch_nelts / secs / 1E6);
+    sort_stats_print();
+
+    // lookups go through every level of the lsm
+    found = 0;
+    gettimeofday(&tv_start, NULL);
+    for (i = 0; i < INC_NQUERIES; i++) {
+      if (method == 3)
+        found += sorted_lsm_contains(lsm, queries[i]);
+      else
+        found += array_contains(data, n, queries[i]);
+    }
+    gettimeofday(&tv_end, NULL);
+    printf("queries: %d lookups (%zu found), %.1f ns per lookup",
+           INC_NQUERIES, found, elapsed(&tv_start, &tv_end) * 1E9 / INC_NQUERIES);
+    if (method == 3)
+      printf(" over %zu levels", lsm->nlevels);
+    printf("\n");
+
+    sorted = data;
+    if (method == 3) {
+      gettimeofday(&tv_start, NULL);
+      sorted = sorted_lsm_compact(lsm, &n, true);
+      gettimeofday(&tv_end, NULL);
+      printf("compact: merged all levels in %.3f seconds\n",
+             elapsed(&tv_start, &tv_end));
+    }
+
+    if (n != total || !check_sort_perm(sorted, n, fingerprint))
+      printf("\n**** sorted data is not the base plus the batches!\n");
+
+    if (method == 3)
+      sorted_lsm_free(lsm);
+    printf("\n");
+  }
+
+  free(data);
+  free(batches);
+  free(batch);
+  free(queries);
+  return 0;
+}
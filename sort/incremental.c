@@ -0,0 +1,369 @@
+//
+// incremental.c
+//
+// keeping an array sorted as batches of new elements arrive: each
+// batch is sorted and merged into the array in place, from the back,
+// instead of re-sorting everything; and a log-structured variant that
+// keeps a few sorted levels of growing size and only merges a level
+// into the next one when it gets too big
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdlib.h>
+#include <string.h> /* memcpy, memmove */
+#include <assert.h>
+#include <pthread.h>
+#include "sorts.h"
+#include "sortstats.h"
+
+// one thread's slice of a parallel merge: base[i_lo .. i_hi - 1] and
+// batch[j_lo .. j_hi - 1] merge into base[i_lo + j_lo .. i_hi + j_hi - 1]
+typedef struct {
+  long       *base;
+  const long *batch;
+  long       *saved;     // room for the first nsaved of our base elements
+  size_t      i_lo, i_hi;
+  size_t      j_lo, j_hi;
+  size_t      nsaved;
+  pthread_barrier_t *barrier;
+} insert_info_t;
+
+// how many of the first k merged elements of a[0 .. na - 1] and
+// b[0 .. nb - 1] come from a (a's elements go first on ties)
+static size_t
+co_rank(size_t k, const long *a, size_t na, const long *b, size_t nb)
+{
+  size_t lo = (k > nb) ? k - nb : 0;
+  size_t hi = (k < na) ? k : na;
+  size_t i;
+
+  while (lo < hi) {
+    i = lo + (hi - lo) / 2;
+    if (a[i] <= b[k - i - 1])
+      lo = i + 1;
+    else
+      hi = i;
+  }
+
+  return lo;
+}
+
+// merge the sorted batch[0 .. m - 1] into base[0 .. n - 1], which has
+// room for n + m elements: filling it from the back, every base
+// element is read before its slot is written
+static void
+merge_back(long *base, size_t n, const long *batch, size_t m)
+{
+  size_t i = n, j = m, k = n + m;
+
+  while (j > 0) {
+    if (i > 0 && base[i - 1] > batch[j - 1])
+      base[--k] = base[--i];
+    else
+      base[--k] = batch[--j];
+  }
+
+  // base[0 .. i - 1] is already where it belongs
+  SORT_STAT_ADD(bytes_moved, (n + m - i) * sizeof(long));
+}
+
+static void
+merge_slice(insert_info_t *info)
+{
+  long       *base = info->base;
+  const long *batch = info->batch;
+  size_t      i = info->i_hi, j = info->j_hi, k = info->i_hi + info->j_hi;
+  size_t      split = info->i_lo + info->nsaved;
+  long        a;
+
+  // the slices below us write over the start of our part of base, so
+  // it's saved before anyone starts writing
+  memcpy(info->saved, &base[info->i_lo], info->nsaved * sizeof(long));
+  pthread_barrier_wait(info->barrier);
+
+  while (j > info->j_lo && i > info->i_lo) {
+    a = (i > split) ? base[i - 1] : info->saved[i - 1 - info->i_lo];
+    if (a > batch[j - 1]) {
+      base[--k] = a;
+      i--;
+    }
+    else {
+      base[--k] = batch[--j];
+    }
+  }
+
+  // whatever's left of one of the inputs goes in front of that, shifted
+  // up by j_lo if it's from base
+  if (j > info->j_lo) {
+    memcpy(&base[i + info->j_lo], &batch[info->j_lo],
+           (j - info->j_lo) * sizeof(long));
+  }
+  else if (info->j_lo > 0) {
+    if (i > split)
+      memmove(&base[split + info->j_lo], &base[split], (i - split) * sizeof(long));
+    memcpy(&base[info->i_lo + info->j_lo], info->saved,
+           ((i < split) ? i - info->i_lo : info->nsaved) * sizeof(long));
+  }
+
+  SORT_STAT_ADD(bytes_moved, (info->i_hi + info->j_hi - info->i_lo - info->j_lo) *
+                sizeof(long));
+}
+
+static void *
+merge_slice_thread(void *arg)
+{
+  sort_thread_start();
+  merge_slice((insert_info_t *) arg);
+  sort_thread_end();
+
+  return NULL;
+}
+
+// merge_back with the output split evenly among threads, each slice's
+// inputs found by binary search; the only scratch space is for the
+// base elements a slice has to save from the slices below it, at most
+// m per thread
+static void
+merge_back_mt(long *base, size_t n, const long *batch, size_t m,
+              size_t nthreads)
+{
+  insert_info_t    *info;
+  pthread_t        *threads;
+  pthread_barrier_t barrier;
+  long             *saved;
+  size_t            t, k, nsaved = 0;
+  int               rc;
+
+  info = malloc(nthreads * sizeof(insert_info_t));
+  threads = malloc(nthreads * sizeof(pthread_t));
+  assert(info != NULL && threads != NULL);
+
+  for (t = 0; t < nthreads; t++) {
+    k = (n + m) / nthreads * t;
+    info[t].base = base;
+    info[t].batch = batch;
+    info[t].i_lo = co_rank(k, base, n, batch, m);
+    info[t].j_lo = k - info[t].i_lo;
+    info[t].barrier = &barrier;
+    if (t > 0) {
+      info[t - 1].i_hi = info[t].i_lo;
+      info[t - 1].j_hi = info[t].j_lo;
+    }
+  }
+  info[nthreads - 1].i_hi = n;
+  info[nthreads - 1].j_hi = m;
+
+  for (t = 0; t < nthreads; t++) {
+    info[t].nsaved = info[t].i_hi - info[t].i_lo;
+    if (info[t].nsaved > info[t].j_lo)
+      info[t].nsaved = info[t].j_lo;
+    nsaved += info[t].nsaved;
+  }
+
+  saved = malloc((nsaved > 0 ? nsaved : 1) * sizeof(long));
+  assert(saved != NULL);
+  for (t = 0, nsaved = 0; t < nthreads; t++) {
+    info[t].saved = &saved[nsaved];
+    nsaved += info[t].nsaved;
+  }
+
+  pthread_barrier_init(&barrier, NULL, (unsigned) nthreads);
+
+  // the calling thread takes slice 0
+  for (t = 1; t < nthreads; t++) {
+    rc = pthread_create(&threads[t], NULL, &merge_slice_thread, &info[t]);
+    assert(rc == 0);
+    SORT_STAT_ADD(thread_spawns, 1);
+  }
+  merge_slice(&info[0]);
+  for (t = 1; t < nthreads; t++)
+    pthread_join(threads[t], NULL);
+
+  pthread_barrier_destroy(&barrier);
+  free(saved);
+  free(info);
+  free(threads);
+}
+
+// merge the sorted batch[0 .. m - 1] into the sorted base[0 .. n - 1]
+static void
+merge_sorted_batch(long *base, size_t n, const long *batch, size_t m,
+                   bool multithread)
+{
+  size_t nthreads = 1;
+
+  if (m == 0)
+    return;
+
+  // batches that go entirely after the base are just appended
+  if (n == 0 || base[n - 1] <= batch[0]) {
+    memcpy(&base[n], batch, m * sizeof(long));
+    SORT_STAT_ADD(bytes_moved, m * sizeof(long));
+    return;
+  }
+
+  if (multithread && m >= SORTED_INSERT_THREAD_NELTS) {
+    nthreads = sort_get_threads();
+    if (nthreads > (n + m) / SORTED_INSERT_THREAD_NELTS)
+      nthreads = (n + m) / SORTED_INSERT_THREAD_NELTS;
+  }
+
+  if (nthreads > 1)
+    merge_back_mt(base, n, batch, m, nthreads);
+  else
+    merge_back(base, n, batch, m);
+}
+
+// insert batch[0 .. m - 1] into the sorted base[0 .. n - 1], which must
+// have room for n + m elements, leaving base[0 .. n + m - 1] sorted;
+// the batch is sorted in place along the way
+void
+sorted_insert_batch(long *base, size_t n, long *batch, size_t m,
+                    bool multithread)
+{
+  radix_sort(batch, NULL, m, multithread);
+  merge_sorted_batch(base, n, batch, m, multithread);
+}
+
+// most elements level l of a sorted_lsm_t holds before it's merged
+// into level l + 1; the last level holds any number
+static size_t
+lsm_level_capacity(size_t l)
+{
+  size_t cap = SORTED_LSM_BASE_NELTS;
+
+  if (l == SORTED_LSM_MAX_LEVELS - 1)
+    return SIZE_MAX;
+  while (l-- > 0)
+    cap *= SORTED_LSM_RATIO;
+
+  return cap;
+}
+
+// merge level src into level dst and empty src
+static void
+lsm_merge_level(sorted_lsm_t *lsm, size_t src, size_t dst, bool multithread)
+{
+  lsm->level[dst] = realloc(lsm->level[dst],
+                            (lsm->nelts[dst] + lsm->nelts[src]) * sizeof(long));
+  assert(lsm->level[dst] != NULL);
+
+  merge_sorted_batch(lsm->level[dst], lsm->nelts[dst], lsm->level[src],
+                     lsm->nelts[src], multithread);
+  lsm->nelts[dst] += lsm->nelts[src];
+  lsm->nelts[src] = 0;
+  if (dst >= lsm->nlevels)
+    lsm->nlevels = dst + 1;
+}
+
+// first index of data[0 .. n - 1] whose element is >= val (or > val
+// with after)
+static size_t
+lsm_search(const long *data, size_t n, long val, bool after)
+{
+  size_t lo = 0, hi = n, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (data[mid] < val || (after && data[mid] == val))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+// an empty log-structured sorted array
+sorted_lsm_t *
+sorted_lsm_create(void)
+{
+  sorted_lsm_t *lsm = calloc(1, sizeof(sorted_lsm_t));
+
+  assert(lsm != NULL);
+  return lsm;
+}
+
+void
+sorted_lsm_free(sorted_lsm_t *lsm)
+{
+  size_t l;
+
+  for (l = 0; l < SORTED_LSM_MAX_LEVELS; l++)
+    free(lsm->level[l]);
+  free(lsm);
+}
+
+// add batch[0 .. m - 1] (sorting it in place): it's merged into level
+// 0, and a level that outgrows its capacity is merged into the next
+// one, so an element is moved about once per level rather than once
+// per insert
+void
+sorted_lsm_insert(sorted_lsm_t *lsm, long *batch, size_t m, bool multithread)
+{
+  size_t l;
+
+  radix_sort(batch, NULL, m, multithread);
+
+  lsm->level[0] = realloc(lsm->level[0], (lsm->nelts[0] + m) * sizeof(long));
+  assert(lsm->level[0] != NULL);
+  merge_sorted_batch(lsm->level[0], lsm->nelts[0], batch, m, multithread);
+  lsm->nelts[0] += m;
+  if (lsm->nlevels == 0)
+    lsm->nlevels = 1;
+
+  for (l = 0; l < SORTED_LSM_MAX_LEVELS - 1; l++) {
+    if (lsm->nelts[l] <= lsm_level_capacity(l))
+      break;
+    lsm_merge_level(lsm, l, l + 1, multithread);
+  }
+}
+
+// number of elements in [lo .. hi]
+size_t
+sorted_lsm_count(const sorted_lsm_t *lsm, long lo, long hi)
+{
+  size_t l, count = 0;
+
+  if (lo > hi)
+    return 0;
+
+  for (l = 0; l < lsm->nlevels; l++) {
+    count += lsm_search(lsm->level[l], lsm->nelts[l], hi, true) -
+             lsm_search(lsm->level[l], lsm->nelts[l], lo, false);
+  }
+
+  return count;
+}
+
+bool
+sorted_lsm_contains(const sorted_lsm_t *lsm, long val)
+{
+  size_t l, idx;
+
+  for (l = 0; l < lsm->nlevels; l++) {
+    idx = lsm_search(lsm->level[l], lsm->nelts[l], val, false);
+    if (idx < lsm->nelts[l] && lsm->level[l][idx] == val)
+      return true;
+  }
+
+  return false;
+}
+
+// merge all the levels into one and return it (sorted, *nelts long);
+// the array belongs to lsm and is valid until the next insert
+const long *
+sorted_lsm_compact(sorted_lsm_t *lsm, size_t *nelts, bool multithread)
+{
+  size_t l, last = (lsm->nlevels > 0) ? lsm->nlevels - 1 : 0;
+
+  // smallest levels first, so the big ones are only merged into once
+  for (l = 0; l < last; l++) {
+    if (lsm->nelts[l] > 0)
+      lsm_merge_level(lsm, l, l + 1, multithread);
+  }
+
+  *nelts = lsm->nelts[last];
+  return lsm->level[last];
+}
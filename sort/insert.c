@@ -9,11 +9,13 @@
 #include <string.h> /* memmove */
 #include <stdio.h>
 #include "sorts.h"
+#include "sortstats.h"
+#include "kernels.h"
 
 // basic insertion sort, no binary search
-void insertion_sort(long *data, uint lo_ix, uint hi_ix)
+void insertion_sort(long *data, size_t lo_ix, size_t hi_ix)
 {
-  uint i, j;
+  size_t i, j;
   long tmp_elem;
 
   for (i = lo_ix + 1; i <= hi_ix; i++) {
@@ -24,6 +26,7 @@ void insertion_sort(long *data, uint lo_ix, uint hi_ix)
       data[j] = data[j - 1];
       j--;
     }
+    SORT_STAT_ADD(bytes_moved, (i - j) * sizeof(long));
 
     data[j] = tmp_elem;
   }
@@ -31,12 +34,12 @@ void insertion_sort(long *data, uint lo_ix, uint hi_ix)
 
 // use binary search to find the place for val in the
 // array data[lo_ix ... hi_ix]
-int bsearch_find_idx(long *data, uint lo_ix, uint hi_ix, long val)
+size_t bsearch_find_idx(long *data, size_t lo_ix, size_t hi_ix, long val)
 {
-  uint idx;
-  long loc;
-  uint hi = hi_ix;
-  uint lo = lo_ix;
+  size_t idx;
+  long   loc;
+  size_t hi = hi_ix;
+  size_t lo = lo_ix;
 
   // handle base cases where val is < all elts or > all elts
 
@@ -80,16 +83,16 @@ int bsearch_find_idx(long *data, uint lo_ix, uint hi_ix, long val)
 }
 
 // improved insertion sort, uses binary search and memmove
-void insertion_sort_opt(long *data, uint lo_ix, uint hi_ix)
+void insertion_sort_opt(long *data, size_t lo_ix, size_t hi_ix)
 {
-  uint i, j;
-  long tmp_elem;
-  uint idx;
+  size_t i;
+  long   tmp_elem;
+  size_t idx;
 
   for (i = lo_ix+1; i <= hi_ix; i++) {
     tmp_elem = data[i];
 
-    idx = bsearch_find_idx(data, 0, i-1, tmp_elem);
+    idx = bsearch_find_idx(data, lo_ix, i-1, tmp_elem);
 
     // if this is not the largest element found so far
     // then we have to move part of the existing array
@@ -97,6 +100,7 @@ void insertion_sort_opt(long *data, uint lo_ix, uint hi_ix)
     // don't have to move it, it's already where it belongs
     if (idx < i) {
       memmove(&data[idx+1], &data[idx], sizeof(long)*(i - 1 - idx + 1));
+      SORT_STAT_ADD(bytes_moved, sizeof(long)*(i - 1 - idx + 1));
       data[idx] = tmp_elem;
     }
   }
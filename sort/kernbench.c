@@ -0,0 +1,310 @@
+//
+// kernbench.c
+//
+// microbenchmark of the sort kernels in isolation: each one is timed
+// on arrays sized to fit in L1, L2, the last-level cache and only in
+// DRAM, reporting ns and cycles (timestamp counter ticks) per element
+//
+// usage: sortkernels [kernel ...] (all of them if none are named)
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> /* __rdtsc */
+#endif
+#include "sorts.h"
+#include "kernels.h"
+
+enum {
+  // every size is run until at least this many elements (or lookups)
+  // have been processed, and at least KERN_MIN_REPS times
+  KERN_MIN_ELTS   = 16 * M,
+  KERN_MIN_REPS   = 3,
+  // values for the counting-sort histogram (8K of counts)
+  KERN_COUNT_VALS = K,
+  // lookups per rep for bsearch_find_idx
+  KERN_LOOKUPS    = 64 * K
+};
+
+typedef struct {
+  const char *name;
+  size_t      nelts;
+} kern_size_t;
+
+// 8-byte elements: 16K, 128K, 4M and 128M of data
+static const kern_size_t kern_sizes[] = {
+  { "L1",   2 * K },
+  { "L2",   16 * K },
+  { "LLC",  512 * K },
+  { "DRAM", 16 * M }
+};
+
+enum {
+  KERN_NSIZES = sizeof(kern_sizes) / sizeof(kern_sizes[0])
+};
+
+// one kernel: setup fills data (and whatever else run needs) from the
+// random orig[0 .. nelts - 1], untimed, before every run (only before
+// the first if the kernel is read_only); run returns how many elements
+// it processed
+typedef struct {
+  const char *name;
+  void      (*setup)(long *data, const long *orig, size_t nelts);
+  size_t    (*run)(long *data, size_t nelts);
+  bool        read_only;
+} kernel_t;
+
+// scratch space for the kernels that need it
+static long   *kern_tmp;
+static size_t *kern_counts;
+static long   *kern_keys;
+static size_t  kern_sink;
+
+static inline unsigned long long
+read_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static inline double
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1E9 + (double) ts.tv_nsec;
+}
+
+static void
+setup_copy(long *data, const long *orig, size_t nelts)
+{
+  memcpy(data, orig, nelts * sizeof(long));
+}
+
+static void
+setup_sorted(long *data, const long *orig, size_t nelts)
+{
+  memcpy(data, orig, nelts * sizeof(long));
+  quicksort_opt(data, 0, nelts - 1, false);
+}
+
+// two sorted halves, as merge() expects them
+static void
+setup_halves(long *data, const long *orig, size_t nelts)
+{
+  size_t mid = (nelts - 1) / 2;
+
+  memcpy(data, orig, nelts * sizeof(long));
+  quicksort_opt(data, 0, mid, false);
+  quicksort_opt(data, mid + 1, nelts - 1, false);
+}
+
+// values in [0 .. KERN_COUNT_VALS)
+static void
+setup_small_vals(long *data, const long *orig, size_t nelts)
+{
+  size_t i;
+
+  for (i = 0; i < nelts; i++)
+    data[i] = orig[i] % KERN_COUNT_VALS;
+}
+
+// one partition of everything around the value of a random element
+static size_t
+run_partition(long *data, size_t nelts)
+{
+  size_t lsize, rsize;
+
+  hoare_partition(data, 0, nelts - 1, data[nelts / 3], &lsize, &rsize);
+  kern_sink += lsize;
+  return nelts;
+}
+
+static size_t
+run_merge(long *data, size_t nelts)
+{
+  merge(data, kern_tmp, 0, nelts - 1);
+  return nelts;
+}
+
+// insertion sorts run on base-case-sized blocks, so the array size
+// only changes where the blocks come from
+static size_t
+run_insertion_sort(long *data, size_t nelts)
+{
+  size_t lo;
+
+  for (lo = 0; lo + MIN_QUICKSORT_NELTS <= nelts; lo += MIN_QUICKSORT_NELTS)
+    insertion_sort(data, lo, lo + MIN_QUICKSORT_NELTS - 1);
+  return lo;
+}
+
+static size_t
+run_insertion_sort_opt(long *data, size_t nelts)
+{
+  size_t lo;
+
+  for (lo = 0; lo + MIN_QUICKSORT_NELTS <= nelts; lo += MIN_QUICKSORT_NELTS)
+    insertion_sort_opt(data, lo, lo + MIN_QUICKSORT_NELTS - 1);
+  return lo;
+}
+
+// per lookup (of the random kern_keys) rather than per element
+static size_t
+run_bsearch(long *data, size_t nelts)
+{
+  size_t i;
+
+  for (i = 0; i < KERN_LOOKUPS; i++)
+    kern_sink += bsearch_find_idx(data, 0, nelts - 1, kern_keys[i]);
+  return KERN_LOOKUPS;
+}
+
+// heapify: a sift-down from every parent, bottom up
+static size_t
+run_sift_down(long *data, size_t nelts)
+{
+  size_t parent = nelts / 2;
+
+  while (parent > 0) {
+    parent--;
+    heap_sift_down(data, nelts, parent, data[parent]);
+  }
+  return nelts;
+}
+
+static size_t
+run_histogram(long *data, size_t nelts)
+{
+  count_values(data, nelts, kern_counts, KERN_COUNT_VALS - 1);
+  kern_sink += kern_counts[0];
+  return nelts;
+}
+
+static const kernel_t kernels[] = {
+  { "partition",          &setup_copy,       &run_partition,          false },
+  { "merge",              &setup_halves,     &run_merge,              false },
+  { "insertion_sort",     &setup_copy,       &run_insertion_sort,     false },
+  { "insertion_sort_opt", &setup_copy,       &run_insertion_sort_opt, false },
+  { "bsearch_find_idx",   &setup_sorted,     &run_bsearch,            true },
+  { "heap_sift_down",     &setup_copy,       &run_sift_down,          false },
+  { "histogram",          &setup_small_vals, &run_histogram,          true }
+};
+
+enum {
+  KERN_NKERNELS = sizeof(kernels) / sizeof(kernels[0])
+};
+
+// best of the reps of kernel on nelts elements, per element processed
+static void
+time_kernel(const kernel_t *kernel, long *data, const long *orig,
+            size_t nelts, double *ns_per_elt, double *cycles_per_elt)
+{
+  unsigned long long tsc_start, tsc_end;
+  double  ns_start, ns_end, ns, cycles;
+  size_t  rep, done, total = 0;
+
+  *ns_per_elt = *cycles_per_elt = 0.0;
+  for (rep = 0; rep < KERN_MIN_REPS || total < KERN_MIN_ELTS; rep++) {
+    if (rep == 0 || !kernel->read_only)
+      kernel->setup(data, orig, nelts);
+
+    ns_start = now_ns();
+    tsc_start = read_tsc();
+    done = kernel->run(data, nelts);
+    tsc_end = read_tsc();
+    ns_end = now_ns();
+
+    total += done;
+    ns = (ns_end - ns_start) / (double) done;
+    cycles = (double) (tsc_end - tsc_start) / (double) done;
+    if (rep == 0 || ns < *ns_per_elt) {
+      *ns_per_elt = ns;
+      *cycles_per_elt = cycles;
+    }
+  }
+}
+
+static void
+usage(void)
+{
+  size_t k;
+
+  printf("usage: sortkernels [kernel ...]\n\nkernels:");
+  for (k = 0; k < KERN_NKERNELS; k++)
+    printf(" %s", kernels[k].name);
+  printf("\n");
+  exit(-1);
+}
+
+int main(int argc, char * argv[])
+{
+  size_t maxelts = kern_sizes[KERN_NSIZES - 1].nelts;
+  long  *data, *orig;
+  double ns, cycles;
+  bool   selected[KERN_NKERNELS];
+  size_t i, k, s;
+  int    a;
+
+  for (k = 0; k < KERN_NKERNELS; k++)
+    selected[k] = (argc == 1);
+  for (a = 1; a < argc; a++) {
+    for (k = 0; k < KERN_NKERNELS; k++) {
+      if (strcmp(argv[a], kernels[k].name) == 0)
+        break;
+    }
+    if (k == KERN_NKERNELS)
+      usage();
+    selected[k] = true;
+  }
+
+  data = calloc(maxelts, sizeof(long));
+  orig = calloc(maxelts, sizeof(long));
+  kern_tmp = calloc(maxelts, sizeof(long));
+  kern_counts = calloc(KERN_COUNT_VALS, sizeof(size_t));
+  kern_keys = calloc(KERN_LOOKUPS, sizeof(long));
+  if (data == NULL || orig == NULL || kern_tmp == NULL ||
+      kern_counts == NULL || kern_keys == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  srandom(1);
+  for (i = 0; i < maxelts; i++)
+    orig[i] = random();
+  for (i = 0; i < KERN_LOOKUPS; i++)
+    kern_keys[i] = random();
+
+  printf("%-20s %-5s %10s %10s %10s\n", "kernel", "size", "elements",
+         "ns/elt", "cycles/elt");
+  for (k = 0; k < KERN_NKERNELS; k++) {
+    if (!selected[k])
+      continue;
+    for (s = 0; s < KERN_NSIZES; s++) {
+      time_kernel(&kernels[k], data, orig, kern_sizes[s].nelts, &ns, &cycles);
+      printf("%-20s %-5s %10zu %10.2f %10.2f\n", kernels[k].name,
+             kern_sizes[s].name, kern_sizes[s].nelts, ns, cycles);
+      fflush(stdout);
+    }
+  }
+
+  // keeps the kernels' results from being optimized away
+  if (kern_sink == 0)
+    printf("\n");
+
+  free(data);
+  free(orig);
+  free(kern_tmp);
+  free(kern_counts);
+  free(kern_keys);
+  return 0;
+}
@@ -0,0 +1,47 @@
+//
+// kernels.h
+//
+// the inner loops of the sorts; they're static to their files except
+// when the library is built with -DSORT_KERNELS (make sortkernels), so
+// the kernel microbenchmark can call them directly
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "sorts.h"
+
+// insert.c (always visible: insertion_sort_opt's binary search)
+extern
+size_t bsearch_find_idx(long *data, size_t lo_ix, size_t hi_ix, long val);
+
+#ifdef SORT_KERNELS
+
+#define SORT_KERNEL
+
+// quick.c
+extern
+void hoare_partition(long *data, size_t lo_ix, size_t hi_ix, long pivot_elem,
+                     size_t *lsize, size_t *rsize);
+
+// merge.c
+extern
+void merge(long *data, long *tmpdata, size_t lo_ix, size_t hi_ix);
+
+// heap.c
+extern
+void heap_sift_down(long *arr, size_t n, size_t index, long t);
+
+// counting.c
+extern
+void count_values(long *data, size_t data_len, size_t *tmpdata, uint maxval);
+
+#else
+
+#define SORT_KERNEL static
+
+#endif /* SORT_KERNELS */
+
+#endif /* KERNELS_H */
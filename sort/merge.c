@@ -10,6 +10,8 @@
 #include <math.h>
 #include <string.h> /* memcpy */
 #include "sorts.h"
+#include "sortstats.h"
+#include "kernels.h"
 
 // merge sort subroutine
 //
@@ -20,17 +22,17 @@
 // plus optional tmp array so we don't have to allocate it every time
 //
 // output is the merge of these two lists
-static void
-merge(long *data, long *tmpdata, uint lo_ix, uint hi_ix)
+SORT_KERNEL void
+merge(long *data, long *tmpdata, size_t lo_ix, size_t hi_ix)
 {
   long  *tmp;
-  uint   t; // tmp list iterator
-  uint   mid = lo_ix + ((hi_ix - lo_ix) / 2);
-  uint   nelts = hi_ix - lo_ix + 1;
-  uint   i; // list #1 [lo_ix ... mid] iterator
-  uint   j; // list #2 [mid + 1 ... hi_ix] iterator
-  uint   imax = mid;
-  uint   jmax = hi_ix;
+  size_t t; // tmp list iterator
+  size_t mid = lo_ix + ((hi_ix - lo_ix) / 2);
+  size_t nelts = hi_ix - lo_ix + 1;
+  size_t i; // list #1 [lo_ix ... mid] iterator
+  size_t j; // list #2 [mid + 1 ... hi_ix] iterator
+  size_t imax = mid;
+  size_t jmax = hi_ix;
 
   if (tmpdata == NULL) {
     tmp = calloc(nelts, sizeof(long));
@@ -71,6 +73,7 @@ merge(long *data, long *tmpdata, uint lo_ix, uint hi_ix)
 
   // now copy back tmp on top of the elements we sorted
   memcpy((void*)&data[lo_ix], (void*)&tmp[0], nelts * sizeof(long));
+  SORT_STAT_ADD(bytes_moved, 2 * nelts * sizeof(long));
   //
   // for (i = lo_ix, t = 0; t < nelts; i++, t++)
   //   data[i] = tmp[t];
@@ -82,9 +85,9 @@ merge(long *data, long *tmpdata, uint lo_ix, uint hi_ix)
 
 // basic merge sort (recursive)
 void
-merge_sort(long *data, uint lo_ix, uint hi_ix)
+merge_sort(long *data, size_t lo_ix, size_t hi_ix)
 {
-  uint mid = lo_ix + ((hi_ix - lo_ix) / 2);
+  size_t mid = lo_ix + ((hi_ix - lo_ix) / 2);
 
   // base case #1 (one list element): done
   if (lo_ix == hi_ix)
@@ -105,18 +108,19 @@ merge_sort(long *data, uint lo_ix, uint hi_ix)
 
 // slightly optimized merge sort (recursive)
 void
-merge_sort_opt(long *data, long *tmpdata, uint lo_ix, uint hi_ix)
+merge_sort_opt(long *data, long *tmpdata, size_t lo_ix, size_t hi_ix)
 {
-  uint mid = lo_ix + ((hi_ix - lo_ix) / 2);
+  size_t mid = lo_ix + ((hi_ix - lo_ix) / 2);
 
   // OPTIMIZATION: use insertion sort for a small number of elements
   if ((hi_ix - lo_ix + 1) < MIN_MERGE_SORT_NELTS) {
+    SORT_STAT_ADD(insertion_sorts, 1);
     insertion_sort_opt(data, lo_ix, hi_ix);
     return;
   }
 
-  merge_sort(data, lo_ix, mid);
-  merge_sort(data, mid + 1, hi_ix);
+  merge_sort_opt(data, tmpdata, lo_ix, mid);
+  merge_sort_opt(data, tmpdata, mid + 1, hi_ix);
 
   // OPTIMIZATION: use tmpdata array so we can avoid calloc() + free()
   // for every merge operation
@@ -0,0 +1,166 @@
+//
+// pipebench.c
+//
+// benchmarking the pipelined sort against generate-then-sort, measuring
+// when the first sorted elements come out and when the last one does
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h> /* LONG_MIN */
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+#include "sortstats.h"
+
+enum {
+  // windowed input: element i is i * PIPE_STRIDE plus up to
+  // PIPE_WINDOW_NELTS strides of noise, so it's out of order only
+  // within a window
+  PIPE_STRIDE       = 16,
+  PIPE_WINDOW_NELTS = 64 * K
+};
+
+typedef enum {
+  PIPE_INPUT_RANDOM,
+  PIPE_INPUT_WINDOWED,
+  PIPE_NINPUTS
+} pipe_input_t;
+
+static const char *pipe_input_names[] = { "random", "windowed" };
+
+// fingerprints are sums, so the chunks' add up to the whole input's
+// (or output's)
+typedef struct {
+  pipe_input_t input;
+  size_t       next;
+  size_t       nelts;
+  uint64_t     fingerprint;
+} producer_t;
+
+typedef struct {
+  struct timeval start;
+  double   first;      // seconds until the first elements came out
+  size_t   nelts;
+  long     last;
+  bool     sorted;
+  uint64_t fingerprint;
+} consumer_t;
+
+static size_t
+produce(long *buf, size_t max, long *watermark, void *arg)
+{
+  producer_t *p = (producer_t *) arg;
+  size_t      i, n = p->nelts - p->next;
+
+  if (n > max)
+    n = max;
+
+  for (i = 0; i < n; i++, p->next++) {
+    if (p->input == PIPE_INPUT_RANDOM)
+      buf[i] = random();
+    else
+      buf[i] = (long) (p->next * PIPE_STRIDE) +
+               random() % (PIPE_WINDOW_NELTS * PIPE_STRIDE);
+  }
+
+  // nothing after element next can be below next * PIPE_STRIDE
+  if (p->input == PIPE_INPUT_WINDOWED)
+    *watermark = (long) (p->next * PIPE_STRIDE);
+
+  p->fingerprint += sort_fingerprint(buf, n);
+  return n;
+}
+
+static void
+consume(const long *data, size_t nelts, void *arg)
+{
+  consumer_t    *c = (consumer_t *) arg;
+  struct timeval now;
+  size_t         i;
+
+  if (c->nelts == 0) {
+    gettimeofday(&now, NULL);
+    c->first = elapsed(&c->start, &now);
+  }
+
+  for (i = 0; i < nelts; i++) {
+    if (data[i] < c->last)
+      c->sorted = false;
+    c->last = data[i];
+  }
+  c->nelts += nelts;
+  c->fingerprint += sort_fingerprint(data, nelts);
+}
+
+int
+pipe_bench(size_t nelts)
+{
+  struct timeval tv_end;
+  producer_t prod;
+  consumer_t cons;
+  long      *data;
+  size_t     n;
+  int        input, method;
+  long       watermark;
+
+  data = calloc(nelts, sizeof(long));
+  if (data == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  printf("pipeline: chunks of %d elements, %zu threads\n\n",
+         PIPESORT_CHUNK_NELTS, sort_get_threads());
+
+  for (input = 0; input < PIPE_NINPUTS; input++) {
+    for (method = 0; method < 3; method++) {
+      memset(&prod, 0, sizeof(prod));
+      prod.input = input;
+      prod.nelts = nelts;
+      memset(&cons, 0, sizeof(cons));
+      cons.last = LONG_MIN;
+      cons.sorted = true;
+
+      sort_stats_reset();
+      gettimeofday(&cons.start, NULL);
+      switch (method) {
+        case 0:
+        printf("sorting: %s input, generate then quicksort opt mt\n",
+               pipe_input_names[input]);
+        n = produce(data, nelts, &watermark, &prod);
+        quicksort_opt(data, 0, n - 1, true);
+        consume(data, n, &cons);
+        break;
+
+        case 1:
+        printf("sorting: %s input, pipe sort\n", pipe_input_names[input]);
+        pipe_sort(&produce, &prod, &consume, &cons, 0, false);
+        break;
+
+        case 2:
+        printf("sorting: %s input, pipe sort mt\n", pipe_input_names[input]);
+        pipe_sort(&produce, &prod, &consume, &cons, 0, true);
+        break;
+      }
+      gettimeofday(&tv_end, NULL);
+
+      if (cons.nelts != nelts || !cons.sorted ||
+          cons.fingerprint != prod.fingerprint)
+        printf("\n**** output is not the %zu input elements sorted!\n",
+               nelts);
+
+      printf("finished: first output after %.3f seconds, "
+             "sorted %zu elements in %.2f seconds\n",
+             cons.first, cons.nelts, elapsed(&cons.start, &tv_end));
+      sort_stats_print();
+      printf("\n");
+    }
+  }
+
+  free(data);
+  return 0;
+}
@@ -0,0 +1,373 @@
+//
+// pipesort.c
+//
+// pipelined sort of a stream: the caller's thread pulls fixed-size
+// chunks from a producer callback, worker threads sort them with
+// quicksort_opt as they arrive, and a merger thread folds the sorted
+// chunks into a handful of runs, handing the sorted output to a
+// consumer callback. elements below the producer's watermark go out
+// before the input ends
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <limits.h> /* LONG_MIN */
+#include <assert.h>
+#include <pthread.h>
+#include "sorts.h"
+#include "sortstats.h"
+
+// a chunk of input on its way through the pipeline
+typedef struct pipe_chunk {
+  long   *data;
+  size_t  nelts;
+  size_t  seq;
+  long    watermark;  // everything produced after this chunk is >= this
+  struct pipe_chunk *next;
+} pipe_chunk_t;
+
+// a sorted run held by the merger; data[start .. end - 1] hasn't been
+// output yet
+typedef struct {
+  long   *data;
+  size_t  start;
+  size_t  end;
+} pipe_run_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t  cond;           // signalled on any change below
+  pipe_chunk_t   *unsorted;       // fifo for the sort workers
+  pipe_chunk_t   *unsorted_tail;
+  pipe_chunk_t   *sorted;         // sorted, waiting for the merger
+  size_t          inflight;       // produced but not merged yet
+  size_t          nchunks;        // chunks produced so far
+  bool            input_done;
+
+  // only touched by the merger
+  pipe_run_t      runs[PIPESORT_MAX_RUNS];
+  size_t          nruns;
+  long           *outbuf;
+  size_t          noutput;
+  sort_consumer_t consume;
+  void           *carg;
+} pipe_state_t;
+
+static inline size_t
+run_length(const pipe_run_t *run)
+{
+  return run->end - run->start;
+}
+
+// merge the two topmost runs into one
+static void
+merge_top_runs(pipe_state_t *st)
+{
+  pipe_run_t *a = &st->runs[st->nruns - 2];
+  pipe_run_t *b = &st->runs[st->nruns - 1];
+  size_t      n = run_length(a) + run_length(b);
+  long       *data = malloc(n * sizeof(long));
+  size_t      i = a->start, j = b->start, t = 0;
+
+  assert(data != NULL);
+
+  while (i < a->end && j < b->end)
+    data[t++] = (a->data[i] <= b->data[j]) ? a->data[i++] : b->data[j++];
+  while (i < a->end)
+    data[t++] = a->data[i++];
+  while (j < b->end)
+    data[t++] = b->data[j++];
+
+  SORT_STAT_ADD(bytes_moved, n * sizeof(long));
+
+  free(a->data);
+  free(b->data);
+  a->data = data;
+  a->start = 0;
+  a->end = n;
+  st->nruns--;
+}
+
+// add a sorted chunk as a new run, merging like a binary counter so
+// there are only O(log n) runs: while the run below is no longer than
+// the new one, merge them
+static void
+push_run(pipe_state_t *st, long *data, size_t nelts)
+{
+  if (st->nruns == PIPESORT_MAX_RUNS)
+    merge_top_runs(st);
+
+  st->runs[st->nruns].data = data;
+  st->runs[st->nruns].start = 0;
+  st->runs[st->nruns].end = nelts;
+  st->nruns++;
+
+  while (st->nruns >= 2 &&
+         run_length(&st->runs[st->nruns - 2]) <= run_length(&st->runs[st->nruns - 1]))
+    merge_top_runs(st);
+}
+
+// hand the smallest elements of the runs to the consumer, as long as
+// they're below limit (or all of them, with all); runs that have been
+// mostly output are shrunk so memory stays bounded by what's pending
+static void
+emit_runs(pipe_state_t *st, long limit, bool all)
+{
+  pipe_run_t *run;
+  size_t      nout = 0, r, best, kept;
+  long       *data;
+
+  for (;;) {
+    best = st->nruns;
+    for (r = 0; r < st->nruns; r++) {
+      run = &st->runs[r];
+      if (run->start < run->end && (all || run->data[run->start] < limit) &&
+          (best == st->nruns ||
+           run->data[run->start] < st->runs[best].data[st->runs[best].start]))
+        best = r;
+    }
+    if (best == st->nruns)
+      break;
+
+    run = &st->runs[best];
+    st->outbuf[nout++] = run->data[run->start++];
+    if (nout == PIPESORT_OUT_NELTS) {
+      st->consume(st->outbuf, nout, st->carg);
+      st->noutput += nout;
+      nout = 0;
+    }
+  }
+
+  if (nout > 0) {
+    st->consume(st->outbuf, nout, st->carg);
+    st->noutput += nout;
+  }
+
+  for (r = 0, kept = 0; r < st->nruns; r++) {
+    run = &st->runs[r];
+    if (run->start == run->end) {
+      free(run->data);
+      continue;
+    }
+    if (run->start > run_length(run)) {
+      data = malloc(run_length(run) * sizeof(long));
+      assert(data != NULL);
+      memcpy(data, &run->data[run->start], run_length(run) * sizeof(long));
+      free(run->data);
+      run->data = data;
+      run->end -= run->start;
+      run->start = 0;
+    }
+    st->runs[kept++] = *run;
+  }
+  st->nruns = kept;
+}
+
+static void *
+pipe_sort_thread(void *arg)
+{
+  pipe_state_t *st = (pipe_state_t *) arg;
+  pipe_chunk_t *chunk;
+
+  sort_thread_start();
+
+  for (;;) {
+    pthread_mutex_lock(&st->lock);
+    while (st->unsorted == NULL && !st->input_done)
+      pthread_cond_wait(&st->cond, &st->lock);
+    chunk = st->unsorted;
+    if (chunk != NULL) {
+      st->unsorted = chunk->next;
+      if (st->unsorted == NULL)
+        st->unsorted_tail = NULL;
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    if (chunk == NULL)
+      break;
+
+    if (chunk->nelts > 1)
+      quicksort_opt(chunk->data, 0, chunk->nelts - 1, false);
+
+    pthread_mutex_lock(&st->lock);
+    chunk->next = st->sorted;
+    st->sorted = chunk;
+    pthread_cond_broadcast(&st->cond);
+    pthread_mutex_unlock(&st->lock);
+  }
+
+  sort_thread_end();
+  return NULL;
+}
+
+// the merger takes the sorted chunks in the order they were produced,
+// so a chunk's watermark holds for everything not merged yet
+static void *
+pipe_merge_thread(void *arg)
+{
+  pipe_state_t  *st = (pipe_state_t *) arg;
+  pipe_chunk_t **pp, *chunk;
+  size_t         next_seq = 0;
+
+  sort_thread_start();
+
+  for (;;) {
+    pthread_mutex_lock(&st->lock);
+    for (;;) {
+      for (pp = &st->sorted; *pp != NULL && (*pp)->seq != next_seq; pp = &(*pp)->next)
+        ;
+      if (*pp != NULL || (st->input_done && next_seq == st->nchunks))
+        break;
+      pthread_cond_wait(&st->cond, &st->lock);
+    }
+    chunk = *pp;
+    if (chunk != NULL)
+      *pp = chunk->next;
+    pthread_mutex_unlock(&st->lock);
+
+    if (chunk == NULL)
+      break;
+
+    push_run(st, chunk->data, chunk->nelts);
+    emit_runs(st, chunk->watermark, false);
+    free(chunk);
+    next_seq++;
+
+    pthread_mutex_lock(&st->lock);
+    st->inflight--;
+    pthread_cond_broadcast(&st->cond);
+    pthread_mutex_unlock(&st->lock);
+  }
+
+  emit_runs(st, 0, true);
+
+  sort_thread_end();
+  return NULL;
+}
+
+// sort the stream of longs from produce, passing the sorted result to
+// consume in order (in pieces of up to PIPESORT_OUT_NELTS elements)
+//
+// produce(buf, max, &watermark, parg) fills buf with up to max elements
+// and returns how many, 0 at the end of the input; it may raise
+// watermark (initially LONG_MIN) to promise that every element it
+// produces later is >= watermark, which lets the elements below it be
+// consumed before the input ends. chunk_nelts is the chunk size (0
+// for PIPESORT_CHUNK_NELTS); at most a few chunks beyond what hasn't
+// been consumed yet are held in memory. returns the number of elements
+// sorted
+size_t
+pipe_sort(sort_producer_t produce, void *parg, sort_consumer_t consume,
+          void *carg, size_t chunk_nelts, bool multithread)
+{
+  pipe_state_t  st;
+  pipe_chunk_t *chunk;
+  pthread_t    *workers;
+  pthread_t     merger;
+  long         *chunk_data;
+  size_t        nworkers, max_inflight, w, n;
+  long          watermark = LONG_MIN;
+  int           rc;
+
+  if (chunk_nelts == 0)
+    chunk_nelts = PIPESORT_CHUNK_NELTS;
+
+  memset(&st, 0, sizeof(st));
+  st.consume = consume;
+  st.carg = carg;
+  st.outbuf = malloc(PIPESORT_OUT_NELTS * sizeof(long));
+  assert(st.outbuf != NULL);
+
+  // single threaded: the same stages one after the other
+  if (!multithread) {
+    for (;;) {
+      chunk_data = malloc(chunk_nelts * sizeof(long));
+      assert(chunk_data != NULL);
+      n = produce(chunk_data, chunk_nelts, &watermark, parg);
+      if (n == 0) {
+        free(chunk_data);
+        break;
+      }
+      if (n > 1)
+        quicksort_opt(chunk_data, 0, n - 1, false);
+      push_run(&st, chunk_data, n);
+      emit_runs(&st, watermark, false);
+    }
+    emit_runs(&st, 0, true);
+
+    free(st.outbuf);
+    return st.noutput;
+  }
+
+  // one cpu keeps producing, the rest sort; the merger mostly waits
+  nworkers = sort_get_threads();
+  if (nworkers > 1)
+    nworkers--;
+  max_inflight = 2 * nworkers + 1;
+
+  pthread_mutex_init(&st.lock, NULL);
+  pthread_cond_init(&st.cond, NULL);
+
+  workers = malloc(nworkers * sizeof(pthread_t));
+  assert(workers != NULL);
+
+  for (w = 0; w < nworkers; w++) {
+    rc = pthread_create(&workers[w], NULL, &pipe_sort_thread, &st);
+    assert(rc == 0);
+    SORT_STAT_ADD(thread_spawns, 1);
+  }
+  rc = pthread_create(&merger, NULL, &pipe_merge_thread, &st);
+  assert(rc == 0);
+  SORT_STAT_ADD(thread_spawns, 1);
+
+  for (;;) {
+    pthread_mutex_lock(&st.lock);
+    while (st.inflight >= max_inflight)
+      pthread_cond_wait(&st.cond, &st.lock);
+    pthread_mutex_unlock(&st.lock);
+
+    chunk = malloc(sizeof(pipe_chunk_t));
+    assert(chunk != NULL);
+    chunk->data = malloc(chunk_nelts * sizeof(long));
+    assert(chunk->data != NULL);
+
+    n = produce(chunk->data, chunk_nelts, &watermark, parg);
+    if (n == 0) {
+      free(chunk->data);
+      free(chunk);
+      break;
+    }
+    chunk->nelts = n;
+    chunk->watermark = watermark;
+    chunk->next = NULL;
+
+    pthread_mutex_lock(&st.lock);
+    chunk->seq = st.nchunks++;
+    if (st.unsorted_tail != NULL)
+      st.unsorted_tail->next = chunk;
+    else
+      st.unsorted = chunk;
+    st.unsorted_tail = chunk;
+    st.inflight++;
+    pthread_cond_broadcast(&st.cond);
+    pthread_mutex_unlock(&st.lock);
+  }
+
+  pthread_mutex_lock(&st.lock);
+  st.input_done = true;
+  pthread_cond_broadcast(&st.cond);
+  pthread_mutex_unlock(&st.lock);
+
+  for (w = 0; w < nworkers; w++)
+    pthread_join(workers[w], NULL);
+  pthread_join(merger, NULL);
+
+  free(workers);
+  free(st.outbuf);
+  pthread_mutex_destroy(&st.lock);
+  pthread_cond_destroy(&st.cond);
+
+  return st.noutput;
+}
@@ -11,13 +11,15 @@
 #include <math.h>
 #include <pthread.h>
 #include "sorts.h"
+#include "sortstats.h"
+#include "kernels.h"
 
 void *qsort_core_thread(void *arg);
 
 // basic quicksort (recursive)
-void quicksort(long *data, uint lo_ix, uint hi_ix)
+void quicksort(long *data, size_t lo_ix, size_t hi_ix)
 {
-  int i, j;
+  size_t i, j;
   long pivot_elem;
 
   // base case #1 (one list element): done
@@ -44,7 +46,11 @@ void quicksort(long *data, uint lo_ix, uint hi_ix)
     if (i <= j) {
       swap_elem(&data[i], &data[j]);
       i++;
-      j--;
+      // NB: i == j == lo_ix is possible (e.g. lo_ix == 0 and data[0]
+      // is the pivot), and j - 1 would wrap around; data[lo_ix] is the
+      // pivot value at that point so [lo_ix .. lo_ix] is done anyway
+      if (j > lo_ix)
+        j--;
     }
   }
 
@@ -57,77 +63,186 @@ void quicksort(long *data, uint lo_ix, uint hi_ix)
   return;
 }
 
-// core subroutine of quicksort_opt
-void qsort_core(long *data, int lo_ix, int hi_ix,
+// Hoare partition of data[lo_ix .. hi_ix] around pivot_elem
+//
+// on return data[lo_ix .. lo_ix + *lsize - 1] <= pivot_elem and
+// data[hi_ix - *rsize + 1 .. hi_ix] >= pivot_elem
+SORT_KERNEL void
+hoare_partition(long *data, size_t lo_ix, size_t hi_ix, long pivot_elem,
+                size_t *lsize, size_t *rsize)
+{
+  size_t i, j;
+
+  i = lo_ix;
+  j = hi_ix;
+  while (i <= j) {
+    while (compare(&data[i], &pivot_elem) < 0)
+      i++;
+    while (compare(&data[j], &pivot_elem) > 0)
+      j--;
+
+    if (i <= j) {
+      swap_elem(&data[i], &data[j]);
+      i++;
+      // NB: i == j == lo_ix is possible (e.g. lo_ix == 0 and data[0]
+      // is the pivot), and j - 1 would wrap around; data[lo_ix] is the
+      // pivot value at that point so [lo_ix .. lo_ix] is done anyway
+      if (j > lo_ix)
+        j--;
+    }
+  }
+
+  *lsize = j - lo_ix + 1;
+  *rsize = (i <= hi_ix) ? (hi_ix - i + 1) : 0;
+}
+
+// swap the n elements starting at data[a] with the n starting at data[b]
+static void
+vecswap(long *data, size_t a, size_t b, size_t n)
+{
+  while (n-- > 0)
+    swap_elem(&data[a++], &data[b++]);
+}
+
+// Bentley-McIlroy three-way ("fat") partition of data[lo_ix .. hi_ix]
+// around the pivot, which must already be in data[lo_ix]
+//
+// elements equal to the pivot are collected at both ends while
+// scanning and then swapped into the middle, so they're never looked
+// at again; on return data[lo_ix .. lo_ix + *lsize - 1] < pivot and
+// data[hi_ix - *rsize + 1 .. hi_ix] > pivot
+static void
+fat_partition(long *data, size_t lo_ix, size_t hi_ix,
+              size_t *lsize, size_t *rsize)
+{
+  long   pivot_elem = data[lo_ix];
+  size_t a, b, c, d, n;
+  int    r;
+
+  // invariant: [lo_ix .. a) == pivot, [a .. b) < pivot,
+  //            (c .. d] > pivot, (d .. hi_ix] == pivot
+  a = b = lo_ix + 1;
+  c = d = hi_ix;
+  while (true) {
+    while (b <= c && (r = compare(&data[b], &pivot_elem)) <= 0) {
+      if (r == 0)
+        swap_elem(&data[a++], &data[b]);
+      b++;
+    }
+    while (b <= c && (r = compare(&data[c], &pivot_elem)) >= 0) {
+      if (r == 0)
+        swap_elem(&data[c], &data[d--]);
+      c--;
+    }
+    if (b > c)
+      break;
+    swap_elem(&data[b++], &data[c--]);
+  }
+
+  // move the equal elements from both ends into the middle
+  n = (a - lo_ix < b - a) ? (a - lo_ix) : (b - a);
+  vecswap(data, lo_ix, b - n, n);
+  n = (d - c < hi_ix - d) ? (d - c) : (hi_ix - d);
+  vecswap(data, b, hi_ix + 1 - n, n);
+
+  *lsize = b - a;
+  *rsize = d - c;
+}
+
+// core subroutine of quicksort_opt and quicksort_3way
+//
+// if three_way is set, partitions that look like they contain
+// duplicates of the pivot are done with fat_partition; pred (if not
+// NULL) is a value <= every element of data[lo_ix .. hi_ix], i.e. a
+// pivot from an earlier partition
+void qsort_core(long *data, size_t lo_ix, size_t hi_ix,
                 unsigned short call_depth, unsigned short max_call_depth,
-                bool multithread)
+                bool multithread, bool three_way, const long *pred)
 {
-  int i, j, lsize, rsize;
+  size_t mid_ix, lsize, rsize;
   long pivot_elem;
+  long rpred;
   pthread_t cthread;
   qsort_info_t cthread_info;
   int rc;
   bool spawn_threads;
 
+  SORT_STAT_MAX(max_call_depth, call_depth);
+
   // OPTIMIZATION: use insertion sort for a small number of elements
   if ((hi_ix - lo_ix) < MIN_QUICKSORT_NELTS) {
-    insertion_sort(data, lo_ix, hi_ix);
+    SORT_STAT_ADD(insertion_sorts, 1);
+    if (QSORT_BASE_CASE == SORT_BASE_INSERTION_OPT)
+      insertion_sort_opt(data, lo_ix, hi_ix);
+    else
+      insertion_sort(data, lo_ix, hi_ix);
     return;
   }
 
   // if the recursion depth is too big, use heap sort
   if (call_depth > max_call_depth) {
+    SORT_STAT_ADD(heapsort_fallbacks, 1);
     heapsort(&data[lo_ix], lo_ix, hi_ix);
     return;
   }
 
-  pivot_elem = data[lo_ix + ((hi_ix - lo_ix) >> 1)];
+  mid_ix = lo_ix + ((hi_ix - lo_ix) >> 1);
+  pivot_elem = data[mid_ix];
 
-  i = lo_ix;
-  j = hi_ix;
-  while (i <= j) {
-    while (compare(&data[i], &pivot_elem) < 0)
-      i++;
-    while (compare(&data[j], &pivot_elem) > 0)
-      j--;
-
-    if (i <= j) {
-      swap_elem(&data[i], &data[j]);
-      i++;
-      j--;
-    }
+  // OPTIMIZATION: cheap check for duplicates of the pivot: either it's
+  // equal to the predecessor (i.e. it's the smallest value in the
+  // range) or to one of the end elements; only then is the more
+  // expensive three-way partition worth it
+  if (three_way &&
+      ((pred != NULL && *pred == pivot_elem) ||
+       data[lo_ix] == pivot_elem || data[hi_ix] == pivot_elem)) {
+    swap_elem(&data[lo_ix], &data[mid_ix]);
+    fat_partition(data, lo_ix, hi_ix, &lsize, &rsize);
   }
+  else {
+    hoare_partition(data, lo_ix, hi_ix, pivot_elem, &lsize, &rsize);
+  }
+
+  SORT_STAT_IMBALANCE(lsize, rsize);
+
+  // everything in the right sub-array is >= the pivot
+  rpred = pivot_elem;
 
-  lsize = (lo_ix < j) ? (j - lo_ix) : 0;
-  rsize = (i < hi_ix) ? (hi_ix - j) : 0;
   spawn_threads =
     multithread &&
+    (call_depth < sort_spawn_depth()) &&
     (lsize > QSORT_THREAD_THRESHOLD) &&
     (rsize > QSORT_THREAD_THRESHOLD);
 
   // case 1: we've spawned too many threads already, so recursively
   // sort the sub-arrays in the current thread
   if (!spawn_threads) {
-    if (lo_ix < j)
-      qsort_core(data, lo_ix, j, call_depth + 1, max_call_depth, spawn_threads);
+    if (lsize > 1)
+      qsort_core(data, lo_ix, lo_ix + lsize - 1, call_depth + 1,
+                 max_call_depth, spawn_threads, three_way, pred);
 
-    if (i < hi_ix)
-      qsort_core(data, i, hi_ix, call_depth + 1, max_call_depth, spawn_threads);
+    if (rsize > 1)
+      qsort_core(data, hi_ix - rsize + 1, hi_ix, call_depth + 1,
+                 max_call_depth, spawn_threads, three_way, &rpred);
   }
   // case 2: create new thread to recursively sort the left sub-array
   else {
     // create a child thread to sort the left sub-array
     cthread_info.data = data;
     cthread_info.lo_ix = lo_ix;
-    cthread_info.hi_ix = j;
+    cthread_info.hi_ix = lo_ix + lsize - 1;
     cthread_info.call_depth = call_depth + 1;
     cthread_info.max_call_depth = max_call_depth;
+    cthread_info.three_way = three_way;
+    cthread_info.pred = pred;
 
     rc = pthread_create(&cthread, NULL, &qsort_core_thread, &cthread_info);
     assert(rc == 0);
+    SORT_STAT_ADD(thread_spawns, 1);
 
     // sort the right sub-array
-    qsort_core(data, i, hi_ix, call_depth + 1, max_call_depth, spawn_threads);
+    qsort_core(data, hi_ix - rsize + 1, hi_ix, call_depth + 1,
+               max_call_depth, spawn_threads, three_way, &rpred);
 
     // wait for the child to finish
     pthread_join(cthread, NULL);
@@ -141,17 +256,37 @@ void *qsort_core_thread(void *arg)
 {
   qsort_info_t *qsort_info = (qsort_info_t *) arg;
 
+  sort_thread_start();
+
   qsort_core(qsort_info->data, qsort_info->lo_ix, qsort_info->hi_ix,
-             qsort_info->call_depth, qsort_info->max_call_depth, true);
+             qsort_info->call_depth, qsort_info->max_call_depth, true,
+             qsort_info->three_way, qsort_info->pred);
 
+  sort_thread_end();
   return NULL;
 }
 
+// max recursion depth before qsort_core falls back to heapsort
+static unsigned short
+qsort_max_call_depth(size_t lo_ix, size_t hi_ix)
+{
+  return (unsigned short) (QSORT_DEPTH_FACTOR * log2((double) (hi_ix - lo_ix + 1)));
+}
+
 // optimized, possibly multi-threaded version of quicksort
-void quicksort_opt(long *data, uint lo_ix, uint hi_ix,
+void quicksort_opt(long *data, size_t lo_ix, size_t hi_ix,
                    bool multithread)
 {
-  qsort_core(data, (int) lo_ix, (int) hi_ix, 0,
-             (unsigned short) (2 * 3.32 * log10((double) (hi_ix - lo_ix + 1))),
-             multithread);
+  qsort_core(data, lo_ix, hi_ix, 0, qsort_max_call_depth(lo_ix, hi_ix),
+             multithread, false, NULL);
+}
+
+// quicksort_opt for inputs with many duplicate values: partitions with
+// duplicates of the pivot are three-way, so sorting n values drawn from
+// k distinct keys is O(n log k)
+void quicksort_3way(long *data, size_t lo_ix, size_t hi_ix,
+                    bool multithread)
+{
+  qsort_core(data, lo_ix, hi_ix, 0, qsort_max_call_depth(lo_ix, hi_ix),
+             multithread, true, NULL);
 }
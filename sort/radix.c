@@ -0,0 +1,172 @@
+//
+// radix.c
+//
+// lsd radix sort of longs, a byte per pass; with multithread every
+// thread histograms and scatters its own slice of each pass, at
+// offsets worked out from everyone's histograms
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "sorts.h"
+#include "sortstats.h"
+
+enum {
+  RADIX_BITS    = 8,
+  RADIX_BUCKETS = 1 << RADIX_BITS,
+  RADIX_PASSES  = 64 / RADIX_BITS
+};
+
+// flipping the sign bit orders longs as unsigned digits
+static const uint64_t RADIX_SIGN = 1ULL << 63;
+
+// state shared by the threads of one sort
+typedef struct {
+  long   *data;
+  long   *tmpdata;
+  size_t  nelts;
+  size_t  nthreads;
+  size_t (*hist)[RADIX_BUCKETS];   // per-thread digit counts
+  pthread_barrier_t barrier;
+} radix_shared_t;
+
+typedef struct {
+  radix_shared_t *sh;
+  size_t          id;
+} radix_info_t;
+
+static inline size_t
+digit(long val, unsigned shift)
+{
+  return (((uint64_t) val ^ RADIX_SIGN) >> shift) & (RADIX_BUCKETS - 1);
+}
+
+// sort pass by pass; src and dst swap after each pass that isn't
+// skipped (because all the elements have the same digit)
+static void
+radix_core(radix_shared_t *sh, size_t id)
+{
+  size_t  lo = sh->nelts / sh->nthreads * id;
+  size_t  hi = (id == sh->nthreads - 1) ? sh->nelts : lo + sh->nelts / sh->nthreads;
+  size_t *hist = sh->hist[id];
+  size_t  offsets[RADIX_BUCKETS];
+  long   *src = sh->data, *dst = sh->tmpdata, *swap;
+  size_t  i, b, t, total, sum;
+  unsigned pass, shift;
+  bool    skip;
+
+  for (pass = 0; pass < RADIX_PASSES; pass++) {
+    shift = pass * RADIX_BITS;
+
+    memset(hist, 0, RADIX_BUCKETS * sizeof(size_t));
+    for (i = lo; i < hi; i++)
+      hist[digit(src[i], shift)]++;
+    pthread_barrier_wait(&sh->barrier);
+
+    // our slice's elements with digit b go after all smaller digits,
+    // and after the lower-numbered threads' elements with digit b
+    skip = false;
+    sum = 0;
+    for (b = 0; b < RADIX_BUCKETS; b++) {
+      total = 0;
+      for (t = 0; t < sh->nthreads; t++) {
+        if (t == id)
+          offsets[b] = sum + total;
+        total += sh->hist[t][b];
+      }
+      if (total == sh->nelts)
+        skip = true;
+      sum += total;
+    }
+
+    if (!skip) {
+      for (i = lo; i < hi; i++)
+        dst[offsets[digit(src[i], shift)]++] = src[i];
+      SORT_STAT_ADD(bytes_moved, (hi - lo) * sizeof(long));
+
+      swap = src;
+      src = dst;
+      dst = swap;
+    }
+
+    // nobody may overwrite a histogram (or read dst) before the others
+    // are done with this pass
+    pthread_barrier_wait(&sh->barrier);
+  }
+
+  if (src != sh->data)
+    memcpy(&sh->data[lo], &src[lo], (hi - lo) * sizeof(long));
+}
+
+static void *
+radix_thread(void *arg)
+{
+  radix_info_t *info = (radix_info_t *) arg;
+
+  sort_thread_start();
+  radix_core(info->sh, info->id);
+  sort_thread_end();
+
+  return NULL;
+}
+
+// sort data[0 .. nelts - 1], using tmpdata[0 .. nelts - 1] as scratch
+// (allocated here if tmpdata is NULL)
+void
+radix_sort(long *data, long *tmpdata, size_t nelts, bool multithread)
+{
+  radix_shared_t sh;
+  radix_info_t  *info;
+  pthread_t     *threads;
+  size_t         t;
+  int            rc;
+  bool           own_tmp = (tmpdata == NULL);
+
+  if (nelts < RADIX_MIN_NELTS) {
+    if (nelts > 1)
+      quicksort_opt(data, 0, nelts - 1, false);
+    return;
+  }
+
+  if (own_tmp) {
+    tmpdata = malloc(nelts * sizeof(long));
+    assert(tmpdata != NULL);
+  }
+
+  sh.data = data;
+  sh.tmpdata = tmpdata;
+  sh.nelts = nelts;
+  sh.nthreads = multithread ? sort_get_threads() : 1;
+  if (sh.nthreads > nelts / RADIX_THREAD_NELTS)
+    sh.nthreads = (nelts / RADIX_THREAD_NELTS > 0) ? nelts / RADIX_THREAD_NELTS : 1;
+
+  sh.hist = malloc(sh.nthreads * sizeof(*sh.hist));
+  info = malloc(sh.nthreads * sizeof(radix_info_t));
+  threads = malloc(sh.nthreads * sizeof(pthread_t));
+  assert(sh.hist != NULL && info != NULL && threads != NULL);
+  pthread_barrier_init(&sh.barrier, NULL, (unsigned) sh.nthreads);
+
+  // the calling thread takes slice 0
+  for (t = 1; t < sh.nthreads; t++) {
+    info[t].sh = &sh;
+    info[t].id = t;
+    rc = pthread_create(&threads[t], NULL, &radix_thread, &info[t]);
+    assert(rc == 0);
+    SORT_STAT_ADD(thread_spawns, 1);
+  }
+  radix_core(&sh, 0);
+  for (t = 1; t < sh.nthreads; t++)
+    pthread_join(threads[t], NULL);
+
+  pthread_barrier_destroy(&sh.barrier);
+  free(sh.hist);
+  free(info);
+  free(threads);
+  if (own_tmp)
+    free(tmpdata);
+}
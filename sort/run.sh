@@ -11,3 +11,6 @@
 ./sorts -m 1   -c 100000    > sorts.1m.c100k.txt
 ./sorts -m 10  -c 100000    > sorts.10m.c100k.txt
 ./sorts -m 100 -c 100000    > sorts.100m.c100k.txt
+
+# large-array regression (> 4G elements, ~34 GB); -f backs it with a file
+# ./bigsort -f /scratch/bigsort.dat > bigsort.4g.txt
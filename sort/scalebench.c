@@ -0,0 +1,220 @@
+//
+// scalebench.c
+//
+// thread scaling of the parallel sorts: runs each of them at 1, 2, 4
+// ... threads, up to the number of cpus, and reports speedup and
+// parallel efficiency
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+
+enum {
+  SCALE_QSORT_MT,
+  SCALE_QSORT_3WAY_MT,
+  SCALE_SEGMENTED_MT,
+  SCALE_UNIQUE_MT,
+  SCALE_NMETHODS,
+
+  // segment length for the segmented sort runs
+  SCALE_SEGMENT_NELTS = 1000
+};
+
+static const char *scale_method_names[] = {
+  "quicksort opt mt", "quicksort 3-way mt", "segmented sort mt",
+  "sort_unique mt"
+};
+
+// a run is flagged as memory bound when its estimated memory traffic
+// reaches this fraction of the measured copy bandwidth
+static const double MEMORY_BOUND_FRACTION = 0.6;
+
+typedef struct {
+  long   *dst;
+  long   *src;
+  size_t  nelts;
+} copy_info_t;
+
+static void *
+copy_thread(void *arg)
+{
+  copy_info_t *info = (copy_info_t *) arg;
+
+  sort_thread_start();
+  memcpy(info->dst, info->src, info->nelts * sizeof(long));
+  sort_thread_end();
+
+  return NULL;
+}
+
+// copy bandwidth (bytes read + written per second) of nthreads
+// threads each memcpy'ing its share of src to dst
+static double
+copy_bandwidth(long *dst, long *src, size_t nelts, size_t nthreads)
+{
+  struct timeval tv_start, tv_end;
+  pthread_t   *threads = malloc(nthreads * sizeof(pthread_t));
+  copy_info_t *info = malloc(nthreads * sizeof(copy_info_t));
+  size_t       t, share = nelts / nthreads;
+  int          rc;
+
+  assert(threads != NULL && info != NULL);
+
+  gettimeofday(&tv_start, NULL);
+  for (t = 0; t < nthreads; t++) {
+    info[t].dst = &dst[t * share];
+    info[t].src = &src[t * share];
+    info[t].nelts = (t == nthreads - 1) ? nelts - t * share : share;
+    rc = pthread_create(&threads[t], NULL, &copy_thread, &info[t]);
+    assert(rc == 0);
+  }
+  for (t = 0; t < nthreads; t++)
+    pthread_join(threads[t], NULL);
+  gettimeofday(&tv_end, NULL);
+
+  free(threads);
+  free(info);
+
+  return 2.0 * nelts * sizeof(long) / elapsed(&tv_start, &tv_end);
+}
+
+// rough estimate of the bytes a method reads and writes: partitioning
+// reads and writes the array once per level until the pieces fit in
+// cache; segmented sort touches every element once
+static double
+estimated_traffic(int method, size_t nelts, size_t unique_traffic)
+{
+  double levels = log2((double) nelts / (32 * K));
+
+  if (levels < 1)
+    levels = 1;
+
+  switch (method) {
+    case SCALE_QSORT_MT:
+    case SCALE_QSORT_3WAY_MT:
+    return 2.0 * nelts * sizeof(long) * levels;
+
+    case SCALE_SEGMENTED_MT:
+    return 2.0 * nelts * sizeof(long);
+
+    case SCALE_UNIQUE_MT:
+    return 2.0 * nelts * sizeof(long) + unique_traffic;
+  }
+
+  return 0;
+}
+
+int
+scaling_bench(long *origdata, size_t nelts, sort_affinity_t affinity)
+{
+  struct timeval tv_start, tv_end;
+  long    *data, *tmpdata;
+  size_t  *offsets;
+  size_t   nsegs, s, ncpus, maxthreads, nthreads, traffic;
+  double   wall, cpu, base_wall = 0, speedup, efficiency, bw, achieved;
+  int      method;
+
+  data = calloc(nelts, sizeof(long));
+  tmpdata = calloc(nelts, sizeof(long));
+  nsegs = (nelts + SCALE_SEGMENT_NELTS - 1) / SCALE_SEGMENT_NELTS;
+  offsets = malloc((nsegs + 1) * sizeof(size_t));
+  if (data == NULL || tmpdata == NULL || offsets == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  for (s = 0; s < nsegs; s++)
+    offsets[s] = s * SCALE_SEGMENT_NELTS;
+  offsets[nsegs] = nelts;
+
+  // powers of two only: quicksort_opt spawns threads by halving, so
+  // with 6 threads it only ever runs 4 at once, and the efficiency
+  // would be divided by threads that never ran
+  ncpus = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+  for (maxthreads = 1; 2 * maxthreads <= ncpus; maxthreads *= 2)
+    ;
+  sort_set_affinity(affinity);
+
+  // fault in tmpdata so the first bandwidth measurement isn't low
+  copy_bandwidth(tmpdata, origdata, nelts, 1);
+
+  printf("scaling: 1 .. %zu threads, %s placement\n\n", maxthreads,
+         affinity == SORT_AFFINITY_COMPACT ? "compact" :
+         affinity == SORT_AFFINITY_SCATTER ? "scatter" : "unpinned");
+
+  for (method = 0; method < SCALE_NMETHODS; method++) {
+    printf("sorting: sort method is %s\n", scale_method_names[method]);
+    printf("%8s %9s %9s %8s %7s %8s %6s\n", "threads", "wall(s)", "cpu(s)",
+           "speedup", "effic", "GB/s", "of bw");
+
+    for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+      sort_set_threads(nthreads);
+      sort_threads_reset();
+      bw = copy_bandwidth(tmpdata, origdata, nelts, nthreads);
+
+      memcpy(data, origdata, nelts * sizeof(long));
+      traffic = 0;
+
+      sort_threads_reset();
+      gettimeofday(&tv_start, NULL);
+      switch (method) {
+        case SCALE_QSORT_MT:
+        quicksort_opt(data, 0, nelts - 1, true);
+        break;
+
+        case SCALE_QSORT_3WAY_MT:
+        quicksort_3way(data, 0, nelts - 1, true);
+        break;
+
+        case SCALE_SEGMENTED_MT:
+        segmented_sort(data, offsets, nsegs, true);
+        break;
+
+        case SCALE_UNIQUE_MT:
+        sort_unique(data, nelts, true, &traffic);
+        break;
+      }
+      gettimeofday(&tv_end, NULL);
+      sort_thread_end();
+
+      wall = elapsed(&tv_start, &tv_end);
+      cpu = sort_threads_cpu_time();
+      if (nthreads == 1)
+        base_wall = wall;
+      speedup = base_wall / wall;
+      efficiency = speedup / nthreads;
+      achieved = estimated_traffic(method, nelts, traffic) / wall;
+
+      printf("%8zu %9.3f %9.3f %8.2f %7.2f %8.2f %5.0f%%", nthreads, wall,
+             cpu, speedup, efficiency, achieved / (M * K), 100 * achieved / bw);
+
+      // memory bound: either the traffic is near what plain copying
+      // achieves with as many threads, or the threads are all busy
+      // (so not waiting on each other) but still don't scale
+      if (achieved >= MEMORY_BOUND_FRACTION * bw)
+        printf("  <- memory bandwidth bound");
+      else if (nthreads > 1 && cpu >= 0.9 * wall * nthreads && efficiency < 0.5)
+        printf("  <- busy but not scaling (memory bound?)");
+      printf("\n");
+    }
+    printf("\n");
+  }
+
+  sort_set_threads(0);
+  sort_set_affinity(SORT_AFFINITY_NONE);
+
+  free(data);
+  free(tmpdata);
+  free(offsets);
+  return 0;
+}
@@ -0,0 +1,181 @@
+//
+// segbench.c
+//
+// benchmarking segmented sort against one quicksort_opt call per segment
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+#include "sortstats.h"
+
+typedef enum {
+  SEGDIST_FIXED,   // every segment SEGSORT_NETWORK_NELTS long
+  SEGDIST_SMALL,   // uniform in [2 .. SEGSORT_NETWORK_NELTS]
+  SEGDIST_UNIFORM, // uniform in [16 .. 1000]
+  SEGDIST_SKEWED   // mostly tiny segments, a long tail of big ones
+} segdist_t;
+
+static const char *segdist_names[] = { "fixed", "small", "uniform", "skewed" };
+
+// length of the next segment for distribution dist
+static size_t
+segment_length(segdist_t dist)
+{
+  size_t len;
+
+  switch (dist) {
+    case SEGDIST_FIXED:
+    return SEGSORT_NETWORK_NELTS;
+
+    case SEGDIST_SMALL:
+    return 2 + random() % (SEGSORT_NETWORK_NELTS - 1);
+
+    case SEGDIST_UNIFORM:
+    return 16 + random() % (1000 - 16 + 1);
+
+    case SEGDIST_SKEWED:
+    // each doubling of the length is half as likely, up to ~1M
+    len = 2;
+    while (len < M && (random() & 1))
+      len *= 2;
+    return len + random() % len;
+  }
+
+  return 0;
+}
+
+// generate segment lengths until they add up to nelts; returns the
+// offsets array (nsegs + 1 entries)
+static size_t *
+generate_segments(size_t nelts, segdist_t dist, size_t *nsegs)
+{
+  size_t  cap = 1024;
+  size_t *offsets = malloc(cap * sizeof(size_t));
+  size_t  n = 0;
+  size_t  len;
+
+  offsets[0] = 0;
+  while (offsets[n] < nelts) {
+    len = segment_length(dist);
+    if (len > nelts - offsets[n])
+      len = nelts - offsets[n];
+
+    if (n + 2 > cap) {
+      cap *= 2;
+      offsets = realloc(offsets, cap * sizeof(size_t));
+    }
+    offsets[n + 1] = offsets[n] + len;
+    n++;
+  }
+
+  *nsegs = n;
+  return offsets;
+}
+
+// true if every segment of data is sorted
+static bool
+check_segments(long *data, const size_t *offsets, size_t nsegs)
+{
+  size_t s;
+
+  for (s = 0; s < nsegs; s++) {
+    if (offsets[s + 1] > offsets[s] &&
+        !check_sort(&data[offsets[s]], offsets[s + 1] - offsets[s]))
+      return false;
+  }
+
+  return true;
+}
+
+int
+segment_bench(size_t nelts, const char *dist_name)
+{
+  struct timeval tv_start, tv_end;
+  segdist_t dist;
+  size_t   *offsets;
+  size_t    nsegs, s, i;
+  long     *data, *origdata;
+  uint64_t  fingerprint;
+  int       method;
+
+  for (dist = SEGDIST_FIXED; dist <= SEGDIST_SKEWED; dist++) {
+    if (strcmp(dist_name, segdist_names[dist]) == 0)
+      break;
+  }
+  if (dist > SEGDIST_SKEWED) {
+    printf("error: unknown segment distribution %s\n", dist_name);
+    return -1;
+  }
+
+  data = calloc(nelts, sizeof(long));
+  origdata = calloc(nelts, sizeof(long));
+  if (data == NULL || origdata == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  offsets = generate_segments(nelts, dist, &nsegs);
+  for (i = 0; i < nelts; i++)
+    origdata[i] = random();
+  fingerprint = sort_fingerprint(origdata, nelts);
+
+  printf("segments: %zu segments, %s lengths, %.1f elements on average\n\n",
+         nsegs, segdist_names[dist], (double) nelts / nsegs);
+
+  for (method = 0; method < 4; method++) {
+    memcpy(data, origdata, nelts * sizeof(long));
+
+    sort_stats_reset();
+    gettimeofday(&tv_start, NULL);
+    switch (method) {
+      case 0:
+      printf("sorting: sort method is quicksort opt per segment\n");
+      for (s = 0; s < nsegs; s++) {
+        if (offsets[s + 1] - offsets[s] > 1)
+          quicksort_opt(data, offsets[s], offsets[s + 1] - 1, false);
+      }
+      break;
+
+      case 1:
+      printf("sorting: sort method is quicksort opt mt per segment\n");
+      for (s = 0; s < nsegs; s++) {
+        if (offsets[s + 1] - offsets[s] > 1)
+          quicksort_opt(data, offsets[s], offsets[s + 1] - 1, true);
+      }
+      break;
+
+      case 2:
+      printf("sorting: sort method is segmented sort\n");
+      segmented_sort(data, offsets, nsegs, false);
+      break;
+
+      case 3:
+      printf("sorting: sort method is segmented sort mt\n");
+      segmented_sort(data, offsets, nsegs, true);
+      break;
+    }
+    gettimeofday(&tv_end, NULL);
+
+    if (!check_segments(data, offsets, nsegs))
+      printf("\n**** segments are not sorted!\n");
+
+    if (sort_fingerprint(data, nelts) != fingerprint)
+      printf("\n**** segments are not a permutation of the input!\n");
+
+    printf("finished: sorted %zu segments in %.2f seconds\n", nsegs,
+           elapsed(&tv_start, &tv_end));
+    sort_stats_print();
+    printf("\n");
+  }
+
+  free(offsets);
+  free(data);
+  free(origdata);
+  return 0;
+}
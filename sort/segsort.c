@@ -0,0 +1,267 @@
+//
+// segsort.c
+//
+// segmented sort: sort many independent segments of one flat array in
+// a single call
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "sorts.h"
+#include "sortstats.h"
+
+// four longs per vector, i.e. one AVX2 register; gcc splits the vector
+// operations into SSE or scalar code on targets without AVX2
+typedef long segvec_t __attribute__ ((vector_size (SEGSORT_LANES * sizeof(long))));
+
+// comparators of the sorting network for each segment length
+// 2 .. SEGSORT_NETWORK_NELTS (Batcher's merge exchange, Knuth 5.2.2M)
+typedef struct {
+  unsigned char ncomparators;
+  unsigned char lo[SEGSORT_MAX_COMPARATORS];
+  unsigned char hi[SEGSORT_MAX_COMPARATORS];
+} segsort_network_t;
+
+static segsort_network_t segsort_networks[SEGSORT_NETWORK_NELTS + 1];
+static pthread_once_t    segsort_networks_once = PTHREAD_ONCE_INIT;
+
+// shared state of the threads sorting the segments
+typedef struct {
+  long          *data;
+  const size_t  *offsets;
+  const size_t  *order;    // segment numbers, network lengths first
+  size_t         norder;
+  size_t         next;     // next position in order to hand out
+} segsort_info_t;
+
+// generate the merge exchange network for every segment length
+static void
+segsort_build_networks(void)
+{
+  size_t n, t, p, q, r, d, i;
+  segsort_network_t *net;
+
+  for (n = 2; n <= SEGSORT_NETWORK_NELTS; n++) {
+    net = &segsort_networks[n];
+    net->ncomparators = 0;
+
+    for (t = 0; ((size_t) 1 << t) < n; t++)
+      ;
+
+    for (p = (size_t) 1 << (t - 1); p > 0; p >>= 1) {
+      q = (size_t) 1 << (t - 1);
+      r = 0;
+      d = p;
+      while (true) {
+        for (i = 0; i + d < n; i++) {
+          if ((i & p) == r) {
+            assert(net->ncomparators < SEGSORT_MAX_COMPARATORS);
+            net->lo[net->ncomparators] = i;
+            net->hi[net->ncomparators] = i + d;
+            net->ncomparators++;
+          }
+        }
+        if (q == p)
+          break;
+        d = q - p;
+        q >>= 1;
+        r = p;
+      }
+    }
+  }
+}
+
+// sort up to SEGSORT_LANES segments of the same length nelts at once
+//
+// the segments are transposed so that element i of every segment sits
+// in one vector, and each comparator of the network is then a single
+// vector min/max across all the segments
+__attribute__ ((target_clones ("avx2", "default")))
+static void
+segsort_network(long *data, const size_t *offsets, const size_t *segs,
+                size_t nsegs, size_t nelts)
+{
+  const segsort_network_t *net = &segsort_networks[nelts];
+  segvec_t v[SEGSORT_NETWORK_NELTS];
+  segvec_t a, b, gt;
+  size_t   i, l;
+
+  for (i = 0; i < nelts; i++) {
+    for (l = 0; l < SEGSORT_LANES; l++)
+      v[i][l] = (l < nsegs) ? data[offsets[segs[l]] + i] : LONG_MAX;
+  }
+
+  SORT_STAT_ADD(compares, net->ncomparators * nsegs);
+
+  for (i = 0; i < net->ncomparators; i++) {
+    a = v[net->lo[i]];
+    b = v[net->hi[i]];
+    gt = a > b;
+    v[net->lo[i]] = (b & gt) | (a & ~gt);
+    v[net->hi[i]] = (a & gt) | (b & ~gt);
+  }
+
+  for (i = 0; i < nelts; i++) {
+    for (l = 0; l < nsegs; l++)
+      data[offsets[segs[l]] + i] = v[i][l];
+  }
+}
+
+// sort the segments order[first .. last - 1]
+static void
+segsort_range(long *data, const size_t *offsets, const size_t *order,
+              size_t first, size_t last)
+{
+  size_t i, n, nelts;
+
+  i = first;
+  while (i < last) {
+    nelts = offsets[order[i] + 1] - offsets[order[i]];
+
+    // batch up consecutive segments with the same (small) length
+    if (nelts <= SEGSORT_NETWORK_NELTS) {
+      for (n = 1; n < SEGSORT_LANES && i + n < last; n++) {
+        if (offsets[order[i + n] + 1] - offsets[order[i + n]] != nelts)
+          break;
+      }
+      segsort_network(data, offsets, &order[i], n, nelts);
+      i += n;
+    }
+    else {
+      quicksort_opt(data, offsets[order[i]], offsets[order[i]] + nelts - 1,
+                    false);
+      i++;
+    }
+  }
+}
+
+// thread body: keep grabbing chunks of segments until there are none
+static void *
+segsort_thread(void *arg)
+{
+  segsort_info_t *info = (segsort_info_t *) arg;
+  size_t first;
+
+  sort_thread_start();
+
+  while (true) {
+    first = __atomic_fetch_add(&info->next, SEGSORT_CHUNK_NSEGS,
+                               __ATOMIC_RELAXED);
+    if (first >= info->norder)
+      break;
+
+    segsort_range(info->data, info->offsets, info->order, first,
+                  (first + SEGSORT_CHUNK_NSEGS < info->norder) ?
+                  first + SEGSORT_CHUNK_NSEGS : info->norder);
+  }
+
+  sort_thread_end();
+  return NULL;
+}
+
+// segmented sort
+//
+// input params
+//
+// . data: flat array holding all the segments back to back
+// . offsets: nsegs + 1 offsets into data; segment s is
+//   data[offsets[s] .. offsets[s + 1] - 1]
+// . nsegs: number of segments
+// . multithread: spread the segments across threads
+//
+// output:
+//
+//   every segment of data is sorted
+//
+// segments of up to SEGSORT_NETWORK_NELTS elements are sorted in
+// batches through vectorized sorting networks, larger ones with
+// quicksort_opt on whichever thread picks them up, and segments of
+// more than SEGSORT_MT_NELTS elements with multithreaded quicksort_opt
+void
+segmented_sort(long *data, const size_t *offsets, size_t nsegs,
+               bool multithread)
+{
+  size_t   *order;
+  size_t   *large;
+  size_t    count[SEGSORT_NETWORK_NELTS + 2];
+  size_t    pos[SEGSORT_NETWORK_NELTS + 2];
+  size_t    s, nelts, cls, norder, nlarge, nthreads, i;
+  pthread_t *threads;
+  segsort_info_t info;
+  int       rc;
+
+  pthread_once(&segsort_networks_once, &segsort_build_networks);
+
+  // counting sort of the segments by length class: one class per
+  // network length, then one for everything sorted by quicksort_opt;
+  // huge segments go on a separate list
+  memset(count, 0, sizeof(count));
+  nlarge = 0;
+  for (s = 0; s < nsegs; s++) {
+    nelts = offsets[s + 1] - offsets[s];
+    if (nelts > SEGSORT_MT_NELTS)
+      nlarge++;
+    else if (nelts > 1)
+      count[(nelts <= SEGSORT_NETWORK_NELTS) ? nelts : SEGSORT_NETWORK_NELTS + 1]++;
+  }
+
+  norder = 0;
+  for (cls = 0; cls <= SEGSORT_NETWORK_NELTS + 1; cls++) {
+    pos[cls] = norder;
+    norder += count[cls];
+  }
+
+  order = malloc((norder + nlarge + 1) * sizeof(size_t));
+  assert(order != NULL);
+  large = &order[norder];
+
+  nlarge = 0;
+  for (s = 0; s < nsegs; s++) {
+    nelts = offsets[s + 1] - offsets[s];
+    if (nelts > SEGSORT_MT_NELTS)
+      large[nlarge++] = s;
+    else if (nelts > 1)
+      order[pos[(nelts <= SEGSORT_NETWORK_NELTS) ? nelts : SEGSORT_NETWORK_NELTS + 1]++] = s;
+  }
+
+  nthreads = multithread ? sort_get_threads() : 1;
+  if (nthreads > (norder + SEGSORT_CHUNK_NSEGS - 1) / SEGSORT_CHUNK_NSEGS)
+    nthreads = (norder + SEGSORT_CHUNK_NSEGS - 1) / SEGSORT_CHUNK_NSEGS;
+
+  if (nthreads <= 1) {
+    segsort_range(data, offsets, order, 0, norder);
+  }
+  else {
+    info.data = data;
+    info.offsets = offsets;
+    info.order = order;
+    info.norder = norder;
+    info.next = 0;
+
+    threads = malloc(nthreads * sizeof(pthread_t));
+    assert(threads != NULL);
+
+    for (i = 0; i < nthreads; i++) {
+      rc = pthread_create(&threads[i], NULL, &segsort_thread, &info);
+      assert(rc == 0);
+      SORT_STAT_ADD(thread_spawns, 1);
+    }
+    for (i = 0; i < nthreads; i++)
+      pthread_join(threads[i], NULL);
+
+    free(threads);
+  }
+
+  // the huge segments get all the threads to themselves
+  for (i = 0; i < nlarge; i++)
+    quicksort_opt(data, offsets[large[i]], offsets[large[i] + 1] - 1,
+                  multithread);
+
+  free(order);
+}
@@ -0,0 +1,74 @@
+//
+// shmbench.c
+//
+// benchmarking the multi-process shared memory sort at 1, 2, 4 ...
+// ncpus processes against quicksort_opt mt, with per-phase timing
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+
+int
+shm_bench(long *origdata, size_t nelts)
+{
+  struct timeval tv_start, tv_end;
+  shm_sort_times_t times;
+  long    *data;
+  size_t   nprocs, maxprocs;
+  uint64_t fingerprint = sort_fingerprint(origdata, nelts);
+
+  data = calloc(nelts, sizeof(long));
+  if (data == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  printf("sorting: sort method is quicksort opt mt\n");
+  memcpy(data, origdata, nelts * sizeof(long));
+  gettimeofday(&tv_start, NULL);
+  quicksort_opt(data, 0, nelts - 1, true);
+  gettimeofday(&tv_end, NULL);
+  printf("finished: sorted %zu elements in %.2f seconds\n\n", nelts,
+         elapsed(&tv_start, &tv_end));
+
+  // at least two workers, so the exchange gets exercised
+  maxprocs = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+  if (maxprocs < 2)
+    maxprocs = 2;
+  if (maxprocs > SHMSORT_MAX_PROCS)
+    maxprocs = SHMSORT_MAX_PROCS;
+
+  printf("sorting: sort method is shm sort (sample sort across processes)\n");
+  printf("%6s %9s %9s %9s %9s %9s %9s\n", "procs", "wall(s)", "local",
+         "splitter", "exchange", "merge", "slowest");
+
+  for (nprocs = 1; ; nprocs = (nprocs * 2 < maxprocs) ? nprocs * 2 : maxprocs) {
+    memcpy(data, origdata, nelts * sizeof(long));
+
+    gettimeofday(&tv_start, NULL);
+    if (!shm_sort(data, nelts, nprocs, &times))
+      return -1;
+    gettimeofday(&tv_end, NULL);
+
+    printf("%6zu %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", nprocs,
+           elapsed(&tv_start, &tv_end), times.local_sort, times.splitters,
+           times.exchange, times.merge, times.total);
+
+    if (!check_sort_perm(data, nelts, fingerprint))
+      printf("\n**** shm sort produced the wrong result!\n");
+
+    if (nprocs == maxprocs)
+      break;
+  }
+  printf("\n");
+
+  free(data);
+  return 0;
+}
@@ -0,0 +1,491 @@
+//
+// shmsort.c
+//
+// multi-process sample sort over a POSIX shared memory segment: the
+// caller forks worker processes, standing in for the nodes of a
+// distributed sort, which sort their shards, agree on splitters from
+// each other's samples, exchange the pieces through single-producer
+// single-consumer ring buffers and merge what they receive
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "sorts.h"
+#include "bench.h" /* elapsed */
+
+enum {
+  SHM_ALIGN = 64,
+  SHM_POLL_USECS = 1000   // how often shm_sort checks on its workers
+};
+
+// one direction of the all-to-all exchange; head is only written by
+// the sending worker and tail by the receiving one
+typedef struct {
+  size_t head __attribute__ ((aligned (SHM_ALIGN)));
+  size_t tail __attribute__ ((aligned (SHM_ALIGN)));
+  long   buf[SHMSORT_RING_NELTS] __attribute__ ((aligned (SHM_ALIGN)));
+} shm_ring_t;
+
+// start of the segment; the arrays follow at the offsets given here
+typedef struct {
+  pthread_barrier_t barrier;
+  size_t nprocs;
+  size_t nelts;
+  size_t data_off;     // long [nelts]: shards in, sorted result out
+  size_t samples_off;  // long [nprocs][SHMSORT_SAMPLES]
+  size_t counts_off;   // size_t [nprocs][nprocs]: piece sizes, src x dst
+  size_t times_off;    // shm_sort_times_t [nprocs]
+  size_t rings_off;    // shm_ring_t [nprocs][nprocs], src x dst
+  size_t size;
+} shm_header_t;
+
+// a worker's view of the segment
+typedef struct {
+  shm_header_t     *hdr;
+  long             *data;
+  long             *samples;
+  size_t           *counts;
+  shm_sort_times_t *times;
+  shm_ring_t       *rings;
+  size_t            self;
+  size_t            nprocs;
+} shm_worker_t;
+
+static double
+max_time(double a, double b)
+{
+  return (a > b) ? a : b;
+}
+
+static size_t
+align_up(size_t n)
+{
+  return (n + SHM_ALIGN - 1) & ~((size_t) SHM_ALIGN - 1);
+}
+
+// seconds since *tv, which is then set to now
+static double
+lap(struct timeval *tv)
+{
+  struct timeval now;
+  double secs;
+
+  gettimeofday(&now, NULL);
+  secs = elapsed(tv, &now);
+  *tv = now;
+
+  return secs;
+}
+
+// shard w of nelts elements split nprocs ways
+static size_t
+shard_start(size_t nelts, size_t nprocs, size_t w)
+{
+  // nelts * w / nprocs without overflowing
+  return nelts / nprocs * w + nelts % nprocs * w / nprocs;
+}
+
+// first index in data[0 .. n - 1] (sorted) whose value is > key
+static size_t
+upper_bound(const long *data, size_t n, long key)
+{
+  size_t lo = 0, hi = n, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (data[mid] <= key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+// splitters from everyone's samples: every worker computes the same
+// nprocs - 1 values, so they agree without another round of messages
+static void
+choose_splitters(shm_worker_t *w, long *splitters)
+{
+  size_t nsamples = w->nprocs * SHMSORT_SAMPLES;
+  long  *all = malloc(nsamples * sizeof(long));
+  size_t s;
+
+  assert(all != NULL);
+
+  memcpy(all, w->samples, nsamples * sizeof(long));
+  quicksort_opt(all, 0, nsamples - 1, false);
+  for (s = 1; s < w->nprocs; s++)
+    splitters[s - 1] = all[s * nsamples / w->nprocs];
+
+  free(all);
+}
+
+// send piece[d] of our shard to each worker d and receive each worker's
+// piece for us into recv, at recv_off[s]; everything goes through the
+// rings except our own piece. both sides move as much as they can on
+// each pass so nobody waits on a full ring while holding up another
+static void
+exchange(shm_worker_t *w, long *shard, const size_t *piece_off,
+         long *recv, const size_t *recv_off)
+{
+  size_t  p = w->nprocs, self = w->self;
+  size_t *sent = calloc(p, sizeof(size_t));
+  size_t *rcvd = calloc(p, sizeof(size_t));
+  size_t  d, s, n, head, tail, room, i, todo, before;
+  shm_ring_t *ring;
+
+  assert(sent != NULL && rcvd != NULL);
+
+  memcpy(&recv[recv_off[self]], &shard[piece_off[self]],
+         (piece_off[self + 1] - piece_off[self]) * sizeof(long));
+
+  todo = 0;
+  for (d = 0; d < p; d++) {
+    if (d != self) {
+      todo += piece_off[d + 1] - piece_off[d];
+      todo += w->counts[d * p + self];
+    }
+  }
+
+  while (todo > 0) {
+    before = todo;
+
+    for (d = 0; d < p; d++) {
+      n = piece_off[d + 1] - piece_off[d] - sent[d];
+      if (d == self || n == 0)
+        continue;
+      ring = &w->rings[self * p + d];
+      head = ring->head;
+      tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+      room = SHMSORT_RING_NELTS - (head - tail);
+      if (n > room)
+        n = room;
+      for (i = 0; i < n; i++)
+        ring->buf[(head + i) % SHMSORT_RING_NELTS] = shard[piece_off[d] + sent[d] + i];
+      __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+      sent[d] += n;
+      todo -= n;
+    }
+
+    for (s = 0; s < p; s++) {
+      n = w->counts[s * p + self] - rcvd[s];
+      if (s == self || n == 0)
+        continue;
+      ring = &w->rings[s * p + self];
+      tail = ring->tail;
+      head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+      if (n > head - tail)
+        n = head - tail;
+      for (i = 0; i < n; i++)
+        recv[recv_off[s] + rcvd[s] + i] = ring->buf[(tail + i) % SHMSORT_RING_NELTS];
+      __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+      rcvd[s] += n;
+      todo -= n;
+    }
+
+    // rings all full or empty: let the other workers run
+    if (todo == before)
+      sched_yield();
+  }
+
+  free(sent);
+  free(rcvd);
+}
+
+// head of a run in merge_runs' heap
+typedef struct {
+  long   value;
+  size_t run;
+} shm_head_t;
+
+// restore the min-heap below heap[i] after its value grew
+static void
+sift_head(shm_head_t *heap, size_t n, size_t i)
+{
+  shm_head_t t = heap[i];
+  size_t     c;
+
+  while ((c = 2 * i + 1) < n) {
+    if (c + 1 < n && heap[c + 1].value < heap[c].value)
+      c++;
+    if (t.value <= heap[c].value)
+      break;
+    heap[i] = heap[c];
+    i = c;
+  }
+  heap[i] = t;
+}
+
+// merge the nruns sorted runs recv[off[r] .. off[r + 1] - 1] into out,
+// keeping the run heads in a min-heap so each output element costs
+// O(log nruns) rather than a scan of every run
+static void
+merge_runs(const long *recv, const size_t *off, size_t nruns, long *out)
+{
+  shm_head_t *heap = malloc((nruns > 0 ? nruns : 1) * sizeof(shm_head_t));
+  size_t     *pos = malloc((nruns > 0 ? nruns : 1) * sizeof(size_t));
+  size_t      r, n = 0, t = 0, i;
+
+  assert(heap != NULL && pos != NULL);
+
+  for (r = 0; r < nruns; r++) {
+    pos[r] = off[r];
+    if (pos[r] < off[r + 1]) {
+      heap[n].value = recv[pos[r]];
+      heap[n].run = r;
+      n++;
+    }
+  }
+  for (i = n / 2; i-- > 0; )
+    sift_head(heap, n, i);
+
+  while (n > 0) {
+    r = heap[0].run;
+    out[t++] = heap[0].value;
+    if (++pos[r] < off[r + 1])
+      heap[0].value = recv[pos[r]];
+    else
+      heap[0] = heap[--n];
+    sift_head(heap, n, 0);
+  }
+
+  free(heap);
+  free(pos);
+}
+
+// body of worker process self
+static void
+shm_worker(shm_worker_t *w)
+{
+  struct timeval tv, tv_start;
+  shm_sort_times_t *times = &w->times[w->self];
+  size_t  p = w->nprocs, self = w->self, nelts = w->hdr->nelts;
+  size_t  lo = shard_start(nelts, p, self);
+  size_t  n = shard_start(nelts, p, self + 1) - lo;
+  long   *shard = &w->data[lo];
+  long   *splitters, *recv;
+  size_t *piece_off, *recv_off;
+  size_t  d, s, nrecv, out_lo;
+
+  gettimeofday(&tv, NULL);
+  tv_start = tv;
+
+  // local sort, then publish samples spaced evenly through the shard
+  if (n > 1)
+    quicksort_opt(shard, 0, n - 1, false);
+  for (s = 0; s < SHMSORT_SAMPLES; s++) {
+    w->samples[self * SHMSORT_SAMPLES + s] =
+      (n > 0) ? shard[(2 * s + 1) * n / (2 * SHMSORT_SAMPLES)] : 0;
+  }
+  times->local_sort = lap(&tv);
+  pthread_barrier_wait(&w->hdr->barrier);
+
+  // agree on splitters, cut the shard into one piece per worker and
+  // publish the piece sizes so everyone knows what it will receive
+  splitters = malloc(p * sizeof(long));
+  piece_off = malloc((p + 1) * sizeof(size_t));
+  recv_off = malloc((p + 1) * sizeof(size_t));
+  assert(splitters != NULL && piece_off != NULL && recv_off != NULL);
+
+  choose_splitters(w, splitters);
+  piece_off[0] = 0;
+  for (d = 1; d < p; d++)
+    piece_off[d] = upper_bound(shard, n, splitters[d - 1]);
+  piece_off[p] = n;
+  for (d = 0; d < p; d++)
+    w->counts[self * p + d] = piece_off[d + 1] - piece_off[d];
+  pthread_barrier_wait(&w->hdr->barrier);
+  times->splitters = lap(&tv);
+
+  // our part of the output starts after everything sent to workers
+  // before us
+  recv_off[0] = 0;
+  out_lo = 0;
+  for (s = 0; s < p; s++) {
+    recv_off[s + 1] = recv_off[s] + w->counts[s * p + self];
+    for (d = 0; d < self; d++)
+      out_lo += w->counts[s * p + d];
+  }
+  nrecv = recv_off[p];
+
+  recv = malloc((nrecv > 0 ? nrecv : 1) * sizeof(long));
+  assert(recv != NULL);
+
+  exchange(w, shard, piece_off, recv, recv_off);
+  // everyone has to be done reading their shards before the output
+  // overwrites them
+  pthread_barrier_wait(&w->hdr->barrier);
+  times->exchange = lap(&tv);
+
+  merge_runs(recv, recv_off, p, &w->data[out_lo]);
+  times->merge = lap(&tv);
+  times->total = elapsed(&tv_start, &tv);
+
+  free(splitters);
+  free(piece_off);
+  free(recv_off);
+  free(recv);
+}
+
+// sort data[0 .. nelts - 1] with nprocs worker processes (at most
+// SHMSORT_MAX_PROCS) that share nothing but a shared memory segment; if
+// times isn't NULL it gets the slowest worker's time for each phase.
+// returns false (after printing why) if the segment or the workers
+// can't be set up or a worker fails, in which case the other workers
+// are killed rather than left at the barrier
+bool
+shm_sort(long *data, size_t nelts, size_t nprocs, shm_sort_times_t *times)
+{
+  pthread_barrierattr_t attr;
+  shm_header_t hdr, *h;
+  shm_worker_t w;
+  char         name[64];
+  pid_t       *pids;
+  size_t       i, k, left;
+  pid_t        rc;
+  int          fd, status;
+  bool         ok = true;
+  void        *base;
+
+  if (nprocs < 1 || nprocs > SHMSORT_MAX_PROCS)
+    return false;
+
+  // lay out the segment
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.nprocs = nprocs;
+  hdr.nelts = nelts;
+  hdr.data_off = align_up(sizeof(shm_header_t));
+  hdr.samples_off = align_up(hdr.data_off + nelts * sizeof(long));
+  hdr.counts_off = align_up(hdr.samples_off +
+                            nprocs * SHMSORT_SAMPLES * sizeof(long));
+  hdr.times_off = align_up(hdr.counts_off + nprocs * nprocs * sizeof(size_t));
+  hdr.rings_off = align_up(hdr.times_off + nprocs * sizeof(shm_sort_times_t));
+  hdr.size = hdr.rings_off + nprocs * nprocs * sizeof(shm_ring_t);
+
+  snprintf(name, sizeof(name), "/shmsort.%d", (int) getpid());
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    printf("error: cannot create shared memory %s: %s\n", name, strerror(errno));
+    return false;
+  }
+  shm_unlink(name);   // the mappings keep it alive
+
+  if (ftruncate(fd, (off_t) hdr.size) != 0) {
+    printf("error: cannot size shared memory: %s\n", strerror(errno));
+    close(fd);
+    return false;
+  }
+  base = mmap(NULL, hdr.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    printf("error: cannot map shared memory: %s\n", strerror(errno));
+    return false;
+  }
+
+  h = (shm_header_t *) base;
+  *h = hdr;
+  pthread_barrierattr_init(&attr);
+  pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(&h->barrier, &attr, (unsigned) nprocs);
+  pthread_barrierattr_destroy(&attr);
+
+  w.hdr = h;
+  w.data = (long *) ((char *) base + h->data_off);
+  w.samples = (long *) ((char *) base + h->samples_off);
+  w.counts = (size_t *) ((char *) base + h->counts_off);
+  w.times = (shm_sort_times_t *) ((char *) base + h->times_off);
+  w.rings = (shm_ring_t *) ((char *) base + h->rings_off);
+  w.nprocs = nprocs;
+
+  memcpy(w.data, data, nelts * sizeof(long));
+
+  pids = malloc(nprocs * sizeof(pid_t));
+  assert(pids != NULL);
+
+  fflush(stdout);
+  for (i = 0; i < nprocs; i++) {
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      w.self = i;
+      shm_worker(&w);
+      _exit(0);
+    }
+    if (pids[i] < 0) {
+      // the others would wait at the barrier forever
+      printf("error: cannot fork: %s\n", strerror(errno));
+      for (k = 0; k < i; k++)
+        kill(pids[k], SIGKILL);
+      ok = false;
+      nprocs = i;
+      break;
+    }
+  }
+
+  // the workers meet at a process-shared barrier, so one that dies
+  // early (a failed assert, the oom killer, a signal) leaves the rest
+  // waiting there forever; poll them all and kill the group as soon as
+  // any of them exits badly
+  left = nprocs;
+  while (left > 0) {
+    for (i = 0; i < nprocs; i++) {
+      if (pids[i] <= 0)
+        continue;
+      rc = waitpid(pids[i], &status, WNOHANG);
+      if (rc == 0)
+        continue;
+      if (rc < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (ok) {
+          // the workers killed here aren't worth reporting
+          printf("error: worker %zu failed\n", i);
+          for (k = 0; k < nprocs; k++) {
+            if (k != i && pids[k] > 0)
+              kill(pids[k], SIGKILL);
+          }
+        }
+        ok = false;
+      }
+      pids[i] = 0;
+      left--;
+    }
+    if (left > 0)
+      usleep(SHM_POLL_USECS);
+  }
+
+  if (ok) {
+    memcpy(data, w.data, nelts * sizeof(long));
+    if (times != NULL) {
+      memset(times, 0, sizeof(*times));
+      for (i = 0; i < nprocs; i++) {
+        times->local_sort = max_time(times->local_sort, w.times[i].local_sort);
+        times->splitters = max_time(times->splitters, w.times[i].splitters);
+        times->exchange = max_time(times->exchange, w.times[i].exchange);
+        times->merge = max_time(times->merge, w.times[i].merge);
+        times->total = max_time(times->total, w.times[i].total);
+      }
+    }
+  }
+
+  // glibc's destroy waits for the barrier to drain, which it never
+  // will if a worker was killed while others were waiting there; the
+  // segment is going away anyway
+  if (ok)
+    pthread_barrier_destroy(&h->barrier);
+  munmap(base, hdr.size);
+  free(pids);
+
+  return ok;
+}
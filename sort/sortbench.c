@@ -10,9 +10,13 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <errno.h>
+#include <stdint.h> /* SIZE_MAX */
 #include <time.h>
 #include <sys/time.h>
 #include "sorts.h"
+#include "bench.h"
+#include "sortstats.h"
 
 typedef enum {
   // SORT_MIN: first value in sort_t
@@ -24,9 +28,13 @@ typedef enum {
   SORT_QSORT,
   SORT_QSORT_OPT,
   SORT_QSORT_MT,
+  SORT_QSORT_3WAY,
+  SORT_QSORT_3WAY_MT,
   SORT_HEAP,
   SORT_MERGE,
   SORT_MERGE_OPT,
+  SORT_RADIX,
+  SORT_RADIX_MT,
 
   SORT_COUNTING,
 
@@ -40,12 +48,13 @@ typedef enum {
 // assuming all the sorts are working correctly, we will only return
 // false for slow sort methods
 static bool
-sort(long *data, long *tmpdata, uint nelts, sort_t sort_method,
+sort(long *data, long *tmpdata, size_t nelts, sort_t sort_method,
      uint maxval /* only used by counting sort */)
 {
   struct timeval tv_start, tv_end;
   double sort_time;
 
+  sort_stats_reset();
   gettimeofday(&tv_start, NULL);
 
   switch(sort_method)
@@ -90,6 +99,16 @@ sort(long *data, long *tmpdata, uint nelts, sort_t sort_method,
     quicksort_opt(data, 0, nelts - 1, true);
     break;
 
+    case SORT_QSORT_3WAY:
+    printf("sorting: sort method is quicksort 3-way\n");
+    quicksort_3way(data, 0, nelts - 1, false);
+    break;
+
+    case SORT_QSORT_3WAY_MT:
+    printf("sorting: sort method is quicksort 3-way mt\n");
+    quicksort_3way(data, 0, nelts - 1, true);
+    break;
+
     case SORT_HEAP:
     printf("sorting: sort method is heapsort\n");
     heapsort(data, 0, nelts - 1);
@@ -105,6 +124,16 @@ sort(long *data, long *tmpdata, uint nelts, sort_t sort_method,
     merge_sort_opt(data, tmpdata, 0, nelts - 1);
     break;
 
+    case SORT_RADIX:
+    printf("sorting: sort method is radix sort\n");
+    radix_sort(data, tmpdata, nelts, false);
+    break;
+
+    case SORT_RADIX_MT:
+    printf("sorting: sort method is radix sort mt\n");
+    radix_sort(data, tmpdata, nelts, true);
+    break;
+
     case SORT_COUNTING:
     printf("sorting: sort method is counting sort\n");
     counting_sort(data, 0, nelts - 1, maxval);
@@ -119,9 +148,10 @@ sort(long *data, long *tmpdata, uint nelts, sort_t sort_method,
   sort_time =
     (double)  (tv_end.tv_sec - tv_start.tv_sec) +
     ((double) (tv_end.tv_usec - tv_start.tv_usec)) / 1E6;
-  assert(check_sort(data, nelts));
 
-  printf("finished: sorted %u elements in %.2f seconds\n\n", nelts, sort_time);
+  printf("finished: sorted %zu elements in %.2f seconds\n", nelts, sort_time);
+  sort_stats_print();
+  printf("\n");
 
   return true;
 }
@@ -131,22 +161,65 @@ void usage()
 {
   printf(
          "usage:\n\n"
-         "sorts [-k val | -m val] [-c maxval]\n\n"
-         "where val is [1..1000] and maxval is [1..100,000,000]\n"
+         "sorts [-k val | -m val | -n nelts] [-c maxval]\n"
+         "      [-s dist | -u | -b batch | -p | -f | -S strings | --shm |\n"
+         "       --scaling [-a compact|scatter]]\n"
+         "sorts -i infile [-o outfile]\n\n"
+         "where val is a multiple of 1024 (-k) or 1024*1024 (-m) elements,\n"
+         "nelts is an exact element count, and maxval is [1..100,000,000]\n"
          "(default is \"-m 100\", i.e., sort a random array of "
          "100 million long ints and omit counting sort)\n\n"
+         "-s splits the elements into segments whose lengths are drawn from\n"
+         "dist (fixed, small, uniform or skewed) and benchmarks segmented "
+         "sort\n"
+         "-u benchmarks the deduplicating sorts (sort_unique, sort_count)\n"
+         "-b benchmarks inserting batches of batch elements into the sorted\n"
+         "elements (sorted_insert_batch, sorted_lsm_insert)\n"
+         "-p benchmarks the pipelined sort (pipe_sort) on generated input\n"
+         "-f benchmarks sorting doubles and floats (sort_doubles, "
+         "sort_floats)\n"
+         "-S benchmarks the string sorts on strings (random, prefix or url)\n"
+         "--shm runs the multi-process sort (shm_sort) at 1, 2, 4 ... ncpus\n"
+         "worker processes\n"
+         "--scaling runs the parallel sorts at 1, 2, 4 ... threads, up to\n"
+         "ncpus, optionally pinned to cpus compactly or scattered (-a)\n"
+         "-i sorts the integers in the text file infile, writing them one\n"
+         "per line to outfile if -o is given, and times parsing, sorting\n"
+         "and formatting separately\n\n"
          );
   exit(-1);
 }
 
+// parse an element count, rejecting anything that isn't a positive
+// number or that overflows size_t once it's multiplied by scale
+static
+size_t parse_count(const char *arg, size_t scale)
+{
+  char *end;
+  unsigned long long val;
+
+  errno = 0;
+  val = strtoull(arg, &end, 10);
+  if (errno != 0 || end == arg || *end != '\0' || val == 0 ||
+      val > SIZE_MAX / scale / sizeof(long))
+    usage();
+
+  return (size_t) val * scale;
+}
+
 // messy function to parse the command-line arguments
 static
-void parse_args(int argc, char * argv[], uint *nelts,
-                bool *incl_count, uint *max_count_val)
+void parse_args(int argc, char * argv[], size_t *nelts,
+                bool *incl_count, uint *max_count_val,
+                const char **seg_dist, bool *unique, size_t *batch_nelts,
+                bool *pipelined,
+                bool *floats, const char **str_data,
+                bool *shm, bool *scaling, sort_affinity_t *affinity,
+                const char **inpath, const char **outpath)
 {
   int i;
   long val;
-  uint num_elts = 0;
+  size_t num_elts = 0;
 
   // should we do the counting sort or not?
   bool do_counting_sort = false;
@@ -166,19 +239,19 @@ void parse_args(int argc, char * argv[], uint *nelts,
       i++;
       if (i == argc)
         usage();
-      val = atoi(argv[i]);
-      if (0 > val || val > 1000)
-        usage();
-      num_elts = val * K;
+      num_elts = parse_count(argv[i], K);
     }
     else if (strcmp(argv[i], "-m") == 0) {
       i++;
       if (i == argc)
         usage();
-      val = atoi(argv[i]);
-      if (0 > val || val > 1000)
+      num_elts = parse_count(argv[i], M);
+    }
+    else if (strcmp(argv[i], "-n") == 0) {
+      i++;
+      if (i == argc)
         usage();
-      num_elts = val * M;
+      num_elts = parse_count(argv[i], 1);
     }
     else if (strcmp(argv[i], "-c") == 0) {
       i++;
@@ -190,6 +263,65 @@ void parse_args(int argc, char * argv[], uint *nelts,
       maxval = val;
       do_counting_sort = true;
     }
+    else if (strcmp(argv[i], "-s") == 0) {
+      i++;
+      if (i == argc)
+        usage();
+      *seg_dist = argv[i];
+    }
+    else if (strcmp(argv[i], "-u") == 0) {
+      *unique = true;
+    }
+    else if (strcmp(argv[i], "-b") == 0) {
+      i++;
+      if (i == argc)
+        usage();
+      *batch_nelts = parse_count(argv[i], 1);
+    }
+    else if (strcmp(argv[i], "-p") == 0) {
+      *pipelined = true;
+    }
+    else if (strcmp(argv[i], "-f") == 0) {
+      *floats = true;
+    }
+    else if (strcmp(argv[i], "-S") == 0) {
+      i++;
+      if (i == argc)
+        usage();
+      *str_data = argv[i];
+    }
+    else if (strcmp(argv[i], "--shm") == 0) {
+      *shm = true;
+    }
+    else if (strcmp(argv[i], "--scaling") == 0) {
+      *scaling = true;
+    }
+    else if (strcmp(argv[i], "-i") == 0) {
+      i++;
+      if (i == argc)
+        usage();
+      *inpath = argv[i];
+    }
+    else if (strcmp(argv[i], "-o") == 0) {
+      i++;
+      if (i == argc)
+        usage();
+      *outpath = argv[i];
+    }
+    else if (strcmp(argv[i], "-a") == 0) {
+      i++;
+      if (i == argc)
+        usage();
+      if (strcmp(argv[i], "compact") == 0)
+        *affinity = SORT_AFFINITY_COMPACT;
+      else if (strcmp(argv[i], "scatter") == 0)
+        *affinity = SORT_AFFINITY_SCATTER;
+      else
+        usage();
+    }
+    else {
+      usage();
+    }
     i++;
   }
 
@@ -210,18 +342,85 @@ int main(int argc, char * argv[])
   long  *data     = NULL;
   long  *origdata = NULL;
   long  *tmpdata  = NULL;
-  long  *cmpdata  = NULL;
-  uint   i;
+  size_t i;
+  uint64_t fingerprint;
   uint   seed;
   sort_t sort_idx;
-  uint   nelts = DEFAULT_NELTS; // == 100 * M
+  size_t nelts = DEFAULT_NELTS; // == 100 * M
 
   // counting sort stuff
   bool   do_counting_sort = false;
   uint   maxval;
 
+  // segmented sort stuff
+  const char *seg_dist = NULL;
+
+  // deduplicating sort stuff
+  bool   do_unique = false;
+
+  // batched insert stuff
+  size_t batch_nelts = 0;
+
+  // pipelined sort stuff
+  bool   do_pipe = false;
+
+  // floating point stuff
+  bool   do_floats = false;
+
+  // string sort stuff
+  const char *str_data = NULL;
+
+  // multi-process sort stuff
+  bool   do_shm = false;
+
+  // thread scaling stuff
+  bool   do_scaling = false;
+  sort_affinity_t affinity = SORT_AFFINITY_NONE;
+
+  // text file stuff
+  const char *inpath = NULL;
+  const char *outpath = NULL;
+
   parse_args(argc, argv, &nelts,
-             &do_counting_sort, &maxval);
+             &do_counting_sort, &maxval, &seg_dist, &do_unique, &batch_nelts,
+             &do_pipe,
+             &do_floats, &str_data,
+             &do_shm, &do_scaling, &affinity, &inpath, &outpath);
+
+  if (inpath != NULL)
+    return text_bench(inpath, outpath);
+  if (outpath != NULL)
+    usage();
+
+  seed = ((uint) time(NULL)) % 16384;
+
+  if (seg_dist != NULL) {
+    printf("main: seed is %u\n", seed);
+    printf("main: sorting %zu elements\n\n", nelts);
+    srandom(seed);
+    return segment_bench(nelts, seg_dist);
+  }
+
+  if (do_pipe) {
+    printf("main: seed is %u\n", seed);
+    printf("main: sorting %zu elements\n\n", nelts);
+    srandom(seed);
+    return pipe_bench(nelts);
+  }
+
+  if (do_floats) {
+    printf("main: seed is %u\n", seed);
+    printf("main: sorting %zu elements\n\n", nelts);
+    srandom(seed);
+    return float_bench(nelts);
+  }
+
+  if (str_data != NULL) {
+    printf("main: seed is %u\n", seed);
+    printf("main: sorting %zu strings\n\n", nelts);
+    srandom(seed);
+    return string_bench(nelts, str_data);
+  }
 
   // allocate memory
   data = (long *) calloc(nelts, sizeof(long));
@@ -242,16 +441,9 @@ int main(int argc, char * argv[])
     return -1;
   }
 
-  cmpdata = (long *) calloc(nelts, sizeof(long));
-  if (cmpdata == NULL) {
-    printf("error: cannot allocate memory for cmpdata\n");
-    return -1;
-  }
-
   // populate data
-  seed = ((uint) time(NULL)) % 16384;
   printf("main: seed is %u\n", seed);
-  printf("main: sorting %d elements\n\n", nelts);
+  printf("main: sorting %zu elements\n\n", nelts);
 
   srandom(seed);
 
@@ -266,6 +458,21 @@ int main(int argc, char * argv[])
       origdata[i] = random();
   }
 
+  if (do_unique)
+    return unique_bench(origdata, nelts);
+  if (batch_nelts > 0)
+    return incremental_bench(origdata, nelts, batch_nelts);
+
+  if (do_shm)
+    return shm_bench(origdata, nelts);
+
+  if (do_scaling)
+    return scaling_bench(origdata, nelts, affinity);
+
+  // every method has to turn origdata into a sorted permutation of it,
+  // which check_sort_perm() verifies against this
+  fingerprint = sort_fingerprint(origdata, nelts);
+
   // sort using different sorting methods
   for (sort_idx = SORT_MIN; sort_idx <= SORT_MAX; sort_idx++)
   {
@@ -279,16 +486,8 @@ int main(int argc, char * argv[])
     if (sort(data, tmpdata, nelts, sort_idx, maxval) == false)
       continue;
 
-    // now compare the sort with the previous sort method
-    if (sort_idx == SORT_MIN) {
-      memcpy(cmpdata, data, nelts * sizeof(long));
-    }
-    else {
-      if (!check_sort_cmp(cmpdata, data, nelts)) {
-        printf("\n**** sorted data is different than previous sort!\n");
-      }
-    }
-
+    if (!check_sort_perm(data, nelts, fingerprint))
+      printf("\n**** sort method produced the wrong result!\n\n");
   }
 
   // free calloc'd memory (even though the process is about to terminate ...)
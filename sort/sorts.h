@@ -10,37 +10,197 @@
 #define SORTS_H
 
 #include <stdbool.h>
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+// base case algorithms for quicksort_opt (QSORT_BASE_CASE)
+typedef enum {
+  SORT_BASE_INSERTION     = 0, // insertion_sort
+  SORT_BASE_INSERTION_OPT = 1  // insertion_sort_opt
+} sort_base_case_t;
+
+// machine-specific thresholds, generated by "make autotune" and
+// compiled in with "make TUNED=1"
+#ifdef SORTS_TUNED
+#include "sorts_tuned.h"
+#endif
+
+#ifndef TUNED_MIN_MERGE_SORT_NELTS
+#define TUNED_MIN_MERGE_SORT_NELTS   32
+#endif
+#ifndef TUNED_MIN_QUICKSORT_NELTS
+#define TUNED_MIN_QUICKSORT_NELTS    32
+#endif
+#ifndef TUNED_QSORT_THREAD_THRESHOLD
+#define TUNED_QSORT_THREAD_THRESHOLD 65536
+#endif
+#ifndef TUNED_QSORT_DEPTH_FACTOR
+#define TUNED_QSORT_DEPTH_FACTOR     2
+#endif
+#ifndef TUNED_QSORT_BASE_CASE
+#define TUNED_QSORT_BASE_CASE        SORT_BASE_INSERTION
+#endif
+
+#ifdef SORT_AUTOTUNE
+
+// the autotuner builds the library with the thresholds as variables so
+// it can sweep them without recompiling
+typedef struct {
+  size_t min_merge_sort_nelts;
+  size_t min_quicksort_nelts;
+  size_t qsort_thread_threshold;
+  size_t qsort_depth_factor;
+  size_t qsort_base_case;        // a sort_base_case_t, swept like the rest
+} sort_tunables_t;
+
+extern sort_tunables_t sort_tunables;
+
+#define MIN_MERGE_SORT_NELTS   (sort_tunables.min_merge_sort_nelts)
+#define MIN_QUICKSORT_NELTS    (sort_tunables.min_quicksort_nelts)
+#define QSORT_THREAD_THRESHOLD (sort_tunables.qsort_thread_threshold)
+#define QSORT_DEPTH_FACTOR     (sort_tunables.qsort_depth_factor)
+#define QSORT_BASE_CASE        ((sort_base_case_t) sort_tunables.qsort_base_case)
+
+#else
+
+enum {
+  MIN_MERGE_SORT_NELTS   = TUNED_MIN_MERGE_SORT_NELTS,
+  MIN_QUICKSORT_NELTS    = TUNED_MIN_QUICKSORT_NELTS,
+  QSORT_THREAD_THRESHOLD = TUNED_QSORT_THREAD_THRESHOLD,
+  // quicksort_opt falls back to heapsort below this many times
+  // log2(nelts) levels of recursion
+  QSORT_DEPTH_FACTOR     = TUNED_QSORT_DEPTH_FACTOR
+};
+
+#define QSORT_BASE_CASE        ((sort_base_case_t) TUNED_QSORT_BASE_CASE)
+
+#endif /* SORT_AUTOTUNE */
 
 enum {
   K                      = 1024,
   M                      = K * K,
   DEFAULT_NELTS          = 100 * M,
   MAX_INSERT_SORT_NELTS  = 256 * K,
-  MIN_MERGE_SORT_NELTS   = 32,
-  MIN_QUICKSORT_NELTS    = 32,
-  QSORT_THREAD_THRESHOLD = 65536,
-  MAX_COUNTINGSORT_VALUE = 100 * M
+  MAX_COUNTINGSORT_VALUE = 100 * M,
+
+  // text input and output: each thread gets at least this much text
+  // or this many elements, and writes through a buffer this big
+  TEXT_CHUNK_MIN_BYTES   = M,
+  TEXT_CHUNK_MIN_NELTS   = 64 * K,
+  TEXT_WRITE_BUF_BYTES   = 4 * M,
+  // "-9223372036854775808\n"
+  TEXT_MAX_NUMBER_BYTES  = 21,
+
+  // radix sort: below RADIX_MIN_NELTS quicksort_opt is faster; each
+  // thread gets at least RADIX_THREAD_NELTS elements
+  RADIX_MIN_NELTS        = 1024,
+  RADIX_THREAD_NELTS     = 256 * K,
+
+  // string sorts: runs this short are insertion sorted; each thread
+  // of string_sort gets at least STRSORT_THREAD_NSTRS strings
+  STRSORT_SMALL_NSTRS    = 32,
+  STRSORT_THREAD_NSTRS   = 64 * K,
+
+  // sorted_insert_batch: batches this big are merged in parallel, each
+  // thread taking at least this many elements of the output
+  SORTED_INSERT_THREAD_NELTS = 256 * K,
+
+  // sorted_lsm_t: level 0 holds up to SORTED_LSM_BASE_NELTS elements,
+  // each level SORTED_LSM_RATIO times as many as the one before
+  SORTED_LSM_BASE_NELTS  = 64 * K,
+  SORTED_LSM_RATIO       = 8,
+  SORTED_LSM_MAX_LEVELS  = 16,
+
+  // verification: each thread checks at least this many elements
+  VERIFY_MIN_NELTS       = 256 * K,
+
+  // pipelined sort: default chunk size, size of the pieces handed to
+  // the consumer, and most sorted runs held at once
+  PIPESORT_CHUNK_NELTS   = M,
+  PIPESORT_OUT_NELTS     = 64 * K,
+  PIPESORT_MAX_RUNS      = 64,
+
+  // multi-process sort: most worker processes, samples each one
+  // contributes to the splitters, and size of each exchange ring
+  SHMSORT_MAX_PROCS      = 64,
+  SHMSORT_SAMPLES        = 256,
+  SHMSORT_RING_NELTS     = 64 * K,
+
+  // segmented sort: segments up to SEGSORT_NETWORK_NELTS long go through
+  // sorting networks, SEGSORT_LANES at a time; threads grab
+  // SEGSORT_CHUNK_NSEGS segments at a time; segments longer than
+  // SEGSORT_MT_NELTS are sorted one by one with all the threads
+  SEGSORT_NETWORK_NELTS   = 16,
+  SEGSORT_MAX_COMPARATORS = 64,
+  SEGSORT_LANES           = 4,
+  SEGSORT_CHUNK_NSEGS     = 256,
+  SEGSORT_MT_NELTS        = M,
+
+  // sort_unique/sort_count: runs this small are sorted and deduplicated
+  // directly; threads are only spawned for runs at least
+  // UNIQUE_THREAD_NELTS long
+  UNIQUE_RUN_NELTS        = 64 * K,
+  UNIQUE_THREAD_NELTS     = 256 * K
 };
 
 typedef unsigned int    uint;
 typedef unsigned short  ushort;
 
+// how sort_set_affinity() places the library's threads on cpus
+typedef enum {
+  SORT_AFFINITY_NONE,     // leave it to the scheduler
+  SORT_AFFINITY_COMPACT,  // fill up cores and packages one at a time
+  SORT_AFFINITY_SCATTER   // spread across packages and cores first
+} sort_affinity_t;
+
+// pipe_sort() callbacks: the producer fills buf with up to max
+// elements, returning 0 at the end of the input; the consumer is
+// handed the sorted output a piece at a time
+typedef size_t (*sort_producer_t)(long *buf, size_t max, long *watermark,
+                                  void *arg);
+typedef void   (*sort_consumer_t)(const long *data, size_t nelts, void *arg);
+
+// per-phase wall times (seconds) of shm_sort(), slowest worker each
+typedef struct {
+  double local_sort;
+  double splitters;
+  double exchange;
+  double merge;
+  double total;
+} shm_sort_times_t;
+
+// a sorted array kept as levels of sorted arrays, level l holding up
+// to SORTED_LSM_BASE_NELTS * SORTED_LSM_RATIO^l elements
+typedef struct {
+  long  *level[SORTED_LSM_MAX_LEVELS];
+  size_t nelts[SORTED_LSM_MAX_LEVELS];
+  size_t nlevels;
+} sorted_lsm_t;
+
 typedef struct {
   long  *data;
-  uint   lo_ix;
-  uint   hi_ix;
+  size_t lo_ix;
+  size_t hi_ix;
   ushort call_depth;
   ushort max_call_depth;
+  bool   three_way;
+  const long *pred;
 } qsort_info_t;
 
 extern
-bool check_sort(long *data, uint len);
+bool check_sort(long *data, size_t len);
+
+extern
+bool check_sort_cmp(long *data1, long *data2, size_t len);
 
 extern
-bool check_sort_cmp(long *data1, long *data2, uint len);
+uint64_t sort_fingerprint(const long *data, size_t len);
 
 extern
-void print_array(long *data, uint len, int badelt);
+bool check_sort_perm(const long *data, size_t len, uint64_t fingerprint);
+
+extern
+void print_array(long *data, size_t len, size_t badelt);
 
 extern
 int compare(const void *left, const void * right);
@@ -49,28 +209,125 @@ extern
 void swap_elem(void *left, void *right);
 
 extern
-void insertion_sort(long *data, uint lo_ix, uint hi_ix);
+void insertion_sort(long *data, size_t lo_ix, size_t hi_ix);
 
 extern
-void insertion_sort_opt(long *data, uint lo_ix, uint hi_ix);
+void insertion_sort_opt(long *data, size_t lo_ix, size_t hi_ix);
 
 extern
-void quicksort(long *data, uint lo_ix, uint hi_ix);
+void quicksort(long *data, size_t lo_ix, size_t hi_ix);
 
 extern
-void quicksort_opt(long *data, uint lo_ix, uint hi_ix,
+void quicksort_opt(long *data, size_t lo_ix, size_t hi_ix,
                    bool multithread);
 
 extern
-void heapsort(long *data, uint lo_ix, uint hi_ix);
+void quicksort_3way(long *data, size_t lo_ix, size_t hi_ix,
+                    bool multithread);
+
+extern
+void heapsort(long *data, size_t lo_ix, size_t hi_ix);
+
+extern
+void merge_sort(long *data, size_t lo_ix, size_t hi_ix);
+
+extern
+void merge_sort_opt(long *data, long *tmpdata, size_t lo_ix, size_t hi_ix);
+
+extern
+void segmented_sort(long *data, const size_t *offsets, size_t nsegs,
+                    bool multithread);
+
+extern
+size_t sort_unique(long *data, size_t nelts, bool multithread,
+                   size_t *traffic);
+
+extern
+size_t sort_count(long *data, size_t *counts, size_t nelts,
+                  bool multithread, size_t *traffic);
+
+extern
+size_t pipe_sort(sort_producer_t produce, void *parg, sort_consumer_t consume,
+                 void *carg, size_t chunk_nelts, bool multithread);
+
+extern
+bool shm_sort(long *data, size_t nelts, size_t nprocs,
+              shm_sort_times_t *times);
+
+extern
+long *text_read_longs(const char *path, size_t *nelts, bool multithread);
+
+extern
+bool text_write_longs(const char *path, const long *data, size_t nelts,
+                      bool multithread, size_t *nbytes);
+
+extern
+void radix_sort(long *data, long *tmpdata, size_t nelts, bool multithread);
+
+extern
+void sort_doubles(double *data, size_t nelts, bool multithread);
+
+extern
+void sort_floats(float *data, size_t nelts, bool multithread);
+
+extern
+void string_sort_mkqs(const char **strs, size_t nstrs);
+
+extern
+void string_sort_radix(const char **strs, size_t nstrs);
+
+extern
+void string_sort(const char **strs, size_t nstrs, bool multithread);
+
+extern
+void sorted_insert_batch(long *base, size_t n, long *batch, size_t m,
+                         bool multithread);
+
+extern
+sorted_lsm_t *sorted_lsm_create(void);
+
+extern
+void sorted_lsm_free(sorted_lsm_t *lsm);
+
+extern
+void sorted_lsm_insert(sorted_lsm_t *lsm, long *batch, size_t m,
+                       bool multithread);
+
+extern
+size_t sorted_lsm_count(const sorted_lsm_t *lsm, long lo, long hi);
+
+extern
+bool sorted_lsm_contains(const sorted_lsm_t *lsm, long val);
+
+extern
+const long *sorted_lsm_compact(sorted_lsm_t *lsm, size_t *nelts,
+                               bool multithread);
+
+extern
+void counting_sort(long *data, size_t lo_ix, size_t hi_ix, uint maxval);
+
+extern
+void sort_set_threads(size_t nthreads);
+
+extern
+size_t sort_get_threads(void);
+
+extern
+ushort sort_spawn_depth(void);
+
+extern
+void sort_set_affinity(sort_affinity_t affinity);
+
+extern
+void sort_threads_reset(void);
 
 extern
-void merge_sort(long *data, uint lo_ix, uint hi_ix);
+double sort_threads_cpu_time(void);
 
 extern
-void merge_sort_opt(long *data, long *tmpdata, uint lo_ix, uint hi_ix);
+void sort_thread_start(void);
 
 extern
-void counting_sort(long *data, uint lo_ix, uint hi_ix, uint maxval);
+void sort_thread_end(void);
 
 #endif /* SORTS_H */
@@ -0,0 +1,111 @@
+//
+// sortstats.c
+//
+// hot-path instrumentation counters for the sort kernels
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <string.h> /* memset */
+#include <pthread.h>
+#include "sortstats.h"
+
+#ifdef SORT_INSTRUMENT
+
+__thread sort_stats_t sort_thread_stats;
+
+// totals of the threads that have exited
+static sort_stats_t    sort_stats_total;
+static pthread_mutex_t sort_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// count a partition into lsize and rsize elements
+void
+sort_stats_imbalance(size_t lsize, size_t rsize)
+{
+  size_t smaller = (lsize < rsize) ? lsize : rsize;
+  size_t bucket;
+
+  if (lsize + rsize == 0)
+    return;
+
+  bucket = (2 * smaller * SORT_STATS_IMBALANCE_BUCKETS) / (lsize + rsize);
+  if (bucket >= SORT_STATS_IMBALANCE_BUCKETS)
+    bucket = SORT_STATS_IMBALANCE_BUCKETS - 1;
+
+  sort_thread_stats.partitions++;
+  sort_thread_stats.imbalance[bucket]++;
+}
+
+// fold this thread's counters into the totals and clear them
+void
+sort_stats_flush(void)
+{
+  sort_stats_t *t = &sort_thread_stats;
+  size_t b;
+
+  pthread_mutex_lock(&sort_stats_lock);
+
+  sort_stats_total.compares += t->compares;
+  sort_stats_total.swaps += t->swaps;
+  sort_stats_total.partitions += t->partitions;
+  for (b = 0; b < SORT_STATS_IMBALANCE_BUCKETS; b++)
+    sort_stats_total.imbalance[b] += t->imbalance[b];
+  sort_stats_total.insertion_sorts += t->insertion_sorts;
+  sort_stats_total.heapsort_fallbacks += t->heapsort_fallbacks;
+  sort_stats_total.thread_spawns += t->thread_spawns;
+  if (t->max_call_depth > sort_stats_total.max_call_depth)
+    sort_stats_total.max_call_depth = t->max_call_depth;
+  sort_stats_total.bytes_moved += t->bytes_moved;
+
+  pthread_mutex_unlock(&sort_stats_lock);
+
+  memset(t, 0, sizeof(*t));
+}
+
+void
+sort_stats_reset(void)
+{
+  pthread_mutex_lock(&sort_stats_lock);
+  memset(&sort_stats_total, 0, sizeof(sort_stats_total));
+  pthread_mutex_unlock(&sort_stats_lock);
+
+  memset(&sort_thread_stats, 0, sizeof(sort_thread_stats));
+}
+
+void
+sort_stats_print(void)
+{
+  sort_stats_t *s = &sort_stats_total;
+  size_t b;
+
+  sort_stats_flush();
+
+  printf("stats: compares %zu, swaps %zu, bytes moved %zu\n",
+         s->compares, s->swaps, s->bytes_moved);
+  printf("stats: partitions %zu, max depth %zu, insertion sorts %zu, "
+         "heapsort fallbacks %zu, threads spawned %zu\n",
+         s->partitions, s->max_call_depth, s->insertion_sorts,
+         s->heapsort_fallbacks, s->thread_spawns);
+
+  if (s->partitions > 0) {
+    printf("stats: partition balance (lopsided .. even):");
+    for (b = 0; b < SORT_STATS_IMBALANCE_BUCKETS; b++)
+      printf(" %zu", s->imbalance[b]);
+    printf("\n");
+  }
+}
+
+#else
+
+void
+sort_stats_reset(void)
+{
+}
+
+void
+sort_stats_print(void)
+{
+}
+
+#endif /* SORT_INSTRUMENT */
@@ -0,0 +1,76 @@
+//
+// sortstats.h
+//
+// hot-path instrumentation counters for the sort kernels
+//
+// the counters only exist when the library is built with
+// -DSORT_INSTRUMENT (make sorts-instrumented); otherwise every
+// SORT_STAT_* macro expands to nothing
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef SORTSTATS_H
+#define SORTSTATS_H
+
+#include <stddef.h> /* size_t */
+
+enum {
+  // partition imbalance histogram: bucket b counts partitions whose
+  // smaller side holds [b, b + 1) / SORT_STATS_IMBALANCE_BUCKETS of
+  // half the elements, i.e. bucket 0 is the most lopsided
+  SORT_STATS_IMBALANCE_BUCKETS = 10
+};
+
+typedef struct {
+  size_t compares;
+  size_t swaps;
+  size_t partitions;
+  size_t imbalance[SORT_STATS_IMBALANCE_BUCKETS];
+  size_t insertion_sorts;     // insertion sort base cases
+  size_t heapsort_fallbacks;
+  size_t thread_spawns;
+  size_t max_call_depth;
+  size_t bytes_moved;         // merge copies, memmoves, element shifts
+} sort_stats_t;
+
+#ifdef SORT_INSTRUMENT
+
+// each thread counts into its own copy, and folds it into the global
+// totals with SORT_STAT_FLUSH() just before it exits
+extern __thread sort_stats_t sort_thread_stats;
+
+extern
+void sort_stats_imbalance(size_t lsize, size_t rsize);
+
+extern
+void sort_stats_flush(void);
+
+#define SORT_STAT_ADD(field, n)  (sort_thread_stats.field += (n))
+#define SORT_STAT_MAX(field, v)                                       \
+  do {                                                                \
+    if ((size_t) (v) > sort_thread_stats.field)                       \
+      sort_thread_stats.field = (v);                                  \
+  } while (0)
+#define SORT_STAT_IMBALANCE(lsize, rsize) sort_stats_imbalance(lsize, rsize)
+#define SORT_STAT_FLUSH()        sort_stats_flush()
+
+#else
+
+#define SORT_STAT_ADD(field, n)            ((void) 0)
+#define SORT_STAT_MAX(field, v)            ((void) 0)
+#define SORT_STAT_IMBALANCE(lsize, rsize)  ((void) 0)
+#define SORT_STAT_FLUSH()                  ((void) 0)
+
+#endif /* SORT_INSTRUMENT */
+
+// clear the counters (of all threads that have exited, and this one)
+extern
+void sort_stats_reset(void);
+
+// print the counters accumulated since the last sort_stats_reset();
+// prints nothing unless built with SORT_INSTRUMENT
+extern
+void sort_stats_print(void);
+
+#endif /* SORTSTATS_H */
@@ -0,0 +1,277 @@
+//
+// sortthreads.c
+//
+// thread count, cpu placement and cpu time accounting for the threads
+// the sort library spawns
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#define _GNU_SOURCE /* sched_setaffinity, CPU_* */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h> /* USHRT_MAX */
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "sorts.h"
+#include "sortstats.h"
+
+// per-cpu topology, used to order the cpus for pinning
+typedef struct {
+  int cpu;
+  int package;
+  int core;
+  int core_rank;  // rank of core within its package
+  int smt_rank;   // rank of cpu among the hyperthreads of its core
+} cpu_topo_t;
+
+static size_t          sort_nthreads_setting = 0;
+static sort_affinity_t sort_affinity = SORT_AFFINITY_NONE;
+
+// cpus in the order threads get pinned to them
+static int            *sort_cpu_order = NULL;
+static size_t          sort_ncpus = 0;
+
+// state of the current run, see sort_threads_reset()
+static size_t          sort_thread_ordinal = 0;
+static double          sort_thread_cpu_total = 0.0;
+static pthread_mutex_t sort_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread struct timespec sort_thread_cpu_start;
+
+// the thread's affinity from before sort_thread_start() pinned it, put
+// back by sort_thread_end() (which matters for the calling thread)
+static __thread cpu_set_t sort_thread_saved_mask;
+static __thread bool      sort_thread_pinned = false;
+
+// read one integer from a sysfs topology file, -1 if it isn't there
+static int
+read_topology(int cpu, const char *what)
+{
+  char  path[128];
+  FILE *f;
+  int   val = -1;
+
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, what);
+  f = fopen(path, "r");
+  if (f == NULL)
+    return -1;
+  if (fscanf(f, "%d", &val) != 1)
+    val = -1;
+  fclose(f);
+
+  return val;
+}
+
+static int
+compare_compact(const void *left, const void *right)
+{
+  const cpu_topo_t *l = left, *r = right;
+
+  if (l->package != r->package)
+    return (l->package < r->package) ? -1 : 1;
+  if (l->core_rank != r->core_rank)
+    return (l->core_rank < r->core_rank) ? -1 : 1;
+  return (l->smt_rank > r->smt_rank) - (l->smt_rank < r->smt_rank);
+}
+
+static int
+compare_scatter(const void *left, const void *right)
+{
+  const cpu_topo_t *l = left, *r = right;
+
+  if (l->smt_rank != r->smt_rank)
+    return (l->smt_rank < r->smt_rank) ? -1 : 1;
+  if (l->core_rank != r->core_rank)
+    return (l->core_rank < r->core_rank) ? -1 : 1;
+  return (l->package > r->package) - (l->package < r->package);
+}
+
+// order the cpus we may run on: compact fills one core, then one
+// package, before moving on; scatter spreads over packages first, then
+// cores, and only then uses the hyperthreads
+static void
+build_cpu_order(sort_affinity_t affinity)
+{
+  cpu_set_t   mask;
+  cpu_topo_t *topo;
+  size_t      n = 0, i, k;
+  int         cpu;
+
+  if (sched_getaffinity(0, sizeof(mask), &mask) != 0)
+    return;
+
+  topo = calloc(CPU_COUNT(&mask), sizeof(cpu_topo_t));
+  if (topo == NULL)
+    return;
+
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &mask))
+      continue;
+    topo[n].cpu = cpu;
+    topo[n].package = read_topology(cpu, "physical_package_id");
+    topo[n].core = read_topology(cpu, "core_id");
+    n++;
+  }
+
+  // ranks: count the lower-numbered cpus on the same core, then the
+  // lower-numbered cores in the same package (via their first cpu)
+  for (i = 0; i < n; i++) {
+    topo[i].smt_rank = 0;
+    for (k = 0; k < n; k++) {
+      if (topo[k].package == topo[i].package &&
+          topo[k].core == topo[i].core && topo[k].cpu < topo[i].cpu)
+        topo[i].smt_rank++;
+    }
+  }
+  for (i = 0; i < n; i++) {
+    topo[i].core_rank = 0;
+    for (k = 0; k < n; k++) {
+      if (topo[k].package == topo[i].package && topo[k].smt_rank == 0 &&
+          topo[k].core < topo[i].core)
+        topo[i].core_rank++;
+    }
+  }
+
+  qsort(topo, n, sizeof(cpu_topo_t),
+        (affinity == SORT_AFFINITY_SCATTER) ? &compare_scatter : &compare_compact);
+
+  free(sort_cpu_order);
+  sort_cpu_order = malloc(n * sizeof(int));
+  if (sort_cpu_order != NULL) {
+    for (i = 0; i < n; i++)
+      sort_cpu_order[i] = topo[i].cpu;
+    sort_ncpus = n;
+  }
+
+  free(topo);
+}
+
+// limit the parallel sorts to nthreads threads (0: no limit, i.e.
+// quicksort_opt spawns as many as its thresholds allow and the other
+// parallel sorts use one thread per cpu)
+void
+sort_set_threads(size_t nthreads)
+{
+  sort_nthreads_setting = nthreads;
+}
+
+// number of threads the parallel sorts should use
+size_t
+sort_get_threads(void)
+{
+  long ncpus;
+
+  if (sort_nthreads_setting > 0)
+    return sort_nthreads_setting;
+
+  ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return (ncpus > 0) ? (size_t) ncpus : 1;
+}
+
+// how deep in its recursion quicksort_opt may still spawn threads:
+// with spawning at every level above it there are at most 2^depth
+ushort
+sort_spawn_depth(void)
+{
+  ushort depth = 0;
+
+  if (sort_nthreads_setting == 0)
+    return USHRT_MAX;
+
+  while (((size_t) 2 << depth) <= sort_nthreads_setting)
+    depth++;
+
+  return depth;
+}
+
+// pin the library's threads to cpus (in the order of their creation)
+void
+sort_set_affinity(sort_affinity_t affinity)
+{
+  sort_affinity = affinity;
+  if (affinity != SORT_AFFINITY_NONE)
+    build_cpu_order(affinity);
+}
+
+// start a new run: thread numbering for pinning starts over (the
+// calling thread is number 0), and the summed cpu time is cleared
+void
+sort_threads_reset(void)
+{
+  pthread_mutex_lock(&sort_threads_lock);
+  sort_thread_ordinal = 0;
+  sort_thread_cpu_total = 0.0;
+  pthread_mutex_unlock(&sort_threads_lock);
+
+  sort_thread_start();
+}
+
+// summed cpu time (seconds) of the threads that called
+// sort_thread_end() since the last sort_threads_reset()
+double
+sort_threads_cpu_time(void)
+{
+  double total;
+
+  pthread_mutex_lock(&sort_threads_lock);
+  total = sort_thread_cpu_total;
+  pthread_mutex_unlock(&sort_threads_lock);
+
+  return total;
+}
+
+// called first thing by every thread the library creates
+void
+sort_thread_start(void)
+{
+  cpu_set_t mask;
+  size_t    ordinal;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &sort_thread_cpu_start);
+
+  if (sort_affinity == SORT_AFFINITY_NONE || sort_ncpus == 0)
+    return;
+
+  ordinal = __atomic_fetch_add(&sort_thread_ordinal, 1, __ATOMIC_RELAXED);
+
+  // pinned already (the calling thread, reset again): keep the mask
+  // saved the first time
+  if (!sort_thread_pinned &&
+      sched_getaffinity(0, sizeof(sort_thread_saved_mask),
+                        &sort_thread_saved_mask) == 0)
+    sort_thread_pinned = true;
+
+  CPU_ZERO(&mask);
+  CPU_SET(sort_cpu_order[ordinal % sort_ncpus], &mask);
+  sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+// called last thing by every thread the library creates
+void
+sort_thread_end(void)
+{
+  struct timespec now;
+  double cpu;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  cpu =
+    (double)  (now.tv_sec - sort_thread_cpu_start.tv_sec) +
+    ((double) (now.tv_nsec - sort_thread_cpu_start.tv_nsec)) / 1E9;
+
+  pthread_mutex_lock(&sort_threads_lock);
+  sort_thread_cpu_total += cpu;
+  pthread_mutex_unlock(&sort_threads_lock);
+
+  if (sort_thread_pinned) {
+    sched_setaffinity(0, sizeof(sort_thread_saved_mask),
+                      &sort_thread_saved_mask);
+    sort_thread_pinned = false;
+  }
+
+  SORT_STAT_FLUSH();
+}
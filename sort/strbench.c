@@ -0,0 +1,169 @@
+//
+// strbench.c
+//
+// benchmarking the string sorts against libc qsort with strcmp on
+// random strings, strings with long shared prefixes and url-like
+// strings
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+#include "sortstats.h"
+
+enum {
+  STR_MAX_LEN = 128
+};
+
+static const char alnum[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+static const char *url_hosts[] = {
+  "www.example.com", "www.example.org", "news.example.com",
+  "shop.example.com", "api.example.net", "static.example.com",
+  "blog.example.org", "mail.example.net"
+};
+
+static const char *url_dirs[] = {
+  "", "/index", "/products", "/products/item", "/user/profile",
+  "/search", "/articles/2020", "/static/img"
+};
+
+static int
+compare_str(const void *left, const void *right)
+{
+  return strcmp(*(const char * const *) left, *(const char * const *) right);
+}
+
+static size_t
+random_alnum(char *buf, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    buf[i] = alnum[random() % (sizeof(alnum) - 1)];
+
+  return len;
+}
+
+// write one string of the dataset into buf (STR_MAX_LEN bytes),
+// returning its length, or 0 for an unknown dataset
+static size_t
+generate_string(char *buf, const char *dataset)
+{
+  size_t len;
+
+  if (strcmp(dataset, "random") == 0)
+    return random_alnum(buf, 4 + random() % 28);
+
+  // one of 4 prefixes 64 characters long, so most of the work is
+  // getting past them
+  if (strcmp(dataset, "prefix") == 0) {
+    len = (size_t) sprintf(buf, "%c", 'a' + (int) (random() % 4));
+    memset(&buf[len], '-', 63);
+    len += 63;
+    return len + random_alnum(&buf[len], 1 + random() % 12);
+  }
+
+  if (strcmp(dataset, "url") == 0) {
+    len = (size_t) sprintf(buf, "https://%s%s/",
+                           url_hosts[random() % 8], url_dirs[random() % 8]);
+    len += random_alnum(&buf[len], 4 + random() % 12);
+    if (random() % 4 == 0)
+      len += (size_t) sprintf(&buf[len], "?id=%ld", random() % 100000);
+    return len;
+  }
+
+  return 0;
+}
+
+int
+string_bench(size_t nstrs, const char *dataset)
+{
+  struct timeval tv_start, tv_end;
+  const char **strs, **origstrs, **cmpstrs;
+  char   *pool;
+  size_t  i, len, off;
+  int     method;
+  bool    same;
+
+  strs = malloc(nstrs * sizeof(const char *));
+  origstrs = malloc(nstrs * sizeof(const char *));
+  cmpstrs = malloc(nstrs * sizeof(const char *));
+  pool = malloc(nstrs * STR_MAX_LEN);
+  if (strs == NULL || origstrs == NULL || cmpstrs == NULL || pool == NULL) {
+    printf("error: cannot allocate memory for strings\n");
+    return -1;
+  }
+
+  // the strings are packed one after the other, as they would be if
+  // they'd been read from a file
+  off = 0;
+  for (i = 0; i < nstrs; i++) {
+    len = generate_string(&pool[off], dataset);
+    if (len == 0) {
+      printf("error: unknown string dataset %s\n", dataset);
+      return -1;
+    }
+    pool[off + len] = '\0';
+    origstrs[i] = &pool[off];
+    off += len + 1;
+  }
+  printf("strings: %s, %.1f bytes each on average\n\n", dataset,
+         (double) off / (double) nstrs);
+
+  for (method = 0; method < 4; method++) {
+    memcpy(strs, origstrs, nstrs * sizeof(const char *));
+
+    sort_stats_reset();
+    gettimeofday(&tv_start, NULL);
+    switch (method) {
+      case 0:
+      printf("sorting: sort method is libc qsort() with strcmp\n");
+      qsort(strs, nstrs, sizeof(const char *), &compare_str);
+      break;
+
+      case 1:
+      printf("sorting: sort method is multikey quicksort\n");
+      string_sort_mkqs(strs, nstrs);
+      break;
+
+      case 2:
+      printf("sorting: sort method is msd radix sort\n");
+      string_sort_radix(strs, nstrs);
+      break;
+
+      case 3:
+      printf("sorting: sort method is string_sort mt\n");
+      string_sort(strs, nstrs, true);
+      break;
+    }
+    gettimeofday(&tv_end, NULL);
+
+    // equal strings may come out in any order, so compare the strings
+    // and not the pointers
+    if (method == 0)
+      memcpy(cmpstrs, strs, nstrs * sizeof(const char *));
+    same = true;
+    for (i = 0; i < nstrs && same; i++)
+      same = (strcmp(cmpstrs[i], strs[i]) == 0);
+    if (!same)
+      printf("\n**** sorted strings are different than qsort's at %zu!\n",
+             i - 1);
+
+    printf("finished: sorted %zu strings in %.2f seconds\n", nstrs,
+           elapsed(&tv_start, &tv_end));
+    sort_stats_print();
+    printf("\n");
+  }
+
+  free(strs);
+  free(origstrs);
+  free(cmpstrs);
+  free(pool);
+  return 0;
+}
@@ -0,0 +1,506 @@
+//
+// strsort.c
+//
+// string sorting: multikey quicksort, msd radix sort over a cached
+// 8-byte prefix of every string, and a parallel sort that radix sorts
+// a run per thread and combines the runs with lcp-aware merges
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "sorts.h"
+#include "sortstats.h"
+
+enum {
+  STR_BUCKETS = 256,
+  STR_KEY_BYTES = 8
+};
+
+// a string and the next 8 bytes of it (from the current depth) packed
+// big-endian, so comparing keys compares those bytes
+typedef struct {
+  uint64_t    key;
+  const char *str;
+} str_item_t;
+
+// a bucket still to be sorted by msd_items: n items from items[off]
+// on, agreeing on their first depth bytes and the first b bytes of
+// their keys (which hold the 8 bytes from depth on)
+typedef struct {
+  size_t   off;
+  size_t   n;
+  size_t   depth;
+  unsigned b;
+} str_bucket_t;
+
+// one thread's run for string_sort
+typedef struct {
+  const char **strs;
+  size_t      *lcp;
+  size_t       nstrs;
+} str_run_t;
+
+// one merge of two adjacent runs for string_sort
+typedef struct {
+  str_run_t    a;
+  str_run_t    b;
+  const char **out;
+  size_t      *out_lcp;
+} str_merge_t;
+
+static inline unsigned char
+char_at(const char *s, size_t depth)
+{
+  return (unsigned char) s[depth];
+}
+
+// the 8 bytes of s from depth on, zero-padded past its end
+static inline uint64_t
+load_key(const char *s, size_t depth)
+{
+  uint64_t key = 0;
+  size_t   i;
+
+  s += depth;
+  for (i = 0; i < STR_KEY_BYTES && s[i] != '\0'; i++)
+    key |= (uint64_t) (unsigned char) s[i] << (8 * (STR_KEY_BYTES - 1 - i));
+
+  return key;
+}
+
+// length of the common prefix of a and b from depth on, plus depth
+static inline size_t
+lcp_from(const char *a, const char *b, size_t depth)
+{
+  while (a[depth] != '\0' && a[depth] == b[depth])
+    depth++;
+
+  return depth;
+}
+
+static inline void
+swap_strs(const char **strs, size_t i, size_t j)
+{
+  const char *t = strs[i];
+
+  strs[i] = strs[j];
+  strs[j] = t;
+}
+
+// insertion sort of strings that agree on their first depth bytes
+static void
+insertion_sort_strs(const char **strs, size_t nstrs, size_t depth)
+{
+  const char *s;
+  size_t      i, j;
+
+  for (i = 1; i < nstrs; i++) {
+    s = strs[i];
+    for (j = i; j > 0 && strcmp(strs[j - 1] + depth, s + depth) > 0; j--)
+      strs[j] = strs[j - 1];
+    strs[j] = s;
+  }
+}
+
+// multikey quicksort (bentley & sedgewick): three-way partition on the
+// character at depth, then recurse on the three parts, the middle one
+// at depth + 1
+static void
+mkqs(const char **strs, size_t nstrs, size_t depth)
+{
+  size_t lt, gt, i;
+  int    pivot, c;
+
+  while (nstrs > 1) {
+    if (nstrs < STRSORT_SMALL_NSTRS) {
+      insertion_sort_strs(strs, nstrs, depth);
+      return;
+    }
+
+    SORT_STAT_ADD(partitions, 1);
+
+    // the middle string's character is the pivot
+    swap_strs(strs, 0, nstrs / 2);
+    pivot = char_at(strs[0], depth);
+
+    lt = 0;
+    gt = nstrs;
+    i = 1;
+    while (i < gt) {
+      c = char_at(strs[i], depth);
+      if (c < pivot)
+        swap_strs(strs, lt++, i++);
+      else if (c > pivot)
+        swap_strs(strs, i, --gt);
+      else
+        i++;
+    }
+
+    mkqs(strs, lt, depth);
+    mkqs(&strs[gt], nstrs - gt, depth);
+
+    // the middle part all has the pivot character; if that's the end
+    // of the strings they're all equal
+    if (pivot == '\0')
+      return;
+    strs = &strs[lt];
+    nstrs = gt - lt;
+    depth++;
+  }
+}
+
+// sort strs[0 .. nstrs - 1] (as strcmp orders them) with multikey
+// quicksort
+void
+string_sort_mkqs(const char **strs, size_t nstrs)
+{
+  mkqs(strs, nstrs, 0);
+}
+
+// items are ordered by key, and then (when the key doesn't end the
+// string) by the rest of the string
+static inline bool
+item_less(const str_item_t *a, const str_item_t *b, size_t depth)
+{
+  if (a->key != b->key)
+    return a->key < b->key;
+  if ((a->key & 0xFF) == 0)
+    return false;
+
+  return strcmp(a->str + depth + STR_KEY_BYTES, b->str + depth + STR_KEY_BYTES) < 0;
+}
+
+static void
+insertion_sort_items(str_item_t *items, size_t n, size_t depth)
+{
+  str_item_t t;
+  size_t     i, j;
+
+  for (i = 1; i < n; i++) {
+    t = items[i];
+    for (j = i; j > 0 && item_less(&t, &items[j - 1], depth); j--)
+      items[j] = items[j - 1];
+    items[j] = t;
+  }
+}
+
+// load the 8 bytes of every item's string from depth on into its key
+static void
+load_keys(str_item_t *items, size_t n, size_t depth)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    items[i].key = load_key(items[i].str, depth);
+}
+
+// count items by byte b of their keys; returns the bucket if they're
+// all in one, or STR_BUCKETS if they're not
+static size_t
+count_key_byte(const str_item_t *items, size_t n, unsigned b, size_t *count)
+{
+  unsigned shift = 8 * (STR_KEY_BYTES - 1 - b);
+  size_t   i, c;
+
+  memset(count, 0, STR_BUCKETS * sizeof(size_t));
+  for (i = 0; i < n; i++)
+    count[(items[i].key >> shift) & 0xFF]++;
+
+  c = (items[0].key >> shift) & 0xFF;
+  return (count[c] == n) ? c : STR_BUCKETS;
+}
+
+// sort the items by radix sorting on the bytes of their keys, one at a
+// time, reloading the keys with the next 8 bytes of the strings after
+// the last. the buckets still to be sorted go on an explicit stack, as
+// strings can share prefixes of any length; every bucket on it has at
+// least STRSORT_SMALL_NSTRS items (smaller ones are insertion sorted
+// straight away), so it never holds more than n / STRSORT_SMALL_NSTRS
+static void
+msd_items(str_item_t *items, str_item_t *tmp, size_t n)
+{
+  size_t        count[STR_BUCKETS], start[STR_BUCKETS];
+  str_bucket_t *stack, bkt;
+  str_item_t   *its;
+  size_t        nstack = 0, i, c, sum;
+  unsigned      shift;
+
+  stack = malloc((n / STRSORT_SMALL_NSTRS + 1) * sizeof(str_bucket_t));
+  assert(stack != NULL);
+
+  stack[nstack].off = 0;
+  stack[nstack].n = n;
+  stack[nstack].depth = 0;
+  stack[nstack++].b = 0;
+
+  while (nstack > 0) {
+    bkt = stack[--nstack];
+    its = &items[bkt.off];
+    if (bkt.b == 0)
+      load_keys(its, bkt.n, bkt.depth);
+
+    if (bkt.n < STRSORT_SMALL_NSTRS) {
+      insertion_sort_items(its, bkt.n, bkt.depth);
+      continue;
+    }
+
+    // everything in one bucket: nothing to move, go straight on to the
+    // next byte, until the strings differ or they've all ended (in
+    // bucket 0, when they're all equal)
+    while ((c = count_key_byte(its, bkt.n, bkt.b, count)) != STR_BUCKETS &&
+           c != 0) {
+      if (++bkt.b == STR_KEY_BYTES) {
+        bkt.b = 0;
+        bkt.depth += STR_KEY_BYTES;
+        load_keys(its, bkt.n, bkt.depth);
+      }
+    }
+    if (c == 0)
+      continue;
+
+    shift = 8 * (STR_KEY_BYTES - 1 - bkt.b);
+    for (c = 0, sum = 0; c < STR_BUCKETS; c++) {
+      start[c] = sum;
+      sum += count[c];
+    }
+    for (i = 0; i < bkt.n; i++)
+      tmp[start[(its[i].key >> shift) & 0xFF]++] = its[i];
+    memcpy(its, tmp, bkt.n * sizeof(str_item_t));
+    SORT_STAT_ADD(bytes_moved, 2 * bkt.n * sizeof(str_item_t));
+
+    // then each bucket by the following byte, or, past the key's last
+    // byte, by the next 8 bytes of the strings; bucket 0 holds the
+    // strings that ended: they're all equal
+    for (c = 1, sum = count[0]; c < STR_BUCKETS; sum += count[c], c++) {
+      if (count[c] < 2)
+        continue;
+      if (count[c] < STRSORT_SMALL_NSTRS) {
+        insertion_sort_items(&its[sum], count[c], bkt.depth);
+        continue;
+      }
+      stack[nstack].off = bkt.off + sum;
+      stack[nstack].n = count[c];
+      stack[nstack].depth = bkt.depth;
+      stack[nstack].b = bkt.b + 1;
+      if (stack[nstack].b == STR_KEY_BYTES) {
+        stack[nstack].depth += STR_KEY_BYTES;
+        stack[nstack].b = 0;
+      }
+      nstack++;
+    }
+  }
+
+  free(stack);
+}
+
+// sort strs[0 .. nstrs - 1] with msd radix sort; every string's next 8
+// bytes are cached in a key array, so most of the passes don't touch
+// the strings themselves
+void
+string_sort_radix(const char **strs, size_t nstrs)
+{
+  str_item_t *items, *tmp;
+  size_t      i;
+
+  if (nstrs < 2)
+    return;
+
+  items = malloc(nstrs * sizeof(str_item_t));
+  tmp = malloc(nstrs * sizeof(str_item_t));
+  assert(items != NULL && tmp != NULL);
+
+  for (i = 0; i < nstrs; i++)
+    items[i].str = strs[i];
+  msd_items(items, tmp, nstrs);
+  for (i = 0; i < nstrs; i++)
+    strs[i] = items[i].str;
+
+  free(items);
+  free(tmp);
+}
+
+// merge runs a and b (both with lcp arrays: lcp[i] is the common prefix
+// length of strs[i - 1] and strs[i]) into out and out_lcp. each head
+// remembers its lcp with the last string output; whichever shares more
+// with it is smaller, so characters are only compared when the two
+// are equal, and then only from that point on
+static void
+lcp_merge(str_merge_t *m)
+{
+  const str_run_t *a = &m->a, *b = &m->b;
+  size_t i = 0, j = 0, t = 0;
+  size_t ha = 0, hb = 0, h;
+
+  while (i < a->nstrs && j < b->nstrs) {
+    if (ha > hb) {
+      m->out_lcp[t] = ha;
+      m->out[t++] = a->strs[i++];
+      if (i < a->nstrs)
+        ha = a->lcp[i];
+    }
+    else if (hb > ha) {
+      m->out_lcp[t] = hb;
+      m->out[t++] = b->strs[j++];
+      if (j < b->nstrs)
+        hb = b->lcp[j];
+    }
+    else {
+      h = lcp_from(a->strs[i], b->strs[j], ha);
+      if (char_at(a->strs[i], h) <= char_at(b->strs[j], h)) {
+        m->out_lcp[t] = ha;
+        m->out[t++] = a->strs[i++];
+        hb = h;
+        if (i < a->nstrs)
+          ha = a->lcp[i];
+      }
+      else {
+        m->out_lcp[t] = hb;
+        m->out[t++] = b->strs[j++];
+        ha = h;
+        if (j < b->nstrs)
+          hb = b->lcp[j];
+      }
+    }
+  }
+
+  // the first string copied from the leftover run still has its lcp
+  // with the last one output in ha or hb; the rest keep their own
+  if (i < a->nstrs) {
+    m->out_lcp[t] = ha;
+    m->out[t++] = a->strs[i++];
+  }
+  if (j < b->nstrs) {
+    m->out_lcp[t] = hb;
+    m->out[t++] = b->strs[j++];
+  }
+  memcpy(&m->out[t], &a->strs[i], (a->nstrs - i) * sizeof(const char *));
+  memcpy(&m->out_lcp[t], &a->lcp[i], (a->nstrs - i) * sizeof(size_t));
+  t += a->nstrs - i;
+  memcpy(&m->out[t], &b->strs[j], (b->nstrs - j) * sizeof(const char *));
+  memcpy(&m->out_lcp[t], &b->lcp[j], (b->nstrs - j) * sizeof(size_t));
+}
+
+static void *
+run_sort_thread(void *arg)
+{
+  str_run_t *run = (str_run_t *) arg;
+  size_t     i;
+
+  sort_thread_start();
+
+  string_sort_radix(run->strs, run->nstrs);
+  if (run->nstrs > 0)
+    run->lcp[0] = 0;
+  for (i = 1; i < run->nstrs; i++)
+    run->lcp[i] = lcp_from(run->strs[i - 1], run->strs[i], 0);
+
+  sort_thread_end();
+  return NULL;
+}
+
+static void *
+lcp_merge_thread(void *arg)
+{
+  sort_thread_start();
+  lcp_merge((str_merge_t *) arg);
+  sort_thread_end();
+
+  return NULL;
+}
+
+// sort strs[0 .. nstrs - 1]; with multithread, each thread radix sorts
+// a run and the runs are merged pairwise, a level at a time, by
+// lcp_merge (which reuses the lcps of the runs instead of comparing
+// strings from the start)
+void
+string_sort(const char **strs, size_t nstrs, bool multithread)
+{
+  str_run_t   *runs;
+  str_merge_t *merges;
+  pthread_t   *threads;
+  const char **bufs[2];
+  size_t      *lcps[2];
+  size_t       nruns, r, m, nmerges, off, share;
+  int          cur = 0, rc;
+
+  nruns = multithread ? sort_get_threads() : 1;
+  if (nruns > nstrs / STRSORT_THREAD_NSTRS)
+    nruns = (nstrs / STRSORT_THREAD_NSTRS > 0) ? nstrs / STRSORT_THREAD_NSTRS : 1;
+
+  if (nruns == 1) {
+    string_sort_radix(strs, nstrs);
+    return;
+  }
+
+  bufs[0] = strs;
+  bufs[1] = malloc(nstrs * sizeof(const char *));
+  lcps[0] = malloc(nstrs * sizeof(size_t));
+  lcps[1] = malloc(nstrs * sizeof(size_t));
+  runs = malloc(nruns * sizeof(str_run_t));
+  merges = malloc(nruns * sizeof(str_merge_t));
+  threads = malloc(nruns * sizeof(pthread_t));
+  assert(bufs[1] != NULL && lcps[0] != NULL && lcps[1] != NULL &&
+         runs != NULL && merges != NULL && threads != NULL);
+
+  share = nstrs / nruns;
+  for (r = 0; r < nruns; r++) {
+    off = r * share;
+    runs[r].strs = &strs[off];
+    runs[r].lcp = &lcps[0][off];
+    runs[r].nstrs = (r == nruns - 1) ? nstrs - off : share;
+    rc = pthread_create(&threads[r], NULL, &run_sort_thread, &runs[r]);
+    assert(rc == 0);
+    SORT_STAT_ADD(thread_spawns, 1);
+  }
+  for (r = 0; r < nruns; r++)
+    pthread_join(threads[r], NULL);
+
+  // merge neighbouring runs until one is left, ping-ponging between
+  // the two buffers
+  while (nruns > 1) {
+    nmerges = nruns / 2;
+    off = 0;
+    for (m = 0; m < nmerges; m++) {
+      merges[m].a = runs[2 * m];
+      merges[m].b = runs[2 * m + 1];
+      merges[m].out = &bufs[1 - cur][off];
+      merges[m].out_lcp = &lcps[1 - cur][off];
+      off += runs[2 * m].nstrs + runs[2 * m + 1].nstrs;
+      rc = pthread_create(&threads[m], NULL, &lcp_merge_thread, &merges[m]);
+      assert(rc == 0);
+      SORT_STAT_ADD(thread_spawns, 1);
+    }
+    // an odd run out is carried over to the other buffer as it is
+    if (nruns % 2 == 1) {
+      r = nruns - 1;
+      memcpy(&bufs[1 - cur][off], runs[r].strs, runs[r].nstrs * sizeof(const char *));
+      memcpy(&lcps[1 - cur][off], runs[r].lcp, runs[r].nstrs * sizeof(size_t));
+      runs[nmerges].strs = &bufs[1 - cur][off];
+      runs[nmerges].lcp = &lcps[1 - cur][off];
+      runs[nmerges].nstrs = runs[r].nstrs;
+    }
+    for (m = 0; m < nmerges; m++) {
+      pthread_join(threads[m], NULL);
+      runs[m].strs = merges[m].out;
+      runs[m].lcp = merges[m].out_lcp;
+      runs[m].nstrs = merges[m].a.nstrs + merges[m].b.nstrs;
+    }
+    nruns = nmerges + nruns % 2;
+    cur = 1 - cur;
+  }
+
+  if (cur != 0)
+    memcpy(strs, bufs[cur], nstrs * sizeof(const char *));
+
+  free(bufs[1]);
+  free(lcps[0]);
+  free(lcps[1]);
+  free(runs);
+  free(merges);
+  free(threads);
+}
@@ -0,0 +1,94 @@
+//
+// textbench.c
+//
+// sorting a text file of integers: parse, sort and format, with the
+// throughput of each stage reported separately
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+
+static void
+print_stage(const char *stage, double secs, size_t nelts, size_t nbytes)
+{
+  printf("%-8s %8.3f s %10.1f Melts/s", stage, secs,
+         secs > 0 ? nelts / secs / 1E6 : 0.0);
+  if (nbytes > 0)
+    printf(" %10.1f MB/s", secs > 0 ? nbytes / secs / 1E6 : 0.0);
+  printf("\n");
+}
+
+int
+text_bench(const char *inpath, const char *outpath)
+{
+  struct timeval tv_start, tv_end;
+  struct stat st;
+  long    *data, *back;
+  size_t   nelts, nback, inbytes, outbytes;
+  double   parse_time, sort_time, format_time;
+  uint64_t fingerprint;
+
+  if (stat(inpath, &st) != 0) {
+    printf("error: cannot stat %s\n", inpath);
+    return -1;
+  }
+  inbytes = (size_t) st.st_size;
+
+  gettimeofday(&tv_start, NULL);
+  data = text_read_longs(inpath, &nelts, true);
+  gettimeofday(&tv_end, NULL);
+  if (data == NULL)
+    return -1;
+  parse_time = elapsed(&tv_start, &tv_end);
+
+  printf("text: %zu elements in %zu bytes, %zu threads\n", nelts, inbytes,
+         sort_get_threads());
+  printf("sorting: sort method is quicksort opt mt\n");
+  fingerprint = sort_fingerprint(data, nelts);
+
+  gettimeofday(&tv_start, NULL);
+  if (nelts > 1)
+    quicksort_opt(data, 0, nelts - 1, true);
+  gettimeofday(&tv_end, NULL);
+  sort_time = elapsed(&tv_start, &tv_end);
+
+  if (!check_sort_perm(data, nelts, fingerprint)) {
+    printf("\n**** data is not sorted!\n");
+    free(data);
+    return -1;
+  }
+
+  // without an output file the formatting still gets timed
+  gettimeofday(&tv_start, NULL);
+  if (!text_write_longs(outpath ? outpath : "/dev/null", data, nelts, true,
+                        &outbytes)) {
+    free(data);
+    return -1;
+  }
+  gettimeofday(&tv_end, NULL);
+  format_time = elapsed(&tv_start, &tv_end);
+
+  // read the output back: nothing may be lost formatting it
+  if (outpath != NULL) {
+    back = text_read_longs(outpath, &nback, true);
+    if (back == NULL || nback != nelts ||
+        !check_sort_perm(back, nback, fingerprint))
+      printf("\n**** %s doesn't hold the sorted input!\n", outpath);
+    free(back);
+  }
+
+  printf("\n");
+  print_stage("parse", parse_time, nelts, inbytes);
+  print_stage("sort", sort_time, nelts, 0);
+  print_stage("format", format_time, nelts, outbytes);
+  print_stage("total", parse_time + sort_time + format_time, nelts, 0);
+
+  free(data);
+  return 0;
+}
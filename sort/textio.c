@@ -0,0 +1,549 @@
+//
+// textio.c
+//
+// fast text input and output of longs: text_read_longs() maps a file of
+// decimal integers and parses it eight bytes at a time across threads;
+// text_write_longs() formats without printf into large buffers, one
+// writer per thread
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h> /* LONG_MAX */
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sorts.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the SWAR parser assumes a little-endian machine"
+#endif
+
+// b in every byte of a 64-bit word
+#define SWAR_BYTES(b) (0x0101010101010101ULL * (uint64_t) (b))
+
+// one thread's share of the text, or of the array to write out
+typedef struct {
+  const char *start;
+  const char *end;
+  const long *data;   // write: elements to format
+  long       *out;    // read: where the parsed numbers go
+  size_t      nelts;
+  size_t      nbytes; // write: formatted length of data[0 .. nelts - 1]
+  off_t       offset; // write: file offset of the formatted text
+  int         fd;
+  bool        ok;
+} text_chunk_t;
+
+static const uint64_t pow10_table[9] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+static const char digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+static inline bool
+is_digit(char c)
+{
+  return (unsigned char) (c - '0') < 10;
+}
+
+static inline uint64_t
+load8(const char *p)
+{
+  uint64_t x;
+
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+// high bit set in each byte of x that is an ascii digit: the high
+// nibble must be 3 and the low nibble must not carry when 6 is added
+// (done per nibble so nothing carries between bytes)
+static inline uint64_t
+digit_mask(uint64_t x)
+{
+  uint64_t m = ((x & SWAR_BYTES(0xF0)) ^ SWAR_BYTES(0x30)) |
+               (((x & SWAR_BYTES(0x0F)) + SWAR_BYTES(0x06)) & SWAR_BYTES(0xF0));
+
+  // bytes of m are zero exactly for the digits
+  return ~(((m & SWAR_BYTES(0x7F)) + SWAR_BYTES(0x7F)) | m) & SWAR_BYTES(0x80);
+}
+
+// value of the ndigits (1 .. 8) digits in the low bytes of x: move them
+// to the top so the missing ones become leading zeros, then combine
+// pairs, quads and the two halves with multiplies
+static inline uint64_t
+parse8(uint64_t x, size_t ndigits)
+{
+  uint64_t v = (x - SWAR_BYTES('0')) << (8 * (8 - ndigits));
+
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+       (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+
+  return v;
+}
+
+// count the numbers (runs of digits) in [p .. end); p must not be in
+// the middle of a number
+static size_t
+count_numbers(const char *p, const char *end)
+{
+  uint64_t d, prev = 0;
+  size_t   n = 0;
+  bool     in_number;
+
+  for (; end - p >= 8; p += 8) {
+    d = digit_mask(load8(p));
+    // a number starts at every digit that doesn't follow a digit
+    n += __builtin_popcountll(d & ~((d << 8) | prev));
+    prev = d >> 56;
+  }
+
+  in_number = (prev != 0);
+  for (; p < end; p++) {
+    if (is_digit(*p)) {
+      if (!in_number)
+        n++;
+      in_number = true;
+    }
+    else {
+      in_number = false;
+    }
+  }
+
+  return n;
+}
+
+// parse the numbers in [p .. end) into out[]; anything other than
+// digits and a leading '-' separates them. returns false if a number
+// doesn't fit in a long (it's parsed as 0, and the rest still parsed)
+static bool
+parse_numbers(const char *p, const char *end, long *out)
+{
+  uint64_t val, nondigits;
+  size_t   n = 0, ndigits;
+  bool     neg, overflow, ok = true;
+
+  while (p < end) {
+    neg = false;
+    if (!is_digit(*p)) {
+      if (*p == '-' && p + 1 < end && is_digit(p[1])) {
+        neg = true;
+      }
+      p++;
+      if (!neg)
+        continue;
+    }
+
+    val = 0;
+    overflow = false;
+    while (end - p >= 8) {
+      nondigits = ~digit_mask(load8(p)) & SWAR_BYTES(0x80);
+      ndigits = nondigits ? __builtin_ctzll(nondigits) / 8 : 8;
+      if (ndigits == 0)
+        break;
+      overflow |= __builtin_mul_overflow(val, pow10_table[ndigits], &val);
+      overflow |= __builtin_add_overflow(val, parse8(load8(p), ndigits), &val);
+      p += ndigits;
+      if (ndigits < 8)
+        break;
+    }
+    // close to the end of the text there isn't a whole word to load
+    while (p < end && is_digit(*p)) {
+      overflow |= __builtin_mul_overflow(val, 10, &val);
+      overflow |= __builtin_add_overflow(val, (uint64_t) (*p - '0'), &val);
+      p++;
+    }
+
+    // -2^63 is a long, 2^63 isn't; negate unsigned so -2^63 doesn't
+    // overflow on the way
+    if (overflow || val > (uint64_t) LONG_MAX + neg) {
+      ok = false;
+      val = 0;
+    }
+    out[n++] = neg ? (long) (0UL - val) : (long) val;
+  }
+
+  return ok;
+}
+
+static void *
+count_thread(void *arg)
+{
+  text_chunk_t *chunk = (text_chunk_t *) arg;
+
+  sort_thread_start();
+  chunk->nelts = count_numbers(chunk->start, chunk->end);
+  sort_thread_end();
+
+  return NULL;
+}
+
+static void *
+parse_thread(void *arg)
+{
+  text_chunk_t *chunk = (text_chunk_t *) arg;
+
+  sort_thread_start();
+  chunk->ok = parse_numbers(chunk->start, chunk->end, chunk->out);
+  sort_thread_end();
+
+  return NULL;
+}
+
+// run fn on each of the nchunks chunks, in threads if there's more
+// than one
+static void
+run_chunks(void *(*fn)(void *), text_chunk_t *chunks, size_t nchunks)
+{
+  pthread_t *threads;
+  size_t     c;
+  int        rc;
+
+  if (nchunks == 1) {
+    fn(&chunks[0]);
+    return;
+  }
+
+  threads = malloc(nchunks * sizeof(pthread_t));
+  assert(threads != NULL);
+
+  for (c = 0; c < nchunks; c++) {
+    rc = pthread_create(&threads[c], NULL, fn, &chunks[c]);
+    assert(rc == 0);
+  }
+  for (c = 0; c < nchunks; c++)
+    pthread_join(threads[c], NULL);
+
+  free(threads);
+}
+
+// read the whitespace (or otherwise) separated decimal integers in the
+// file at path into a newly malloc'd array, which the caller frees;
+// *nelts is set to the number of integers. returns NULL (after
+// printing why) if the file can't be read or a number doesn't fit in a
+// long
+long *
+text_read_longs(const char *path, size_t *nelts, bool multithread)
+{
+  struct stat   st;
+  text_chunk_t *chunks;
+  const char   *text, *p;
+  long         *data;
+  size_t        nchunks, c, len, n;
+  int           fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    printf("error: cannot open %s: %s\n", path, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+
+  len = (size_t) st.st_size;
+  if (len == 0) {
+    close(fd);
+    *nelts = 0;
+    return malloc(sizeof(long));
+  }
+
+  text = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
+    printf("error: cannot map %s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  madvise((void *) text, len, MADV_SEQUENTIAL);
+
+  // split the text into one chunk per thread, moving each split point
+  // forward past the number it lands in
+  nchunks = multithread ? sort_get_threads() : 1;
+  if (nchunks > len / TEXT_CHUNK_MIN_BYTES)
+    nchunks = (len / TEXT_CHUNK_MIN_BYTES > 0) ? len / TEXT_CHUNK_MIN_BYTES : 1;
+
+  chunks = calloc(nchunks, sizeof(text_chunk_t));
+  assert(chunks != NULL);
+
+  p = text;
+  for (c = 0; c < nchunks; c++) {
+    chunks[c].start = p;
+    p = (c == nchunks - 1) ? text + len : text + len / nchunks * (c + 1);
+    if (p < chunks[c].start)
+      p = chunks[c].start;
+    while (p < text + len && p > text && (is_digit(p[-1]) || p[-1] == '-'))
+      p++;
+    chunks[c].end = p;
+  }
+
+  // count the numbers in each chunk so every thread knows where its
+  // numbers go, then parse
+  run_chunks(&count_thread, chunks, nchunks);
+
+  n = 0;
+  for (c = 0; c < nchunks; c++)
+    n += chunks[c].nelts;
+
+  data = malloc((n > 0 ? n : 1) * sizeof(long));
+  if (data == NULL) {
+    printf("error: cannot allocate memory for %zu elements\n", n);
+    munmap((void *) text, len);
+    free(chunks);
+    return NULL;
+  }
+
+  n = 0;
+  for (c = 0; c < nchunks; c++) {
+    chunks[c].out = &data[n];
+    n += chunks[c].nelts;
+  }
+  run_chunks(&parse_thread, chunks, nchunks);
+
+  munmap((void *) text, len);
+  for (c = 0; c < nchunks; c++) {
+    if (!chunks[c].ok) {
+      printf("error: %s has a number that doesn't fit in a long\n", path);
+      free(data);
+      free(chunks);
+      return NULL;
+    }
+  }
+  free(chunks);
+
+  *nelts = n;
+  return data;
+}
+
+// number of decimal digits in v
+static inline size_t
+decimal_length(uint64_t v)
+{
+  size_t len = 1;
+
+  while (v >= 100) {
+    v /= 100;
+    len += 2;
+  }
+
+  return len + (v >= 10);
+}
+
+// formatted length of val, including its newline
+static inline size_t
+formatted_length(long val)
+{
+  return (val < 0) + decimal_length(val < 0 ? -(uint64_t) val : (uint64_t) val) + 1;
+}
+
+// format val and a newline into buf, two digits at a time from the
+// end; returns the length
+static inline size_t
+format_long(long val, char *buf)
+{
+  uint64_t v = (val < 0) ? -(uint64_t) val : (uint64_t) val;
+  size_t   len = formatted_length(val);
+  char    *p = buf + len - 1;
+
+  *p = '\n';
+  while (v >= 100) {
+    p -= 2;
+    memcpy(p, &digit_pairs[2 * (v % 100)], 2);
+    v /= 100;
+  }
+  if (v >= 10) {
+    p -= 2;
+    memcpy(p, &digit_pairs[2 * v], 2);
+  }
+  else {
+    *--p = (char) ('0' + v);
+  }
+  if (val < 0)
+    *--p = '-';
+
+  return len;
+}
+
+// write all of buf at offset (or at the current position if offset
+// is negative)
+static bool
+write_all(int fd, const char *buf, size_t len, off_t offset)
+{
+  ssize_t rc;
+
+  while (len > 0) {
+    rc = (offset < 0) ? write(fd, buf, len) : pwrite(fd, buf, len, offset);
+    if (rc < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    buf += rc;
+    len -= (size_t) rc;
+    if (offset >= 0)
+      offset += rc;
+  }
+
+  return true;
+}
+
+// format chunk->data into a TEXT_WRITE_BUF_BYTES buffer, writing it out
+// whenever it fills up; chunk->nbytes is set to the length written
+static void
+format_chunk(text_chunk_t *chunk)
+{
+  char  *buf = malloc(TEXT_WRITE_BUF_BYTES);
+  off_t  offset = chunk->offset;
+  size_t i, used = 0;
+
+  assert(buf != NULL);
+
+  chunk->ok = true;
+  chunk->nbytes = 0;
+  for (i = 0; i < chunk->nelts; i++) {
+    if (used > TEXT_WRITE_BUF_BYTES - TEXT_MAX_NUMBER_BYTES) {
+      if (!write_all(chunk->fd, buf, used, offset)) {
+        chunk->ok = false;
+        break;
+      }
+      if (offset >= 0)
+        offset += (off_t) used;
+      chunk->nbytes += used;
+      used = 0;
+    }
+    used += format_long(chunk->data[i], &buf[used]);
+  }
+
+  if (chunk->ok && used > 0) {
+    chunk->ok = write_all(chunk->fd, buf, used, offset);
+    chunk->nbytes += used;
+  }
+
+  free(buf);
+}
+
+static void *
+length_thread(void *arg)
+{
+  text_chunk_t *chunk = (text_chunk_t *) arg;
+  size_t i;
+
+  sort_thread_start();
+  chunk->nbytes = 0;
+  for (i = 0; i < chunk->nelts; i++)
+    chunk->nbytes += formatted_length(chunk->data[i]);
+  sort_thread_end();
+
+  return NULL;
+}
+
+static void *
+format_thread(void *arg)
+{
+  sort_thread_start();
+  format_chunk((text_chunk_t *) arg);
+  sort_thread_end();
+
+  return NULL;
+}
+
+// write data[0 .. nelts - 1] to the file at path ("-" for stdout), one
+// number per line; if nbytes isn't NULL the number of bytes written is
+// stored there. with multithread, each thread formats and writes its
+// own part of the file, which needs a regular file (elsewhere the
+// output is written by one thread). returns false (after printing why)
+// on errors
+bool
+text_write_longs(const char *path, const long *data, size_t nelts,
+                 bool multithread, size_t *nbytes)
+{
+  struct stat   st;
+  text_chunk_t *chunks;
+  size_t        nchunks, c, share, total = 0;
+  off_t         offset = 0;
+  bool          ok = true;
+  int           fd;
+
+  if (strcmp(path, "-") == 0) {
+    fflush(stdout);
+    fd = STDOUT_FILENO;
+  }
+  else {
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      printf("error: cannot open %s: %s\n", path, strerror(errno));
+      return false;
+    }
+  }
+
+  // the threads write at offsets, which needs a regular file
+  nchunks = 1;
+  if (multithread && fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    nchunks = sort_get_threads();
+  if (nchunks > nelts / TEXT_CHUNK_MIN_NELTS)
+    nchunks = (nelts / TEXT_CHUNK_MIN_NELTS > 0) ? nelts / TEXT_CHUNK_MIN_NELTS : 1;
+
+  chunks = calloc(nchunks, sizeof(text_chunk_t));
+  assert(chunks != NULL);
+
+  share = nelts / nchunks;
+  for (c = 0; c < nchunks; c++) {
+    chunks[c].data = &data[c * share];
+    chunks[c].nelts = (c == nchunks - 1) ? nelts - c * share : share;
+    chunks[c].fd = fd;
+    chunks[c].offset = -1;
+  }
+
+  if (nchunks == 1) {
+    format_chunk(&chunks[0]);
+    ok = chunks[0].ok;
+    total = chunks[0].nbytes;
+  }
+  else {
+    // lengths first, so each thread knows where in the file its part goes
+    run_chunks(&length_thread, chunks, nchunks);
+    for (c = 0; c < nchunks; c++) {
+      chunks[c].offset = offset;
+      offset += (off_t) chunks[c].nbytes;
+    }
+    total = (size_t) offset;
+
+    if (ftruncate(fd, offset) != 0)
+      ok = false;
+    if (ok) {
+      run_chunks(&format_thread, chunks, nchunks);
+      for (c = 0; c < nchunks; c++)
+        ok = ok && chunks[c].ok;
+    }
+  }
+
+  if (!ok)
+    printf("error: cannot write %s: %s\n", path, strerror(errno));
+  if (fd != STDOUT_FILENO && close(fd) != 0)
+    ok = false;
+
+  free(chunks);
+
+  if (nbytes != NULL)
+    *nbytes = total;
+
+  return ok;
+}
@@ -0,0 +1,165 @@
+//
+// uniqbench.c
+//
+// benchmarking sort_unique/sort_count against a sort followed by a
+// separate unique or histogram pass
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "sorts.h"
+#include "bench.h"
+#include "sortstats.h"
+
+// bytes the merge passes of sort_unique would move for nelts elements
+// of eltsz bytes if they didn't drop duplicates: every level reads its
+// runs from one buffer and writes them merged into the other
+static double
+plain_merge_traffic(size_t nelts, size_t eltsz)
+{
+  size_t levels = 0;
+  size_t n = nelts;
+
+  while (n > UNIQUE_RUN_NELTS) {
+    n = (n + 1) / 2;
+    levels++;
+  }
+
+  return 2.0 * nelts * eltsz * levels;
+}
+
+static void
+print_traffic(const char *what, double bytes)
+{
+  printf("traffic: %-40s %10.1f MB\n", what, bytes / M);
+}
+
+int
+unique_bench(long *origdata, size_t nelts)
+{
+  struct timeval tv_start, tv_end;
+  long   *data;
+  size_t *counts;
+  size_t  i, u = 0, nunique = 0, total, traffic;
+  int     method;
+  double  plain;
+
+  data = calloc(nelts, sizeof(long));
+  counts = calloc(nelts, sizeof(size_t));
+  if (data == NULL || counts == NULL) {
+    printf("error: cannot allocate memory for data\n");
+    return -1;
+  }
+
+  for (method = 0; method < 6; method++) {
+    memcpy(data, origdata, nelts * sizeof(long));
+    traffic = 0;
+
+    sort_stats_reset();
+    gettimeofday(&tv_start, NULL);
+    switch (method) {
+      case 0:
+      printf("sorting: sort method is quicksort opt mt + unique pass\n");
+      quicksort_opt(data, 0, nelts - 1, true);
+      for (i = 1, u = 1; i < nelts; i++) {
+        if (data[i] != data[u - 1])
+          data[u++] = data[i];
+      }
+      break;
+
+      case 1:
+      printf("sorting: sort method is quicksort opt mt + histogram pass\n");
+      quicksort_opt(data, 0, nelts - 1, true);
+      counts[0] = 1;
+      for (i = 1, u = 1; i < nelts; i++) {
+        if (data[i] != data[u - 1]) {
+          counts[u] = 1;
+          data[u++] = data[i];
+        }
+        else {
+          counts[u - 1]++;
+        }
+      }
+      break;
+
+      case 2:
+      printf("sorting: sort method is sort_unique\n");
+      u = sort_unique(data, nelts, false, &traffic);
+      break;
+
+      case 3:
+      printf("sorting: sort method is sort_unique mt\n");
+      u = sort_unique(data, nelts, true, &traffic);
+      break;
+
+      case 4:
+      printf("sorting: sort method is sort_count\n");
+      u = sort_count(data, counts, nelts, false, &traffic);
+      break;
+
+      case 5:
+      printf("sorting: sort method is sort_count mt\n");
+      u = sort_count(data, counts, nelts, true, &traffic);
+      break;
+    }
+    gettimeofday(&tv_end, NULL);
+
+    if (method == 0)
+      nunique = u;
+    if (u != nunique || !check_sort(data, u))
+      printf("\n**** wrong number of unique values or not sorted!\n");
+    if (method == 1 || method >= 4) {
+      for (i = 0, total = 0; i < u; i++)
+        total += counts[i];
+      if (total != nelts)
+        printf("\n**** counts don't add up to %zu!\n", nelts);
+    }
+
+    printf("finished: %zu elements, %zu unique, in %.2f seconds\n",
+           nelts, u, elapsed(&tv_start, &tv_end));
+    sort_stats_print();
+
+    // memory traffic of the deduplication itself, compared with the
+    // same merges without it plus a separate pass over the sorted data
+    switch (method) {
+      case 0:
+      print_traffic("separate unique pass (read n, write u)",
+                    (double) (nelts + u) * sizeof(long));
+      break;
+
+      case 1:
+      print_traffic("separate histogram pass (read n, write 2u)",
+                    (double) (nelts + 2 * u) * sizeof(long));
+      break;
+
+      case 2:
+      case 3:
+      plain = plain_merge_traffic(nelts, sizeof(long));
+      print_traffic("merges without dedup + unique pass",
+                    plain + (double) (nelts + u) * sizeof(long));
+      print_traffic("fused sort_unique merges", (double) traffic);
+      print_traffic("saved",
+                    plain + (double) (nelts + u) * sizeof(long) - traffic);
+      break;
+
+      case 4:
+      case 5:
+      plain = plain_merge_traffic(nelts, sizeof(long));
+      print_traffic("merges without counting + histogram pass",
+                    plain + (double) (nelts + 2 * u) * sizeof(long));
+      print_traffic("fused sort_count merges", (double) traffic);
+      print_traffic("saved",
+                    plain + (double) (nelts + 2 * u) * sizeof(long) - traffic);
+      break;
+    }
+    printf("\n");
+  }
+
+  free(data);
+  free(counts);
+  return 0;
+}
@@ -0,0 +1,301 @@
+//
+// unique.c
+//
+// deduplicating sorts: sort_unique() folds duplicate elimination into
+// every merge pass, so duplicates are dropped as early as possible and
+// never make it into the later passes; sort_count() keeps duplicates
+// until the last merge, which counts them as it drops them, so no
+// counts are carried through the passes before it
+//
+// the passes alternate between data and tmpdata, each merging from one
+// into the other, instead of copying every merge back
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <assert.h>
+#include <pthread.h>
+#include "sorts.h"
+#include "sortstats.h"
+
+// one (sub-)sort handed to a thread
+typedef struct {
+  long   *data;
+  long   *tmpdata;
+  size_t  nelts;
+  bool    dedup;      // drop duplicates (sort_unique), or keep them
+  bool    to_tmp;     // leave the result in tmpdata rather than data
+  ushort  spawn_depth;
+  size_t  nunique;    // result
+  size_t  traffic;    // result: bytes moved by the merge passes
+} unique_info_t;
+
+static void *unique_core_thread(void *arg);
+
+// base case: sort a run in place, then write it to dst (which may be
+// data itself), squeezing out its duplicates if dedup is set
+static size_t
+unique_run(long *data, long *dst, size_t nelts, bool dedup)
+{
+  size_t i, u;
+
+  quicksort_opt(data, 0, nelts - 1, false);
+
+  if (!dedup) {
+    if (dst != data)
+      memcpy(dst, data, nelts * sizeof(long));
+    return nelts;
+  }
+
+  dst[0] = data[0];
+  for (i = 1, u = 0; i < nelts; i++) {
+    if (data[i] != dst[u])
+      dst[++u] = data[i];
+  }
+
+  return u + 1;
+}
+
+// merge the sorted runs src[0 .. n1 - 1] and src[off2 .. off2 + n2 - 1]
+// into dst[0 ..]; if dedup is set the runs are duplicate free and
+// values that appear in both are dropped; returns the merged length
+static size_t
+unique_merge(const long *src, long *dst, size_t n1, size_t off2, size_t n2,
+             bool dedup, size_t *traffic)
+{
+  size_t i = 0, j = off2, t = 0;
+  size_t imax = n1, jmax = off2 + n2;
+
+  while (i < imax && j < jmax) {
+    if (src[i] < src[j]) {
+      dst[t] = src[i];
+      i++;
+    }
+    else if (src[i] > src[j] || !dedup) {
+      dst[t] = src[j];
+      j++;
+    }
+    else {
+      dst[t] = src[i];
+      i++;
+      j++;
+    }
+    t++;
+  }
+
+  // copy rest of list #1 (if any)
+  memcpy(&dst[t], &src[i], (imax - i) * sizeof(long));
+  t += imax - i;
+
+  // copy rest of list #2 (if any)
+  memcpy(&dst[t], &src[j], (jmax - j) * sizeof(long));
+  t += jmax - j;
+
+  // read both runs, write dst
+  *traffic += (n1 + n2 + t) * sizeof(long);
+  SORT_STAT_ADD(bytes_moved, t * sizeof(long));
+
+  return t;
+}
+
+// sort_count's last merge: merge the sorted runs, duplicates and all,
+// from src into the distinct values dst[] and their counts[]
+static size_t
+count_merge(const long *src, long *dst, size_t *counts, size_t n1,
+            size_t off2, size_t n2, size_t *traffic)
+{
+  size_t i = 0, j = off2, t = 0;
+  size_t imax = n1, jmax = off2 + n2;
+  long   val;
+
+  while (i < imax || j < jmax) {
+    if (j >= jmax || (i < imax && src[i] <= src[j]))
+      val = src[i++];
+    else
+      val = src[j++];
+
+    if (t > 0 && dst[t - 1] == val) {
+      counts[t - 1]++;
+    }
+    else {
+      dst[t] = val;
+      counts[t] = 1;
+      t++;
+    }
+  }
+
+  // read both runs, write the values and counts
+  *traffic += (n1 + n2) * sizeof(long) + t * (sizeof(long) + sizeof(size_t));
+  SORT_STAT_ADD(bytes_moved, t * (sizeof(long) + sizeof(size_t)));
+
+  return t;
+}
+
+// count the duplicates of the sorted data[0 .. nelts - 1] in place, for
+// a sort_count that's only one run
+static size_t
+count_run(long *data, size_t *counts, size_t nelts)
+{
+  size_t i, u = 0;
+
+  counts[0] = 1;
+  for (i = 1; i < nelts; i++) {
+    if (data[i] != data[u]) {
+      data[++u] = data[i];
+      counts[u] = 1;
+    }
+    else {
+      counts[u]++;
+    }
+  }
+
+  return u + 1;
+}
+
+// core subroutine of sort_unique and sort_count: split in half, sort
+// each half into the other buffer (spawning a thread for the left one
+// while spawn_depth > 0), then merge them back into data, or tmpdata if
+// to_tmp is set; if counts isn't NULL this is sort_count's last merge
+static size_t
+unique_core(long *data, long *tmpdata, size_t *counts, size_t nelts,
+            bool dedup, bool to_tmp, ushort spawn_depth, size_t *traffic)
+{
+  size_t mid = nelts / 2;
+  size_t n1, n2;
+  long  *src = to_tmp ? data : tmpdata;
+  long  *dst = to_tmp ? tmpdata : data;
+  unique_info_t cthread_info;
+  pthread_t cthread;
+  int rc;
+
+  if (nelts <= UNIQUE_RUN_NELTS)
+    return unique_run(data, dst, nelts, dedup);
+
+  if (spawn_depth > 0) {
+    cthread_info.data = data;
+    cthread_info.tmpdata = tmpdata;
+    cthread_info.nelts = mid;
+    cthread_info.dedup = dedup;
+    cthread_info.to_tmp = !to_tmp;
+    cthread_info.spawn_depth = spawn_depth - 1;
+    cthread_info.traffic = 0;
+
+    rc = pthread_create(&cthread, NULL, &unique_core_thread, &cthread_info);
+    assert(rc == 0);
+    SORT_STAT_ADD(thread_spawns, 1);
+
+    n2 = unique_core(&data[mid], &tmpdata[mid], NULL, nelts - mid, dedup,
+                     !to_tmp, spawn_depth - 1, traffic);
+
+    pthread_join(cthread, NULL);
+    n1 = cthread_info.nunique;
+    *traffic += cthread_info.traffic;
+  }
+  else {
+    n1 = unique_core(data, tmpdata, NULL, mid, dedup, !to_tmp, 0, traffic);
+    n2 = unique_core(&data[mid], &tmpdata[mid], NULL, nelts - mid, dedup,
+                     !to_tmp, 0, traffic);
+  }
+
+  if (counts != NULL)
+    return count_merge(src, dst, counts, n1, mid, n2, traffic);
+  return unique_merge(src, dst, n1, mid, n2, dedup, traffic);
+}
+
+// multi-threaded subroutine of unique_core
+static void *
+unique_core_thread(void *arg)
+{
+  unique_info_t *info = (unique_info_t *) arg;
+
+  sort_thread_start();
+
+  info->nunique = unique_core(info->data, info->tmpdata, NULL, info->nelts,
+                              info->dedup, info->to_tmp, info->spawn_depth,
+                              &info->traffic);
+  sort_thread_end();
+  return NULL;
+}
+// how many levels of threads to spawn: enough for one run per cpu,
+// but never for runs below UNIQUE_THREAD_NELTS
+static ushort
+unique_spawn_depth(size_t nelts, bool multithread)
+{
+  size_t nthreads = sort_get_threads();
+  ushort depth = 0;
+
+  if (!multithread)
+    return 0;
+
+  while (((size_t) 1 << depth) < nthreads && (nelts >> (depth + 1)) >= UNIQUE_THREAD_NELTS)
+    depth++;
+
+  return depth;
+}
+
+// sort data[0 .. nelts - 1] and remove duplicates
+//
+// returns the number of distinct values, which are left sorted in
+// data[0 .. return value - 1]; if traffic isn't NULL, the bytes read
+// and written by the merge passes are added to it
+size_t
+sort_unique(long *data, size_t nelts, bool multithread, size_t *traffic)
+{
+  long  *tmpdata;
+  size_t nunique;
+  size_t moved = 0;
+
+  if (nelts == 0)
+    return 0;
+
+  tmpdata = malloc(nelts * sizeof(long));
+  assert(tmpdata != NULL);
+
+  nunique = unique_core(data, tmpdata, NULL, nelts, true, false,
+                        unique_spawn_depth(nelts, multithread), &moved);
+
+  free(tmpdata);
+
+  if (traffic != NULL)
+    *traffic += moved;
+
+  return nunique;
+}
+
+// sort data[0 .. nelts - 1] into its distinct values and their counts
+//
+// returns the number of distinct values; data[i] is the ith smallest
+// distinct value and counts[i] (counts needs room for nelts entries)
+// is the number of times it appeared in the input; traffic as for
+// sort_unique
+size_t
+sort_count(long *data, size_t *counts, size_t nelts, bool multithread,
+           size_t *traffic)
+{
+  long  *tmpdata;
+  size_t nunique;
+  size_t moved = 0;
+
+  if (nelts == 0)
+    return 0;
+
+  if (nelts <= UNIQUE_RUN_NELTS) {
+    quicksort_opt(data, 0, nelts - 1, false);
+    return count_run(data, counts, nelts);
+  }
+
+  tmpdata = malloc(nelts * sizeof(long));
+  assert(tmpdata != NULL);
+
+  nunique = unique_core(data, tmpdata, counts, nelts, false, false,
+                        unique_spawn_depth(nelts, multithread), &moved);
+
+  free(tmpdata);
+
+  if (traffic != NULL)
+    *traffic += moved;
+
+  return nunique;
+}
@@ -11,11 +11,12 @@
 #include <math.h>
 #include <string.h> /* memcmp */
 #include "sorts.h"
+#include "sortstats.h"
 
 // validate that the input data is actually sorted
-bool check_sort(long *data, uint len)
+bool check_sort(long *data, size_t len)
 {
-  uint i;
+  size_t i;
   bool sorted = true;
 
   /* NB: i starts at 1 not 0 because we do i-1 in loop */
@@ -33,21 +34,19 @@ bool check_sort(long *data, uint len)
 }
 
 // validate that the two input data arrays are identical
-bool check_sort_cmp(long *data1, long *data2, uint len)
+bool check_sort_cmp(long *data1, long *data2, size_t len)
 {
-  uint i;
-
   return (memcmp(data1, data2, len * sizeof(long)) == 0);
 }
 
 // print out the array (for debugging)
-void print_array(long *data, uint len, int badelt)
+void print_array(long *data, size_t len, size_t badelt)
 {
-  const uint ELTS_PER_LINE = 1;
-  uint i;
+  const size_t ELTS_PER_LINE = 1;
+  size_t i;
 
   if (badelt > 0)
-    printf("bad = %d\n\n", badelt);
+    printf("bad = %zu\n\n", badelt);
 
   for (i = 0; i < len; i++) {
     printf("%ld ", data[i]);
@@ -62,16 +61,14 @@ void print_array(long *data, uint len, int badelt)
 // compare left and right (both are long*), returning -1, 0, 1
 int compare(const void *left, const void * right)
 {
-  return ( *(long*) left - *(long*) right );
-
-/*
-  if ((*((long*) left)) < (*((long*) right)))
-    return -1;
-  else if ((*((long*) left)) == (*((long*) right)))
-    return 0;
-  else
-    return 1;
-*/
+  long l = *(long*) left;
+  long r = *(long*) right;
+
+  SORT_STAT_ADD(compares, 1);
+
+  // NB: not l - r, which overflows (and is truncated to int) for
+  // values more than 2^31 apart
+  return (l > r) - (l < r);
 }
 
 
@@ -80,6 +77,8 @@ void swap_elem(void *left, void *right)
 {
   long tmp;
 
+  SORT_STAT_ADD(swaps, 1);
+
   tmp = *((long*) left);
   *((long*) left) = *((long*) right);
   *((long*) right) = tmp;
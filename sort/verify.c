@@ -0,0 +1,164 @@
+//
+// verify.c
+//
+// parallel verification of sort results: an order-independent
+// fingerprint of the input (the sum of its hashed elements, mod 2^64)
+// and a single pass that checks the output is sorted and has the same
+// fingerprint, i.e. is a sorted permutation of the input, without
+// keeping a reference copy
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "sorts.h"
+
+// one thread's slice
+typedef struct {
+  const long *data;
+  size_t      lo_ix;
+  size_t      hi_ix;     // one past the end
+  bool        check;     // check the order, too
+  uint64_t    sum;       // result: fingerprint of the slice
+  size_t      bad_ix;    // result: first out-of-order index, or hi_ix
+} verify_info_t;
+
+// splitmix64's finalizer: spreads every input bit over the output, so
+// different multisets are very unlikely to have the same hash sum
+static inline uint64_t
+hash_elem(long val)
+{
+  uint64_t x = (uint64_t) val;
+
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+
+  return x;
+}
+
+static void
+verify_slice(verify_info_t *info)
+{
+  const long *data = info->data;
+  uint64_t    sum = 0;
+  size_t      i;
+
+  info->bad_ix = info->hi_ix;
+
+  // each slice also checks the element before it, so the boundaries
+  // between slices are covered
+  if (info->check) {
+    for (i = (info->lo_ix > 0) ? info->lo_ix : 1; i < info->hi_ix; i++) {
+      if (data[i] < data[i - 1]) {
+        info->bad_ix = i;
+        break;
+      }
+    }
+  }
+
+  for (i = info->lo_ix; i < info->hi_ix; i++)
+    sum += hash_elem(data[i]);
+
+  info->sum = sum;
+}
+
+static void *
+verify_thread(void *arg)
+{
+  sort_thread_start();
+  verify_slice((verify_info_t *) arg);
+  sort_thread_end();
+
+  return NULL;
+}
+
+// fingerprint of data[0 .. len - 1] and, with check, the first index
+// that's out of order (len if none), using up to sort_get_threads()
+// threads
+static uint64_t
+verify(const long *data, size_t len, bool check, size_t *bad_ix)
+{
+  verify_info_t *info;
+  pthread_t     *threads;
+  size_t         nthreads, share, t, bad = len;
+  uint64_t       sum = 0;
+  int            rc;
+
+  nthreads = sort_get_threads();
+  if (nthreads > len / VERIFY_MIN_NELTS)
+    nthreads = (len / VERIFY_MIN_NELTS > 0) ? len / VERIFY_MIN_NELTS : 1;
+
+  info = calloc(nthreads, sizeof(verify_info_t));
+  threads = malloc(nthreads * sizeof(pthread_t));
+  assert(info != NULL && threads != NULL);
+
+  share = len / nthreads;
+  for (t = 0; t < nthreads; t++) {
+    info[t].data = data;
+    info[t].lo_ix = t * share;
+    info[t].hi_ix = (t == nthreads - 1) ? len : (t + 1) * share;
+    info[t].check = check;
+  }
+
+  // the calling thread does the first slice itself
+  for (t = 1; t < nthreads; t++) {
+    rc = pthread_create(&threads[t], NULL, &verify_thread, &info[t]);
+    assert(rc == 0);
+  }
+  verify_slice(&info[0]);
+  for (t = 1; t < nthreads; t++)
+    pthread_join(threads[t], NULL);
+
+  for (t = 0; t < nthreads; t++) {
+    sum += info[t].sum;
+    if (info[t].bad_ix < info[t].hi_ix && info[t].bad_ix < bad)
+      bad = info[t].bad_ix;
+  }
+
+  free(info);
+  free(threads);
+
+  if (bad_ix != NULL)
+    *bad_ix = bad;
+
+  return sum;
+}
+
+// order-independent fingerprint of data[0 .. len - 1]: equal for any
+// permutation of the same elements
+uint64_t
+sort_fingerprint(const long *data, size_t len)
+{
+  return verify(data, len, false, NULL);
+}
+
+// true if data[0 .. len - 1] is sorted and has the given fingerprint
+// (taken from the input with sort_fingerprint()); prints what's wrong
+// otherwise
+bool
+check_sort_perm(const long *data, size_t len, uint64_t fingerprint)
+{
+  size_t   bad_ix;
+  uint64_t sum = verify(data, len, true, &bad_ix);
+
+  if (bad_ix < len) {
+    printf("data is not sorted: data[%zu] = %ld < data[%zu] = %ld\n",
+           bad_ix, data[bad_ix], bad_ix - 1, data[bad_ix - 1]);
+    return false;
+  }
+  if (sum != fingerprint) {
+    printf("data is not a permutation of the input (fingerprint %016llx, "
+           "expected %016llx)\n", (unsigned long long) sum,
+           (unsigned long long) fingerprint);
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,320 @@
+//
+// arena.c
+//
+// slab allocator of fixed-size objects (tree and queue nodes): objects
+// are carved out of mmap'ed chunks that double in size as the arena
+// grows, so releasing everything at once is a few munmap calls instead
+// of a free per object
+//
+// each thread allocates from its own cache: a block of the current
+// chunk to bump-allocate from, and a free list of objects it freed;
+// only refilling the cache takes the arena's lock. a cache whose free
+// list gets long gives it back to the arena for the other threads, and
+// a thread that exits gives back everything its cache held
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "common.h"
+#include "arena.h"
+
+#define ARENA_MIN_CHUNK_BYTES (1UL << 20)
+#define ARENA_MAX_CHUNK_BYTES (1UL << 30)
+// objects start a cache line into their chunk, after the header
+#define ARENA_CHUNK_HEADER    64
+// a cache takes this much of the chunk at a time
+#define ARENA_BLOCK_BYTES     (64UL << 10)
+// a cache keeps at most this many freed objects
+#define ARENA_CACHE_FREE_MAX  4096
+
+// a thread's cache for one arena, found through the arena's pthread key
+typedef struct _arena_cache_ {
+  arena_t              *arena;
+  unsigned long         gen;        // generation of the arena this caches
+  char                 *next;       // bump-allocation block
+  char                 *end;
+  void                 *free_list;  // freed objects, linked through their first word
+  void                 *free_tail;
+  size_t                nfree;
+  struct _arena_cache_ *next_cache; // on the arena's list of caches
+} arena_cache_t;
+
+// every arena_init and arena_release hands out a new generation, so a
+// cache left over from before a release (whose memory is gone) is never
+// mistaken for a current one
+static unsigned long arena_gen = 0;
+
+static inline void *
+next_obj(void *obj)
+{
+  return *(void **) obj;
+}
+
+static inline void
+set_next_obj(void *obj, void *next)
+{
+  *(void **) obj = next;
+}
+
+// give the cache's objects, freed and not yet allocated, back to the
+// arena; the arena's lock is held
+static void
+return_cache(arena_t *arena, arena_cache_t *c)
+{
+  if (c->gen == arena->gen) {
+    if (c->free_list != NULL) {
+      set_next_obj(c->free_tail, arena->free_list);
+      arena->free_list = c->free_list;
+    }
+    for (; (size_t) (c->end - c->next) >= arena->obj_size;
+         c->next += arena->obj_size) {
+      set_next_obj(c->next, arena->free_list);
+      arena->free_list = c->next;
+    }
+  }
+
+  c->next = c->end = NULL;
+  c->free_list = c->free_tail = NULL;
+  c->nfree = 0;
+}
+
+// the pthread key's destructor, when a thread that used the arena exits
+static void
+cache_exit(void *arg)
+{
+  arena_cache_t  *c = (arena_cache_t *) arg;
+  arena_t        *arena = c->arena;
+  arena_cache_t **link;
+
+  pthread_mutex_lock(&arena->lock);
+  return_cache(arena, c);
+  for (link = &arena->caches; *link != c; link = &(*link)->next_cache)
+    ;
+  *link = c->next_cache;
+  pthread_mutex_unlock(&arena->lock);
+
+  free(c);
+}
+
+// this thread's cache for the arena, or NULL if there's no memory for
+// one; a cache from before the last release is emptied first
+static inline arena_cache_t *
+get_cache(arena_t *arena)
+{
+  arena_cache_t *c = pthread_getspecific(arena->key);
+
+  if (c == NULL) {
+    c = calloc(1, sizeof(arena_cache_t));
+    if (c == NULL)
+      return NULL;
+    c->arena = arena;
+    c->gen = arena->gen;
+    pthread_mutex_lock(&arena->lock);
+    c->next_cache = arena->caches;
+    arena->caches = c;
+    pthread_mutex_unlock(&arena->lock);
+    pthread_setspecific(arena->key, c);
+  }
+  else if (c->gen != arena->gen) {
+    c->gen = arena->gen;
+    c->next = c->end = NULL;
+    c->free_list = c->free_tail = NULL;
+    c->nfree = 0;
+  }
+
+  return c;
+}
+
+// initialize an empty arena of obj_size-byte objects
+int
+arena_init(arena_t *arena, size_t obj_size)
+{
+  if (arena == NULL || obj_size == 0 || obj_size > ARENA_BLOCK_BYTES)
+    return FAIL;
+
+  // objects need room for the free list link, and its alignment
+  if (obj_size < sizeof(void *))
+    obj_size = sizeof(void *);
+  obj_size = (obj_size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+
+  memset(arena, 0, sizeof(arena_t));
+  if (pthread_key_create(&arena->key, &cache_exit) != 0)
+    return FAIL;
+  arena->obj_size = obj_size;
+  arena->gen = __atomic_add_fetch(&arena_gen, 1, __ATOMIC_RELAXED);
+  pthread_mutex_init(&arena->lock, NULL);
+
+  return SUCCESS;
+}
+
+// refill an empty cache with objects freed to the arena if there are
+// any, or with a new block (from a new chunk if need be)
+static int
+refill_cache(arena_t *arena, arena_cache_t *c)
+{
+  size_t         block = ARENA_BLOCK_BYTES / arena->obj_size * arena->obj_size;
+  size_t         bytes;
+  arena_chunk_t *chunk;
+  void          *obj;
+
+  pthread_mutex_lock(&arena->lock);
+
+  if (arena->free_list != NULL) {
+    c->free_list = obj = arena->free_list;
+    for (c->nfree = 1; c->nfree < ARENA_CACHE_FREE_MAX && next_obj(obj) != NULL;
+         c->nfree++)
+      obj = next_obj(obj);
+    arena->free_list = next_obj(obj);
+    set_next_obj(obj, NULL);
+    c->free_tail = obj;
+    pthread_mutex_unlock(&arena->lock);
+    return SUCCESS;
+  }
+
+  if ((size_t) (arena->chunk_end - arena->chunk_next) < block) {
+    bytes = (arena->chunks == NULL) ? ARENA_MIN_CHUNK_BYTES : arena->chunks->bytes * 2;
+    if (bytes > ARENA_MAX_CHUNK_BYTES)
+      bytes = ARENA_MAX_CHUNK_BYTES;
+
+    chunk = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk == MAP_FAILED) {
+      pthread_mutex_unlock(&arena->lock);
+      return FAIL;
+    }
+    chunk->bytes = bytes;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->chunk_next = (char *) chunk + ARENA_CHUNK_HEADER;
+    arena->chunk_end = (char *) chunk + bytes;
+    arena->nchunks++;
+    arena->mapped_bytes += bytes;
+  }
+
+  c->next = arena->chunk_next;
+  c->end = arena->chunk_next + block;
+  arena->chunk_next += block;
+
+  pthread_mutex_unlock(&arena->lock);
+  return SUCCESS;
+}
+
+// allocate an object (uninitialized), or return NULL if out of memory
+void *
+arena_alloc(arena_t *arena)
+{
+  arena_cache_t *c = get_cache(arena);
+  void          *obj;
+
+  if (c == NULL)
+    return NULL;
+
+  if (c->free_list == NULL && (size_t) (c->end - c->next) < arena->obj_size) {
+    if (refill_cache(arena, c) != SUCCESS)
+      return NULL;
+  }
+
+  if (c->free_list != NULL) {
+    obj = c->free_list;
+    c->free_list = next_obj(obj);
+    c->nfree--;
+    return obj;
+  }
+
+  obj = c->next;
+  c->next += arena->obj_size;
+  return obj;
+}
+
+// free an object allocated from the arena (by any thread)
+void
+arena_free(arena_t *arena, void *obj)
+{
+  arena_cache_t *c;
+
+  if (obj == NULL)
+    return;
+
+  // no cache: straight to the arena
+  if ((c = get_cache(arena)) == NULL) {
+    pthread_mutex_lock(&arena->lock);
+    set_next_obj(obj, arena->free_list);
+    arena->free_list = obj;
+    pthread_mutex_unlock(&arena->lock);
+    return;
+  }
+
+  set_next_obj(obj, c->free_list);
+  if (c->free_list == NULL)
+    c->free_tail = obj;
+  c->free_list = obj;
+  c->nfree++;
+
+  // give a full free list back to the arena in one piece
+  if (c->nfree >= ARENA_CACHE_FREE_MAX) {
+    pthread_mutex_lock(&arena->lock);
+    set_next_obj(c->free_tail, arena->free_list);
+    arena->free_list = c->free_list;
+    pthread_mutex_unlock(&arena->lock);
+
+    c->free_list = c->free_tail = NULL;
+    c->nfree = 0;
+  }
+}
+
+// free every object in the arena at once, unmapping its chunks; no
+// thread may be using the arena meanwhile
+int
+arena_release(arena_t *arena)
+{
+  arena_chunk_t *chunk, *next;
+
+  if (arena == NULL)
+    return FAIL;
+
+  pthread_mutex_lock(&arena->lock);
+
+  for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    munmap(chunk, chunk->bytes);
+  }
+
+  arena->chunks = NULL;
+  arena->chunk_next = arena->chunk_end = NULL;
+  arena->free_list = NULL;
+  arena->nchunks = 0;
+  arena->mapped_bytes = 0;
+  arena->gen = __atomic_add_fetch(&arena_gen, 1, __ATOMIC_RELAXED);
+
+  pthread_mutex_unlock(&arena->lock);
+  return SUCCESS;
+}
+
+// release the arena and free the threads' caches; the threads that
+// used it must have finished with it
+int
+arena_destroy(arena_t *arena)
+{
+  arena_cache_t *c, *next;
+
+  if (arena_release(arena) != SUCCESS)
+    return FAIL;
+
+  // no more cache_exit calls, from threads that are still running
+  pthread_key_delete(arena->key);
+  for (c = arena->caches; c != NULL; c = next) {
+    next = c->next_cache;
+    free(c);
+  }
+  arena->caches = NULL;
+
+  pthread_mutex_destroy(&arena->lock);
+  return SUCCESS;
+}
@@ -0,0 +1,46 @@
+//
+// arena.h
+//
+// header file for the slab allocator of fixed-size objects
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// an mmap'ed chunk of objects; chunks double in size as the arena
+// grows, so even huge arenas are a handful of chunks
+typedef struct _arena_chunk_ {
+  struct _arena_chunk_ *next;
+  size_t                bytes;
+} arena_chunk_t;
+
+typedef struct {
+  size_t                 obj_size;
+  unsigned long          gen;          // changes on every release, see arena.c
+  arena_chunk_t         *chunks;
+  char                  *chunk_next;   // unused part of the newest chunk
+  char                  *chunk_end;
+  void                  *free_list;    // freed objects the threads' caches gave back
+  size_t                 nchunks;
+  size_t                 mapped_bytes;
+  pthread_key_t          key;          // each thread's cache
+  struct _arena_cache_  *caches;       // every thread's cache, to free them
+  pthread_mutex_t        lock;
+} arena_t;
+
+extern int arena_init(arena_t *arena, size_t obj_size);
+
+extern void *arena_alloc(arena_t *arena);
+
+extern void arena_free(arena_t *arena, void *obj);
+
+extern int arena_release(arena_t *arena);
+
+extern int arena_destroy(arena_t *arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,249 @@
+//
+// arenabench.c
+//
+// benchmarking the arena allocator against malloc: raw allocation
+// throughput from 1 and ncpus threads, building and tearing down a
+// tree, and queue element churn
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "queue.h"
+#include "arena.h"
+#include "bench.h"
+
+// one thread's share of the allocation benchmark
+typedef struct {
+  arena_t *arena;     // NULL: malloc
+  size_t   nallocs;
+  void   **objs;
+} alloc_info_t;
+
+static void *
+alloc_thread(void *arg)
+{
+  alloc_info_t *info = (alloc_info_t *) arg;
+  size_t        i;
+
+  for (i = 0; i < info->nallocs; i++) {
+    if (info->arena != NULL)
+      info->objs[i] = arena_alloc(info->arena);
+    else
+      info->objs[i] = malloc(sizeof(node_t));
+    // touch it, as a real user would
+    ((node_t *) info->objs[i])->value = (int) i;
+  }
+
+  return NULL;
+}
+
+static void *
+free_thread(void *arg)
+{
+  alloc_info_t *info = (alloc_info_t *) arg;
+  size_t        i;
+
+  for (i = 0; i < info->nallocs; i++) {
+    if (info->arena != NULL)
+      arena_free(info->arena, info->objs[i]);
+    else
+      free(info->objs[i]);
+  }
+
+  return NULL;
+}
+
+// run fn on nthreads threads, each with its share of info, and return
+// the wall time
+static double
+run_threads(void *(*fn)(void *), alloc_info_t *info, size_t nthreads)
+{
+  struct timeval tv_start, tv_end;
+  pthread_t     *threads;
+  size_t         t;
+  int            rc;
+
+  threads = malloc(nthreads * sizeof(pthread_t));
+  assert(threads != NULL);
+
+  gettimeofday(&tv_start, NULL);
+  for (t = 0; t < nthreads; t++) {
+    rc = pthread_create(&threads[t], NULL, fn, &info[t]);
+    assert(rc == 0);
+  }
+  for (t = 0; t < nthreads; t++)
+    pthread_join(threads[t], NULL);
+  gettimeofday(&tv_end, NULL);
+
+  free(threads);
+  return elapsed(&tv_start, &tv_end);
+}
+
+// nallocs node-sized allocations split among nthreads threads, then
+// freed one by one, and (arena only) released all at once
+static void
+bench_allocs(size_t nallocs, size_t nthreads, void **objs)
+{
+  struct timeval tv_start, tv_end;
+  alloc_info_t  *info;
+  arena_t        arena;
+  double         alloc_secs, free_secs, release_secs = 0.0;
+  size_t         t, chunks;
+  int            pass;
+
+  info = malloc(nthreads * sizeof(alloc_info_t));
+  assert(info != NULL);
+
+  for (pass = 0; pass < 2; pass++) {
+    if (pass == 1)
+      arena_init(&arena, sizeof(node_t));
+    for (t = 0; t < nthreads; t++) {
+      info[t].arena = (pass == 1) ? &arena : NULL;
+      info[t].nallocs = (t == nthreads - 1) ?
+        nallocs - t * (nallocs / nthreads) : nallocs / nthreads;
+      info[t].objs = &objs[t * (nallocs / nthreads)];
+    }
+
+    alloc_secs = run_threads(&alloc_thread, info, nthreads);
+    free_secs = run_threads(&free_thread, info, nthreads);
+    if (pass == 1) {
+      // allocate them all again (now from the free lists) to time the
+      // bulk release instead
+      run_threads(&alloc_thread, info, nthreads);
+      chunks = arena.nchunks;
+      gettimeofday(&tv_start, NULL);
+      arena_destroy(&arena);
+      gettimeofday(&tv_end, NULL);
+      release_secs = elapsed(&tv_start, &tv_end);
+    }
+
+    printf("  %-6s %2zu threads: alloc %6.1f M/s, free %6.1f M/s",
+           (pass == 0) ? "malloc" : "arena", nthreads,
+           nallocs / alloc_secs / 1E6, nallocs / free_secs / 1E6);
+    if (pass == 1)
+      printf(", release %.3f ms (%zu chunks)", release_secs * 1E3, chunks);
+    printf("\n");
+  }
+
+  free(info);
+}
+
+// build a tree of nvals random values and tear it down, with nodes
+// from malloc or from an arena
+static void
+bench_tree(int *vals, size_t nvals, bool use_arena)
+{
+  struct timeval tv_start, tv_end;
+  node_t *tree = NULL;
+  arena_t arena;
+  double  build_secs, teardown_secs;
+  size_t  i, chunks = 0;
+
+  if (use_arena) {
+    arena_init(&arena, sizeof(node_t));
+    node_arena = &arena;
+  }
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++)
+    insert_value(&tree, vals[i]);
+  gettimeofday(&tv_end, NULL);
+  build_secs = elapsed(&tv_start, &tv_end);
+
+  gettimeofday(&tv_start, NULL);
+  if (use_arena) {
+    chunks = arena.nchunks;
+    arena_destroy(&arena);
+    node_arena = NULL;
+  }
+  else {
+    free_tree(tree);
+  }
+  gettimeofday(&tv_end, NULL);
+  teardown_secs = elapsed(&tv_start, &tv_end);
+
+  printf("  %-6s build %8.3f s, teardown %8.3f s", use_arena ? "arena" : "malloc",
+         build_secs, teardown_secs);
+  if (use_arena)
+    printf(" (arena_release, %zu chunks)", chunks);
+  printf("\n");
+}
+
+// enQ and deQ nvals times, the queue never more than a few long (deQ
+// walks the whole queue)
+static void
+bench_queue(size_t nvals, bool use_arena)
+{
+  struct timeval tv_start, tv_end;
+  queue_t q;
+  arena_t arena;
+  node_t  node;
+  size_t  i;
+
+  if (use_arena) {
+    arena_init(&arena, sizeof(q_element_t));
+    queue_arena = &arena;
+  }
+
+  initQ(&q);
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++) {
+    enQ(&q, &node);
+    enQ(&q, &node);
+    deQ(&q);
+    deQ(&q);
+  }
+  gettimeofday(&tv_end, NULL);
+
+  printf("  %-6s %.1f ns per enQ + deQ\n", use_arena ? "arena" : "malloc",
+         elapsed(&tv_start, &tv_end) * 1E9 / (2 * nvals));
+
+  if (use_arena) {
+    arena_destroy(&arena);
+    queue_arena = NULL;
+  }
+}
+
+int
+arena_bench(size_t nvals)
+{
+  size_t ncpus = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+  void **objs;
+  int   *vals;
+  size_t i;
+
+  objs = malloc(nvals * sizeof(void *));
+  vals = malloc(nvals * sizeof(int));
+  if (objs == NULL || vals == NULL) {
+    printf("error: cannot allocate memory for values\n");
+    return FAIL;
+  }
+  for (i = 0; i < nvals; i++)
+    vals[i] = (int) random();
+
+  printf("%zu node allocations:\n", nvals);
+  bench_allocs(nvals, 1, objs);
+  if (ncpus > 1)
+    bench_allocs(nvals, ncpus, objs);
+
+  printf("\ntree of %zu random values:\n", nvals);
+  bench_tree(vals, nvals, false);
+  bench_tree(vals, nvals, true);
+
+  printf("\nqueue churn, %zu elements:\n", 2 * nvals);
+  bench_queue(nvals, false);
+  bench_queue(nvals, true);
+
+  free(objs);
+  free(vals);
+  return SUCCESS;
+}
@@ -0,0 +1,94 @@
+//
+// batchbench.c
+//
+// benchmarking find_values against a loop of find_value, on a tree
+// that fits in cache and on one of nvals values that (at the default
+// 10M values) doesn't
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "bench.h"
+
+// the cache-resident tree
+#define SMALL_NVALS (64 * 1024)
+// keys per find_values call, as a caller with a stream of lookups might
+// batch them
+#define BATCH_NKEYS 4096
+
+static int
+bench_size(size_t nvals)
+{
+  struct timeval tv_start, tv_end;
+  node_t  *tree = NULL;
+  node_t **one, **batch;
+  int     *vals, *keys;
+  size_t   i, nkeys, mismatches = 0;
+  double   one_secs, batch_secs;
+
+  vals = malloc(nvals * sizeof(int));
+  keys = malloc(nvals * sizeof(int));
+  one = malloc(nvals * sizeof(node_t *));
+  batch = malloc(nvals * sizeof(node_t *));
+  if (vals == NULL || keys == NULL || one == NULL || batch == NULL) {
+    printf("error: cannot allocate memory for values\n");
+    return FAIL;
+  }
+
+  for (i = 0; i < nvals; i++) {
+    vals[i] = (int) random();
+    insert_value(&tree, vals[i]);
+  }
+  // half the keys are there, half (almost all) aren't
+  for (i = 0; i < nvals; i++)
+    keys[i] = (i & 1) ? vals[random() % nvals] : (int) random();
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++)
+    find_value(tree, keys[i], &one[i]);
+  gettimeofday(&tv_end, NULL);
+  one_secs = elapsed(&tv_start, &tv_end);
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i += nkeys) {
+    nkeys = (nvals - i < BATCH_NKEYS) ? nvals - i : BATCH_NKEYS;
+    find_values(tree, &keys[i], nkeys, &batch[i]);
+  }
+  gettimeofday(&tv_end, NULL);
+  batch_secs = elapsed(&tv_start, &tv_end);
+
+  for (i = 0; i < nvals; i++)
+    mismatches += (one[i] != batch[i]);
+
+  printf("%10zu %8.1f MB %12.1f %12.1f %8.2fx\n", nvals,
+         nvals * sizeof(node_t) / 1E6, one_secs * 1E9 / nvals,
+         batch_secs * 1E9 / nvals, one_secs / batch_secs);
+  if (mismatches > 0)
+    printf("\n**** find_values found %zu different nodes!\n", mismatches);
+
+  free_tree(tree);
+  free(vals);
+  free(keys);
+  free(one);
+  free(batch);
+  return SUCCESS;
+}
+
+int
+batch_bench(size_t nvals)
+{
+  printf("random lookups, ns per lookup (%d searches in flight):\n",
+         FIND_BATCH);
+  printf("%10s %11s %12s %12s %9s\n", "values", "nodes", "find_value",
+         "find_values", "speedup");
+
+  if (nvals > SMALL_NVALS && bench_size(SMALL_NVALS) != SUCCESS)
+    return FAIL;
+  return bench_size(nvals);
+}
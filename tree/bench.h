@@ -0,0 +1,64 @@
+//
+// bench.h
+//
+// declaration of the trees benchmark modes, and their timing helper
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h> /* size_t */
+#include <sys/time.h>
+
+// seconds from tv_start to tv_end, as gettimeofday() gives them
+static inline double
+elapsed(struct timeval *tv_start, struct timeval *tv_end)
+{
+  return
+    (double)  (tv_end->tv_sec - tv_start->tv_sec) +
+    ((double) (tv_end->tv_usec - tv_start->tv_usec)) / 1E6;
+}
+
+// red-black tree against the unbalanced tree on nvals sorted, reverse
+// sorted and random values
+extern int rb_bench(size_t nvals);
+
+// B+tree (inserted and bulk loaded) against the unbalanced and
+// red-black trees on nvals random values
+extern int bp_bench(size_t nvals);
+
+// arena allocator against malloc: nvals allocations from 1 and ncpus
+// threads, a tree of nvals values, and queue churn
+extern int arena_bench(size_t nvals);
+
+// compact index tree (16-byte nodes, and 12-byte nodes with the refcnts
+// split off) against the pointer tree on nvals random values
+extern int idx_bench(size_t nvals);
+
+// tree cursors in every order, the Morris walk, range_scan and
+// lower_bound against a recursive walk, on nvals random values
+extern int iter_bench(size_t nvals);
+
+// tree_build_from_sorted, single and multithreaded, against
+// insert_value on nvals random and sorted values
+extern int build_bench(size_t nvals);
+
+// lookups in the frozen Eytzinger and vEB layouts against tree_search,
+// on trees from 32K values up to nvals
+extern int frozen_bench(size_t nvals);
+
+// the concurrent tree on mixes of inserts, finds and deletes, from 1
+// thread to ncpus, against tree.c
+extern int conc_bench(size_t nvals);
+
+// find_values against a loop of find_value, on a cache-resident tree
+// and on one of nvals values
+extern int batch_bench(size_t nvals);
+
+// the red-black tree's rb_select, rb_rank and rb_count_range against
+// in order walks, on nvals random values
+extern int order_bench(size_t nvals);
+
+#endif /* BENCH_H */
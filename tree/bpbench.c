@@ -0,0 +1,165 @@
+//
+// bpbench.c
+//
+// benchmarking the B+tree against the unbalanced and red-black trees:
+// inserts, bulk load, finds, range scans and memory per key
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "rbtree.h"
+#include "bptree.h"
+#include "bench.h"
+
+static int
+compare_int(const void *left, const void *right)
+{
+  int l = *(const int *) left;
+  int r = *(const int *) right;
+
+  return (l > r) - (l < r);
+}
+
+// bp_range_scan callback: adds up the refcnts
+static int
+sum_refcnt(int value, int refcnt, void *arg)
+{
+  (void) value;
+  *(size_t *) arg += refcnt;
+  return SUCCESS;
+}
+
+static void
+print_result(const char *name, size_t nvals, double insert_secs,
+             double find_secs, size_t nfound)
+{
+  printf("  %-18s insert %8.1f ns, find %8.1f ns\n", name,
+         insert_secs * 1E9 / nvals, find_secs * 1E9 / nvals);
+  if (nfound != nvals)
+    printf("\n**** %s lost values!\n", name);
+}
+
+int
+bp_bench(size_t nvals)
+{
+  struct timeval tv_start, tv_end;
+  node_t    *tree = NULL;
+  node_t    *found;
+  rb_tree_t  rb;
+  rb_node_t *rb_found;
+  bp_tree_t  bp;
+  int       *vals, *sorted;
+  int        refcnt;
+  size_t     i, nfound, total;
+  double     insert_secs, find_secs;
+  int        method;
+
+  vals = malloc(nvals * sizeof(int));
+  sorted = malloc(nvals * sizeof(int));
+  if (vals == NULL || sorted == NULL) {
+    printf("error: cannot allocate memory for values\n");
+    return FAIL;
+  }
+  for (i = 0; i < nvals; i++)
+    vals[i] = (int) random();
+
+  printf("%zu random values (times per operation):\n", nvals);
+
+  for (method = 0; method < 4; method++) {
+    nfound = 0;
+    switch (method) {
+      case 0:
+      gettimeofday(&tv_start, NULL);
+      for (i = 0; i < nvals; i++)
+        insert_value(&tree, vals[i]);
+      gettimeofday(&tv_end, NULL);
+      insert_secs = elapsed(&tv_start, &tv_end);
+
+      gettimeofday(&tv_start, NULL);
+      for (i = 0; i < nvals; i++) {
+        find_value(tree, vals[i], &found);
+        nfound += (found != NULL);
+      }
+      gettimeofday(&tv_end, NULL);
+      find_secs = elapsed(&tv_start, &tv_end);
+
+      print_result("unbalanced", nvals, insert_secs, find_secs, nfound);
+      free_tree(tree);
+      break;
+
+      case 1:
+      rb_init(&rb);
+      gettimeofday(&tv_start, NULL);
+      for (i = 0; i < nvals; i++)
+        rb_insert_value(&rb, vals[i]);
+      gettimeofday(&tv_end, NULL);
+      insert_secs = elapsed(&tv_start, &tv_end);
+
+      gettimeofday(&tv_start, NULL);
+      for (i = 0; i < nvals; i++) {
+        rb_find_value(&rb, vals[i], &rb_found);
+        nfound += (rb_found != NULL);
+      }
+      gettimeofday(&tv_end, NULL);
+      find_secs = elapsed(&tv_start, &tv_end);
+
+      print_result("red-black", nvals, insert_secs, find_secs, nfound);
+      rb_free_tree(&rb);
+      break;
+
+      case 2:
+      case 3:
+      bp_init(&bp);
+      if (method == 2) {
+        gettimeofday(&tv_start, NULL);
+        for (i = 0; i < nvals; i++)
+          bp_insert_value(&bp, vals[i]);
+        gettimeofday(&tv_end, NULL);
+      }
+      else {
+        // the sort isn't timed; the input's assumed to come sorted
+        memcpy(sorted, vals, nvals * sizeof(int));
+        qsort(sorted, nvals, sizeof(int), &compare_int);
+        gettimeofday(&tv_start, NULL);
+        bp_bulk_load(&bp, sorted, nvals);
+        gettimeofday(&tv_end, NULL);
+      }
+      insert_secs = elapsed(&tv_start, &tv_end);
+
+      gettimeofday(&tv_start, NULL);
+      for (i = 0; i < nvals; i++) {
+        bp_find_value(&bp, vals[i], &refcnt);
+        nfound += (refcnt > 0);
+      }
+      gettimeofday(&tv_end, NULL);
+      find_secs = elapsed(&tv_start, &tv_end);
+
+      print_result((method == 2) ? "B+tree" : "B+tree bulk load", nvals,
+                   insert_secs, find_secs, nfound);
+
+      total = 0;
+      gettimeofday(&tv_start, NULL);
+      bp_range_scan(&bp, INT_MIN, INT_MAX, &sum_refcnt, &total);
+      gettimeofday(&tv_end, NULL);
+      printf("  %-18s range scan %.1f ns per key, height %d, "
+             "%.1f bytes per key\n", "", elapsed(&tv_start, &tv_end) * 1E9 /
+             bp.nkeys, bp.height, (double) bp_memory(&bp) / bp.nkeys);
+      if (bp_check(&bp) != SUCCESS || total != nvals)
+        printf("\n**** B+tree is broken!\n");
+      bp_free_tree(&bp);
+      break;
+    }
+  }
+
+  free(vals);
+  free(sorted);
+  return SUCCESS;
+}
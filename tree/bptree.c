@@ -0,0 +1,574 @@
+//
+// bptree.c
+//
+// B+tree of int keys, each with a refcnt like node_t's; nodes are a
+// few cache lines, searched with SIMD compares of all their keys at
+// once (AVX2 if the compiler targets it, otherwise SSE2), and the
+// leaves are linked for range scans
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <stdbool.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "common.h"
+#include "bptree.h"
+
+// nodes are allocated cache-line aligned, in whole cache lines
+#define BP_LINE_BYTES 64
+#define BP_NODE_BYTES \
+  ((sizeof(bp_node_t) + BP_LINE_BYTES - 1) / BP_LINE_BYTES * BP_LINE_BYTES)
+
+// bp_bulk_load leaves this many keys free in each node for later
+// inserts
+#define BP_BULK_SLACK (BP_ORDER / 8)
+
+static bp_node_t *
+new_bp_node(bool leaf)
+{
+  bp_node_t *n = aligned_alloc(BP_LINE_BYTES, BP_NODE_BYTES);
+  if (n == NULL)
+    return NULL;
+
+  memset(n, 0, BP_NODE_BYTES);
+  n->leaf = leaf;
+
+  return n;
+}
+
+// bit i is set if keys[i] > value (greater) or keys[i] < value (!greater),
+// for all BP_ORDER keys, used or not (so BP_ORDER can't exceed 32)
+static inline uint32_t
+keys_cmp_mask(const int *keys, int value, bool greater)
+{
+  uint32_t mask = 0;
+  int      i;
+
+#if defined(__AVX2__)
+  __m256i v = _mm256_set1_epi32(value);
+  __m256i k, c;
+
+  for (i = 0; i < BP_ORDER; i += 8) {
+    k = _mm256_load_si256((const __m256i *) &keys[i]);
+    c = greater ? _mm256_cmpgt_epi32(k, v) : _mm256_cmpgt_epi32(v, k);
+    mask |= (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(c)) << i;
+  }
+#elif defined(__SSE2__)
+  __m128i v = _mm_set1_epi32(value);
+  __m128i k, c;
+
+  for (i = 0; i < BP_ORDER; i += 4) {
+    k = _mm_load_si128((const __m128i *) &keys[i]);
+    c = greater ? _mm_cmpgt_epi32(k, v) : _mm_cmpgt_epi32(v, k);
+    mask |= (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(c)) << i;
+  }
+#else
+  for (i = 0; i < BP_ORDER; i++) {
+    if (greater ? keys[i] > value : keys[i] < value)
+      mask |= 1U << i;
+  }
+#endif
+
+  return mask;
+}
+
+// number of the node's keys < value, i.e. where value is or would go
+static inline int
+rank_lt(const bp_node_t *n, int value)
+{
+  uint32_t valid = (n->nkeys == BP_ORDER) ? ~0U : (1U << n->nkeys) - 1;
+
+  return __builtin_popcount(keys_cmp_mask(n->keys, value, false) & valid);
+}
+
+// number of the node's keys <= value, i.e. which child value is under
+static inline int
+rank_le(const bp_node_t *n, int value)
+{
+  uint32_t valid = (n->nkeys == BP_ORDER) ? ~0U : (1U << n->nkeys) - 1;
+
+  return n->nkeys - __builtin_popcount(keys_cmp_mask(n->keys, value, true) & valid);
+}
+
+// initialize an empty tree
+int
+bp_init(bp_tree_t *tree)
+{
+  if (tree == NULL)
+    return FAIL;
+
+  tree->root = NULL;
+  tree->nkeys = 0;
+  tree->nnodes = 0;
+  tree->height = 0;
+
+  return SUCCESS;
+}
+
+static void
+leaf_insert_at(bp_node_t *leaf, int i, int value, int refcnt)
+{
+  memmove(&leaf->keys[i + 1], &leaf->keys[i],
+          (leaf->nkeys - i) * sizeof(int));
+  memmove(&leaf->refcnt[i + 1], &leaf->refcnt[i],
+          (leaf->nkeys - i) * sizeof(int));
+  leaf->keys[i] = value;
+  leaf->refcnt[i] = refcnt;
+  leaf->nkeys++;
+}
+
+// add separator key sep at i, with child (holding the keys >= sep) to
+// the right of it
+static void
+inner_insert_at(bp_node_t *n, int i, int sep, bp_node_t *child)
+{
+  memmove(&n->keys[i + 1], &n->keys[i], (n->nkeys - i) * sizeof(int));
+  memmove(&n->children[i + 2], &n->children[i + 1],
+          (n->nkeys - i) * sizeof(bp_node_t *));
+  n->keys[i] = sep;
+  n->children[i + 1] = child;
+  n->nkeys++;
+}
+
+// split the full inner node n while adding sep and child at i: n keeps
+// the lower half, right gets the upper half, and the middle key is
+// returned to go up a level
+static int
+inner_split(bp_node_t *n, bp_node_t *right, int i, int sep, bp_node_t *child)
+{
+  int        keys[BP_ORDER + 1];
+  bp_node_t *children[BP_ORDER + 2];
+  int        mid = (BP_ORDER + 1) / 2;
+
+  memcpy(keys, n->keys, i * sizeof(int));
+  keys[i] = sep;
+  memcpy(&keys[i + 1], &n->keys[i], (BP_ORDER - i) * sizeof(int));
+
+  memcpy(children, n->children, (i + 1) * sizeof(bp_node_t *));
+  children[i + 1] = child;
+  memcpy(&children[i + 2], &n->children[i + 1],
+         (BP_ORDER - i) * sizeof(bp_node_t *));
+
+  n->nkeys = mid;
+  memcpy(n->keys, keys, mid * sizeof(int));
+  memcpy(n->children, children, (mid + 1) * sizeof(bp_node_t *));
+
+  right->nkeys = BP_ORDER - mid;
+  memcpy(right->keys, &keys[mid + 1], right->nkeys * sizeof(int));
+  memcpy(right->children, &children[mid + 1],
+         (right->nkeys + 1) * sizeof(bp_node_t *));
+
+  return keys[mid];
+}
+
+// insert a value into the tree; if it's already there, increment its
+// refcnt
+int
+bp_insert_value(bp_tree_t *tree, int value)
+{
+  bp_node_t *path[BP_MAX_HEIGHT];
+  int        pos[BP_MAX_HEIGHT];
+  bp_node_t *spare[BP_MAX_HEIGHT + 1];
+  bp_node_t *n, *right, *child;
+  int        depth = 0, d, i, nspare, used = 0, half, sep;
+
+  if (tree == NULL)
+    return FAIL;
+
+  if (tree->root == NULL) {
+    n = new_bp_node(true);
+    if (n == NULL)
+      return FAIL;
+    leaf_insert_at(n, 0, value, 1);
+    tree->root = n;
+    tree->nkeys = 1;
+    tree->nnodes = 1;
+    tree->height = 1;
+    return SUCCESS;
+  }
+
+  // find the leaf, remembering the way down
+  n = tree->root;
+  while (!n->leaf) {
+    i = rank_le(n, value);
+    path[depth] = n;
+    pos[depth++] = i;
+    n = n->children[i];
+  }
+
+  i = rank_lt(n, value);
+  if (i < n->nkeys && n->keys[i] == value) {
+    n->refcnt[i]++;
+    return SUCCESS;
+  }
+
+  if (n->nkeys < BP_ORDER) {
+    leaf_insert_at(n, i, value, 1);
+    tree->nkeys++;
+    return SUCCESS;
+  }
+
+  // the leaf splits, and so does every full node above it (and the
+  // root, if they're all full); get all the new nodes first so a
+  // failed allocation leaves the tree as it was
+  nspare = 1;
+  for (d = depth - 1; d >= 0 && path[d]->nkeys == BP_ORDER; d--)
+    nspare++;
+  if (d < 0)
+    nspare++;
+  for (used = 0; used < nspare; used++) {
+    spare[used] = new_bp_node(used == 0);
+    if (spare[used] == NULL) {
+      while (used-- > 0)
+        free(spare[used]);
+      return FAIL;
+    }
+  }
+  used = 0;
+
+  right = spare[used++];
+  half = BP_ORDER / 2;
+  right->nkeys = BP_ORDER - half;
+  memcpy(right->keys, &n->keys[half], right->nkeys * sizeof(int));
+  memcpy(right->refcnt, &n->refcnt[half], right->nkeys * sizeof(int));
+  n->nkeys = half;
+  right->next = n->next;
+  n->next = right;
+  if (i <= half)
+    leaf_insert_at(n, i, value, 1);
+  else
+    leaf_insert_at(right, i - half, value, 1);
+
+  // push the new separators up
+  sep = right->keys[0];
+  child = right;
+  while (depth > 0) {
+    depth--;
+    n = path[depth];
+    i = pos[depth];
+    if (n->nkeys < BP_ORDER) {
+      inner_insert_at(n, i, sep, child);
+      child = NULL;
+      break;
+    }
+    right = spare[used++];
+    sep = inner_split(n, right, i, sep, child);
+    child = right;
+  }
+
+  // the root split: a new root over the two halves
+  if (child != NULL) {
+    n = spare[used++];
+    n->keys[0] = sep;
+    n->children[0] = tree->root;
+    n->children[1] = child;
+    n->nkeys = 1;
+    tree->root = n;
+    tree->height++;
+  }
+
+  assert(used == nspare);
+  tree->nkeys++;
+  tree->nnodes += nspare;
+
+  return SUCCESS;
+}
+
+// leaf where value is or would go
+static bp_node_t *
+find_leaf(bp_tree_t *tree, int value)
+{
+  bp_node_t *n = tree->root;
+
+  while (!n->leaf)
+    n = n->children[rank_le(n, value)];
+
+  return n;
+}
+
+// find a value in the tree
+//
+// refcnt: *refcnt = times the value has been inserted, 0 if never
+int
+bp_find_value(bp_tree_t *tree, int value, int *refcnt)
+{
+  bp_node_t *leaf;
+  int        i;
+
+  // sanity check of params
+  if (tree == NULL || refcnt == NULL)
+    return FAIL;
+
+  *refcnt = 0;
+  if (tree->root == NULL)
+    return SUCCESS;
+
+  leaf = find_leaf(tree, value);
+  i = rank_lt(leaf, value);
+  if (i < leaf->nkeys && leaf->keys[i] == value)
+    *refcnt = leaf->refcnt[i];
+
+  return SUCCESS;
+}
+
+// call fn for every key in [lo .. hi], in order, following the leaf
+// links
+int
+bp_range_scan(bp_tree_t *tree, int lo, int hi, bp_scan_fn fn, void *arg)
+{
+  bp_node_t *leaf;
+  int        i;
+
+  if (tree == NULL || fn == NULL)
+    return FAIL;
+  if (tree->root == NULL || lo > hi)
+    return SUCCESS;
+
+  leaf = find_leaf(tree, lo);
+  i = rank_lt(leaf, lo);
+  while (leaf != NULL) {
+    for (; i < leaf->nkeys; i++) {
+      if (leaf->keys[i] > hi)
+        return SUCCESS;
+      if (fn(leaf->keys[i], leaf->refcnt[i], arg) != SUCCESS)
+        return SUCCESS;
+    }
+    leaf = leaf->next;
+    i = 0;
+  }
+
+  return SUCCESS;
+}
+
+// free n and everything under it, recursing only as deep as the tree
+static void
+bp_free_sub(bp_node_t *n)
+{
+  int i;
+
+  if (!n->leaf) {
+    for (i = 0; i <= n->nkeys; i++)
+      bp_free_sub(n->children[i]);
+  }
+  free(n);
+}
+
+// build the tree from sorted values[0 .. nvals - 1] (equal values
+// become one key's refcnt), a level at a time from the leaves up,
+// with every node filled to BP_ORDER - BP_BULK_SLACK keys or evenly
+// just under that; the tree must be empty, and is left empty if this
+// fails
+int
+bp_bulk_load(bp_tree_t *tree, const int *values, size_t nvals)
+{
+  bp_node_t **level = NULL, **upper = NULL;
+  int        *mins = NULL, *upper_mins = NULL;
+  bp_node_t  *n;
+  size_t      ndistinct, nnodes, nupper = 0, per, extra, i, j, v, c = 0;
+  int         fill = BP_ORDER - BP_BULK_SLACK;
+
+  if (tree == NULL || (values == NULL && nvals > 0) || tree->root != NULL)
+    return FAIL;
+  if (nvals == 0)
+    return SUCCESS;
+
+  ndistinct = 1;
+  for (v = 1; v < nvals; v++) {
+    if (values[v] < values[v - 1])
+      return FAIL;
+    ndistinct += (values[v] != values[v - 1]);
+  }
+
+  // leaves: per keys each, the first extra of them one more
+  nnodes = (ndistinct + fill - 1) / fill;
+  per = ndistinct / nnodes;
+  extra = ndistinct % nnodes;
+
+  level = malloc(nnodes * sizeof(bp_node_t *));
+  mins = malloc(nnodes * sizeof(int));
+  if (level == NULL || mins == NULL) {
+    nnodes = 0;
+    goto fail;
+  }
+
+  v = 0;
+  for (i = 0; i < nnodes; i++) {
+    n = level[i] = new_bp_node(true);
+    if (n == NULL) {
+      nnodes = i;
+      goto fail;
+    }
+    tree->nnodes++;
+    if (i > 0)
+      level[i - 1]->next = n;
+    mins[i] = values[v];
+    for (j = 0; j < per + (i < extra); j++) {
+      n->keys[j] = values[v];
+      n->refcnt[j] = 0;
+      while (v < nvals && values[v] == n->keys[j]) {
+        n->refcnt[j]++;
+        v++;
+      }
+    }
+    n->nkeys = (int) j;
+  }
+  tree->nkeys = ndistinct;
+  tree->height = 1;
+
+  // inner levels: fill + 1 children each, the separators being the
+  // smallest keys under all but the first
+  while (nnodes > 1) {
+    nupper = (nnodes + fill) / (fill + 1);
+    per = nnodes / nupper;
+    extra = nnodes % nupper;
+
+    c = 0;
+    upper = malloc(nupper * sizeof(bp_node_t *));
+    upper_mins = malloc(nupper * sizeof(int));
+    if (upper == NULL || upper_mins == NULL) {
+      nupper = 0;
+      goto fail;
+    }
+
+    for (i = 0; i < nupper; i++) {
+      n = upper[i] = new_bp_node(false);
+      if (n == NULL) {
+        nupper = i;
+        goto fail;
+      }
+      tree->nnodes++;
+      upper_mins[i] = mins[c];
+      n->children[0] = level[c++];
+      for (j = 1; j < per + (i < extra); j++) {
+        n->keys[j - 1] = mins[c];
+        n->children[j] = level[c++];
+      }
+      n->nkeys = (int) j - 1;
+    }
+
+    free(level);
+    free(mins);
+    level = upper;
+    mins = upper_mins;
+    upper = NULL;
+    upper_mins = NULL;
+    nnodes = nupper;
+    nupper = 0;
+    tree->height++;
+  }
+
+  tree->root = level[0];
+  free(level);
+  free(mins);
+
+  return SUCCESS;
+
+ fail:
+  // every node built so far is under one of upper[0 .. nupper - 1] or
+  // is one of the level[c .. nnodes - 1] they haven't taken yet
+  for (i = 0; i < nupper; i++)
+    bp_free_sub(upper[i]);
+  for (i = c; i < nnodes; i++)
+    bp_free_sub(level[i]);
+  free(upper);
+  free(upper_mins);
+  free(level);
+  free(mins);
+
+  bp_init(tree);
+
+  return FAIL;
+}
+
+// the recursion in this is only as deep as the tree, i.e. a handful
+// of levels
+
+// check the subtree holds keys in [lo .. hi), in order, with all its
+// leaves at the bottom level; *prev is the last leaf seen
+static int
+bp_check_sub(bp_node_t *n, long lo, long hi, int depth, int height,
+             bp_node_t **prev, size_t *nkeys)
+{
+  int i;
+
+  if (n == NULL || n->nkeys < 0 || n->nkeys > BP_ORDER)
+    return FAIL;
+  for (i = 0; i < n->nkeys; i++) {
+    if (n->keys[i] < lo || n->keys[i] >= hi)
+      return FAIL;
+    if (i > 0 && n->keys[i] <= n->keys[i - 1])
+      return FAIL;
+  }
+
+  if (n->leaf) {
+    if (depth != height || n->nkeys == 0)
+      return FAIL;
+    if (*prev != NULL && (*prev)->next != n)
+      return FAIL;
+    for (i = 0; i < n->nkeys; i++) {
+      if (n->refcnt[i] < 1)
+        return FAIL;
+    }
+    *prev = n;
+    *nkeys += n->nkeys;
+    return SUCCESS;
+  }
+
+  for (i = 0; i <= n->nkeys; i++) {
+    if (bp_check_sub(n->children[i], (i == 0) ? lo : n->keys[i - 1],
+                     (i == n->nkeys) ? hi : n->keys[i], depth + 1, height,
+                     prev, nkeys) != SUCCESS)
+      return FAIL;
+  }
+
+  return SUCCESS;
+}
+
+// verify the tree: keys in order within and across nodes, all leaves
+// at the same depth and linked in order, and the key count
+int
+bp_check(bp_tree_t *tree)
+{
+  bp_node_t *prev = NULL;
+  size_t     nkeys = 0;
+
+  if (tree == NULL)
+    return FAIL;
+  if (tree->root == NULL)
+    return (tree->nkeys == 0) ? SUCCESS : FAIL;
+
+  if (bp_check_sub(tree->root, (long) INT32_MIN, (long) INT32_MAX + 1, 1,
+                   tree->height, &prev, &nkeys) != SUCCESS)
+    return FAIL;
+  if (prev->next != NULL || nkeys != tree->nkeys)
+    return FAIL;
+
+  return SUCCESS;
+}
+
+// bytes of memory the tree's nodes take
+size_t
+bp_memory(bp_tree_t *tree)
+{
+  return (tree == NULL) ? 0 : tree->nnodes * BP_NODE_BYTES;
+}
+
+int
+bp_free_tree(bp_tree_t *tree)
+{
+  if (tree == NULL)
+    return FAIL;
+
+  if (tree->root != NULL)
+    bp_free_sub(tree->root);
+
+  return bp_init(tree);
+}
@@ -0,0 +1,64 @@
+//
+// bptree.h
+//
+// header file for the B+tree of int keys
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// most keys in a node: 32 ints are 4 AVX2 or 8 SSE compares
+#define BP_ORDER      32
+// a tree of 4G keys is at most this tall
+#define BP_MAX_HEIGHT 16
+
+// inner nodes: keys[i] is the smallest key under children[i + 1];
+// leaves: keys[i] has been inserted refcnt[i] times, and next is the
+// leaf to the right
+typedef struct _bp_node_ {
+  int                keys[BP_ORDER];
+  int                nkeys;
+  bool               leaf;
+  union {
+    struct _bp_node_ *children[BP_ORDER + 1];
+    struct {
+      int                refcnt[BP_ORDER];
+      struct _bp_node_  *next;
+    };
+  };
+} bp_node_t;
+
+typedef struct {
+  bp_node_t *root;
+  size_t     nkeys;    // distinct keys
+  size_t     nnodes;
+  int        height;   // levels, counting the leaves
+} bp_tree_t;
+
+// called by bp_range_scan() for every key in the range; a return value
+// other than SUCCESS stops the scan
+typedef int (*bp_scan_fn)(int value, int refcnt, void *arg);
+
+extern int bp_init(bp_tree_t *tree);
+
+extern int bp_insert_value(bp_tree_t *tree, int value);
+
+extern int bp_find_value(bp_tree_t *tree, int value, int *refcnt);
+
+extern int bp_range_scan(bp_tree_t *tree, int lo, int hi, bp_scan_fn fn,
+                         void *arg);
+
+extern int bp_bulk_load(bp_tree_t *tree, const int *values, size_t nvals);
+
+extern int bp_check(bp_tree_t *tree);
+
+extern size_t bp_memory(bp_tree_t *tree);
+
+extern int bp_free_tree(bp_tree_t *tree);
+
+#endif /* BPTREE_H */
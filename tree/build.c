@@ -0,0 +1,245 @@
+//
+// build.c
+//
+// building a perfectly balanced tree from sorted values in O(n): the
+// distinct values (with their run lengths as refcnts) go into one array
+// of nodes in value order, and the node in the middle of each range is
+// that range's root; with multithread, every pass is split among
+// threads, the linking by subtrees
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "build.h"
+
+// fewer values than this per thread aren't worth a thread
+#define BUILD_THREAD_NVALS (64 * 1024)
+
+typedef struct {
+  const int *data;
+  size_t     n;
+  size_t     start;     // this thread's slice of data
+  size_t     end;
+  size_t     nruns;     // pass 1: distinct values starting in the slice
+  size_t     offset;    // pass 2: where they go in nodes
+  node_t    *nodes;
+  size_t    *subtrees;  // pass 3: [lo, hi) node ranges to link
+  size_t     nsubtrees;
+  size_t     stride;    // every stride'th subtree is this thread's
+} build_info_t;
+
+static inline bool
+run_starts(const int *data, size_t i)
+{
+  return i == 0 || data[i] != data[i - 1];
+}
+
+static void *
+count_runs(void *arg)
+{
+  build_info_t *info = (build_info_t *) arg;
+  size_t        i;
+
+  info->nruns = 0;
+  for (i = info->start; i < info->end; i++)
+    info->nruns += run_starts(info->data, i);
+
+  return NULL;
+}
+
+// a node for every run starting in the slice; a run that carries on
+// past the slice's end is counted out by this thread alone
+static void *
+fill_nodes(void *arg)
+{
+  build_info_t *info = (build_info_t *) arg;
+  node_t       *n = &info->nodes[info->offset];
+  size_t        i, j;
+
+  for (i = info->start; i < info->end; i = j) {
+    j = i + 1;
+    if (!run_starts(info->data, i))
+      continue;
+    while (j < info->n && info->data[j] == info->data[i])
+      j++;
+    n->value = info->data[i];
+    n->refcnt = (int) (j - i);
+    n++;
+  }
+
+  return NULL;
+}
+
+// link nodes[lo .. hi - 1] into a balanced subtree and return its root;
+// the recursion is only log2(hi - lo) deep
+static node_t *
+link_nodes(node_t *nodes, size_t lo, size_t hi)
+{
+  size_t mid;
+
+  if (lo >= hi)
+    return NULL;
+
+  mid = lo + (hi - lo) / 2;
+  nodes[mid].left = link_nodes(nodes, lo, mid);
+  nodes[mid].right = link_nodes(nodes, mid + 1, hi);
+
+  return &nodes[mid];
+}
+
+// link the top depth levels of nodes[lo .. hi - 1] here, and leave the
+// subtrees under them, in subtrees[], to the threads; a subtree's root
+// is known before it's linked, so its parent can point at it already
+static node_t *
+link_top(node_t *nodes, size_t lo, size_t hi, int depth, size_t *subtrees,
+         size_t *nsubtrees)
+{
+  size_t mid;
+
+  if (lo >= hi)
+    return NULL;
+
+  mid = lo + (hi - lo) / 2;
+  if (depth == 0) {
+    subtrees[2 * *nsubtrees] = lo;
+    subtrees[2 * *nsubtrees + 1] = hi;
+    (*nsubtrees)++;
+    return &nodes[mid];
+  }
+
+  nodes[mid].left = link_top(nodes, lo, mid, depth - 1, subtrees, nsubtrees);
+  nodes[mid].right = link_top(nodes, mid + 1, hi, depth - 1, subtrees,
+                              nsubtrees);
+
+  return &nodes[mid];
+}
+
+static void *
+link_subtrees(void *arg)
+{
+  build_info_t *info = (build_info_t *) arg;
+  size_t        s;
+
+  for (s = info->start; s < info->nsubtrees; s += info->stride)
+    link_nodes(info->nodes, info->subtrees[2 * s], info->subtrees[2 * s + 1]);
+
+  return NULL;
+}
+
+// run fn on every info[], on threads 1 .. nthreads - 1 and this one;
+// any that can't get a thread run here too
+static void
+run_threads(void *(*fn)(void *), build_info_t *info, size_t nthreads)
+{
+  pthread_t *threads;
+  size_t     t, started = 1;
+
+  threads = malloc(nthreads * sizeof(pthread_t));
+  if (threads != NULL) {
+    for (; started < nthreads; started++) {
+      if (pthread_create(&threads[started], NULL, fn, &info[started]) != 0)
+        break;
+    }
+  }
+  fn(&info[0]);
+  for (t = started; t < nthreads; t++)
+    fn(&info[t]);
+  for (t = 1; t < started; t++)
+    pthread_join(threads[t], NULL);
+
+  free(threads);
+}
+
+// build a balanced tree from sorted data[0 .. n - 1], equal values
+// becoming one node's refcnt
+//
+// tree: *tree = the root, NULL if n is 0
+// nodes: *nodes = the one block holding every node, in value order;
+// free the tree with free(*nodes), not free_tree()
+int
+tree_build_from_sorted(node_t **tree, node_t **nodes, const int *data,
+                       size_t n, bool multithread)
+{
+  build_info_t *info;
+  size_t        nthreads = 1, ndistinct, per, t, nsubtrees = 0;
+  size_t       *subtrees = NULL;
+  int           depth = 0;
+
+  // sanity check of params
+  if (tree == NULL || nodes == NULL || (data == NULL && n > 0))
+    return FAIL;
+
+  *tree = NULL;
+  *nodes = NULL;
+  if (n == 0)
+    return SUCCESS;
+
+  if (multithread) {
+    nthreads = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > n / BUILD_THREAD_NVALS)
+      nthreads = n / BUILD_THREAD_NVALS;
+    if (nthreads < 1)
+      nthreads = 1;
+  }
+
+  info = malloc(nthreads * sizeof(build_info_t));
+  if (info == NULL)
+    return FAIL;
+
+  per = n / nthreads;
+  for (t = 0; t < nthreads; t++) {
+    info[t].data = data;
+    info[t].n = n;
+    info[t].start = t * per;
+    info[t].end = (t == nthreads - 1) ? n : (t + 1) * per;
+  }
+
+  // pass 1: count the distinct values, and where each slice's go
+  run_threads(&count_runs, info, nthreads);
+  ndistinct = 0;
+  for (t = 0; t < nthreads; t++) {
+    info[t].offset = ndistinct;
+    ndistinct += info[t].nruns;
+  }
+
+  *nodes = malloc(ndistinct * sizeof(node_t));
+  if (*nodes == NULL) {
+    free(info);
+    return FAIL;
+  }
+
+  // pass 2: fill in the values and refcnts
+  for (t = 0; t < nthreads; t++)
+    info[t].nodes = *nodes;
+  run_threads(&fill_nodes, info, nthreads);
+
+  // pass 3: link them; a few subtrees per thread evens out the work
+  if (nthreads > 1) {
+    while (((size_t) 1 << depth) < 4 * nthreads)
+      depth++;
+    subtrees = malloc(((size_t) 2 << depth) * sizeof(size_t));
+  }
+  if (subtrees == NULL) {
+    *tree = link_nodes(*nodes, 0, ndistinct);
+  }
+  else {
+    *tree = link_top(*nodes, 0, ndistinct, depth, subtrees, &nsubtrees);
+    for (t = 0; t < nthreads; t++) {
+      info[t].subtrees = subtrees;
+      info[t].nsubtrees = nsubtrees;
+      info[t].start = t;
+      info[t].stride = nthreads;
+    }
+    run_threads(&link_subtrees, info, nthreads);
+    free(subtrees);
+  }
+
+  free(info);
+  return SUCCESS;
+}
@@ -0,0 +1,20 @@
+//
+// build.h
+//
+// header file for building a balanced tree from sorted values
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef BUILD_H
+#define BUILD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "common.h"
+
+extern int tree_build_from_sorted(node_t **tree, node_t **nodes,
+                                  const int *data, size_t n,
+                                  bool multithread);
+
+#endif /* BUILD_H */
@@ -0,0 +1,142 @@
+//
+// buildbench.c
+//
+// benchmarking tree_build_from_sorted, on one thread and on all of
+// them, against building the tree by insert_value, from random and
+// from sorted values
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "iter.h"
+#include "build.h"
+#include "bench.h"
+
+// sorted input makes insert_value build a list, and n inserts take
+// O(n^2), so it only gets this many
+#define MAX_INSERT_SORTED 32768
+
+static int
+compare_int(const void *left, const void *right)
+{
+  int l = *(const int *) left;
+  int r = *(const int *) right;
+
+  return (l > r) - (l < r);
+}
+
+// time finding every value, and check the tree in order against the
+// sorted values
+static void
+find_and_check(const char *name, node_t *tree, const int *vals,
+               const int *sorted, size_t nvals, double build_secs)
+{
+  struct timeval tv_start, tv_end;
+  tree_iter_t it;
+  node_t *n;
+  size_t  i, nfound = 0;
+  bool    ok = true;
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++) {
+    find_value(tree, vals[i], &n);
+    nfound += (n != NULL);
+  }
+  gettimeofday(&tv_end, NULL);
+
+  printf("  %-22s build %8.1f ns per value, find %8.1f ns\n", name,
+         build_secs * 1E9 / nvals, elapsed(&tv_start, &tv_end) * 1E9 / nvals);
+
+  i = 0;
+  tree_iter_init(&it, tree, TREE_INORDER);
+  while (ok && tree_iter_next(&it, &n) == SUCCESS && n != NULL) {
+    ok = (i + n->refcnt <= nvals && sorted[i] == n->value &&
+          sorted[i + n->refcnt - 1] == n->value);
+    i += n->refcnt;
+  }
+  tree_iter_free(&it);
+  if (!ok || i != nvals || nfound != nvals)
+    printf("\n**** %s lost values!\n", name);
+}
+
+static void
+bench_input(const char *input, int *vals, int *sorted, size_t nvals,
+            size_t ninserts)
+{
+  struct timeval tv_start, tv_end;
+  node_t *tree = NULL;
+  node_t *nodes;
+  char    name[64];
+  size_t  i;
+  int     mt;
+
+  printf("%zu %s values:\n", nvals, input);
+
+  for (mt = 0; mt < 2; mt++) {
+    gettimeofday(&tv_start, NULL);
+    tree_build_from_sorted(&tree, &nodes, sorted, nvals, mt);
+    gettimeofday(&tv_end, NULL);
+    find_and_check(mt ? "build (multithread)" : "build", tree, vals, sorted,
+                   nvals, elapsed(&tv_start, &tv_end));
+    free(nodes);
+    tree = NULL;
+  }
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < ninserts; i++)
+    insert_value(&tree, vals[i]);
+  gettimeofday(&tv_end, NULL);
+  snprintf(name, sizeof(name), "insert_value%s",
+           (ninserts < nvals) ? " (first)" : "");
+  if (ninserts < nvals) {
+    // just the build: the tree doesn't hold everything to find
+    printf("  %-22s build %8.1f ns per value (%zu values)\n", name,
+           elapsed(&tv_start, &tv_end) * 1E9 / ninserts, ninserts);
+  }
+  else {
+    find_and_check(name, tree, vals, sorted, nvals,
+                   elapsed(&tv_start, &tv_end));
+  }
+  free_tree(tree);
+  // after millions of small frees, malloc's next big allocation stops to
+  // consolidate them; do that here rather than in the next build
+  malloc_trim(0);
+}
+
+int
+build_bench(size_t nvals)
+{
+  int   *vals, *sorted;
+  size_t i;
+
+  vals = malloc(nvals * sizeof(int));
+  sorted = malloc(nvals * sizeof(int));
+  if (vals == NULL || sorted == NULL) {
+    printf("error: cannot allocate memory for values\n");
+    return FAIL;
+  }
+
+  // the builds get their input sorted, as it would come from the sort
+  // library, so the sort isn't timed
+  for (i = 0; i < nvals; i++)
+    vals[i] = (int) random();
+  memcpy(sorted, vals, nvals * sizeof(int));
+  qsort(sorted, nvals, sizeof(int), &compare_int);
+
+  bench_input("random", vals, sorted, nvals, nvals);
+  printf("\n");
+  bench_input("sorted", sorted, sorted, nvals,
+              (nvals < MAX_INSERT_SORTED) ? nvals : MAX_INSERT_SORTED);
+
+  free(vals);
+  free(sorted);
+  return SUCCESS;
+}
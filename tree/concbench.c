@@ -0,0 +1,266 @@
+//
+// concbench.c
+//
+// benchmarking the concurrent tree on mixes of inserts, finds and
+// deletes from 1 thread up to ncpus, against tree.c on 1
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "conctree.h"
+#include "bench.h"
+
+// percentages of each operation; the rest are finds
+typedef struct {
+  const char *name;
+  int         inserts;
+  int         deletes;
+} mix_t;
+
+static const mix_t mixes[] = {
+  { "100% insert",                 100,  0 },
+  { "50% insert, 50% find",         50,  0 },
+  { "10% insert, 90% find",         10,  0 },
+  { "10% ins, 80% find, 10% del",   10, 10 },
+};
+
+typedef struct {
+  ct_tree_t   *tree;
+  node_t     **plain;    // tree.c's tree, instead of tree
+  const mix_t *mix;
+  size_t       nops;
+  size_t       range;    // values are in [0 .. range - 1]
+  uint64_t     seed;
+  size_t       nfound;
+  int         *log;      // successful inserts (value) and deletes (~value)
+  size_t       nlogged;
+  bool         ok;       // got a slot in the tree
+} conc_info_t;
+
+// random() takes a lock, so each thread has its own xorshift
+static inline uint64_t
+next_random(uint64_t *x)
+{
+  *x ^= *x << 13;
+  *x ^= *x >> 7;
+  *x ^= *x << 17;
+  return *x;
+}
+
+static void *
+conc_thread(void *arg)
+{
+  conc_info_t *info = (conc_info_t *) arg;
+  ct_thread_t  th;
+  node_t      *found;
+  uint64_t     x = info->seed, r;
+  size_t       i;
+  int          value, op, refcnt;
+
+  info->nfound = 0;
+  info->nlogged = 0;
+  info->ok = (info->plain != NULL || ct_thread_init(info->tree, &th) == SUCCESS);
+  if (!info->ok)
+    return NULL;
+
+  for (i = 0; i < info->nops; i++) {
+    r = next_random(&x);
+    value = (int) ((r >> 8) % info->range);
+    op = (int) (r % 100);
+
+    if (info->plain != NULL) {
+      if (op < info->mix->inserts) {
+        if (insert_value(info->plain, value) == SUCCESS)
+          info->log[info->nlogged++] = value;
+      }
+      else {
+        find_value(*info->plain, value, &found);
+        info->nfound += (found != NULL);
+      }
+    }
+    else if (op < info->mix->inserts) {
+      if (ct_insert_value(&th, value) == SUCCESS)
+        info->log[info->nlogged++] = value;
+    }
+    else if (op < info->mix->inserts + info->mix->deletes) {
+      if (ct_delete_value(&th, value) == SUCCESS)
+        info->log[info->nlogged++] = ~value;
+    }
+    else {
+      ct_find_value(&th, value, &refcnt);
+      info->nfound += (refcnt > 0);
+    }
+  }
+
+  if (info->plain == NULL)
+    ct_thread_done(&th);
+  return NULL;
+}
+
+// compare every value's refcnt in the tree with expected[]: the
+// prefill's inserts, plus the ones the threads logged, less their
+// deletes; returns the number that differ
+static size_t
+check_refcnts(ct_tree_t *tree, node_t *plain, conc_info_t *info, size_t n,
+              int *expected, size_t range)
+{
+  ct_thread_t th;
+  node_t     *found;
+  size_t      t, i, mismatches = 0;
+  int         refcnt;
+
+  for (t = 0; t < n; t++) {
+    for (i = 0; i < info[t].nlogged; i++) {
+      if (info[t].log[i] >= 0)
+        expected[info[t].log[i]]++;
+      else
+        expected[~info[t].log[i]]--;
+    }
+  }
+
+  if (plain == NULL && ct_thread_init(tree, &th) != SUCCESS)
+    return range;
+  for (i = 0; i < range; i++) {
+    if (plain != NULL) {
+      find_value(plain, (int) i, &found);
+      refcnt = (found != NULL) ? found->refcnt : 0;
+    }
+    else {
+      ct_find_value(&th, (int) i, &refcnt);
+    }
+    mismatches += (refcnt != expected[i]);
+  }
+  if (plain == NULL)
+    ct_thread_done(&th);
+
+  return mismatches;
+}
+
+// nops operations of the mix on nthreads threads, on a tree prefilled
+// with nvals / 2 values; or on tree.c's tree if nthreads is 0. *ok is
+// cleared if a thread didn't get a slot or the refcnts are wrong
+static double
+bench_mix(const mix_t *mix, size_t nthreads, size_t nvals, size_t nops,
+          bool *ok)
+{
+  struct timeval tv_start, tv_end;
+  conc_info_t   *info;
+  pthread_t     *threads;
+  ct_tree_t      tree;
+  ct_thread_t    th;
+  node_t        *plain = NULL;
+  int           *expected, *logs;
+  size_t         t, i, n = (nthreads > 0) ? nthreads : 1;
+  uint64_t       x = 88172645463325252ULL;
+  int            rc, value;
+
+  info = malloc(n * sizeof(conc_info_t));
+  threads = malloc(n * sizeof(pthread_t));
+  expected = calloc(nvals, sizeof(int));
+  logs = malloc((nops / n * n + 1) * sizeof(int));
+  assert(info != NULL && threads != NULL && expected != NULL && logs != NULL);
+
+  ct_init(&tree);
+  ct_thread_init(&tree, &th);
+  for (i = 0; i < nvals / 2; i++) {
+    value = (int) ((next_random(&x) >> 8) % nvals);
+    if (nthreads == 0)
+      insert_value(&plain, value);
+    else
+      ct_insert_value(&th, value);
+    expected[value]++;
+  }
+  ct_thread_done(&th);
+
+  for (t = 0; t < n; t++) {
+    info[t].tree = &tree;
+    info[t].plain = (nthreads == 0) ? &plain : NULL;
+    info[t].mix = mix;
+    info[t].nops = nops / n;
+    info[t].range = nvals;
+    info[t].seed = 0x9E3779B97F4A7C15ULL * (t + 1);
+    info[t].log = &logs[t * (nops / n)];
+  }
+
+  gettimeofday(&tv_start, NULL);
+  for (t = 0; t < n; t++) {
+    rc = pthread_create(&threads[t], NULL, &conc_thread, &info[t]);
+    assert(rc == 0);
+  }
+  for (t = 0; t < n; t++)
+    pthread_join(threads[t], NULL);
+  gettimeofday(&tv_end, NULL);
+
+  for (t = 0; t < n; t++)
+    *ok = *ok && info[t].ok;
+  if (check_refcnts(&tree, plain, info, n, expected, nvals) != 0)
+    *ok = false;
+
+  ct_free_tree(&tree);
+  free_tree(plain);
+  free(info);
+  free(threads);
+  free(expected);
+  free(logs);
+
+  return (nops / n * n) / elapsed(&tv_start, &tv_end) / 1E6;
+}
+
+// 1, 2, 4 .. threads, and last ncpus
+static size_t
+next_nthreads(size_t nthreads, size_t ncpus)
+{
+  return (2 * nthreads < ncpus) ? 2 * nthreads : ncpus;
+}
+
+int
+conc_bench(size_t nvals)
+{
+  size_t ncpus = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+  size_t nthreads, m;
+  bool   ok = true;
+
+  // every thread needs one of the tree's slots
+  if (ncpus > CT_MAX_THREADS)
+    ncpus = CT_MAX_THREADS;
+
+  printf("%zu operations on a tree of up to %zu values, M ops/s:\n",
+         nvals, nvals);
+  printf("%-28s %8s", "", "tree.c");
+  for (nthreads = 1; ; nthreads = next_nthreads(nthreads, ncpus)) {
+    printf(" %4zu thr", nthreads);
+    if (nthreads == ncpus)
+      break;
+  }
+  printf("\n");
+
+  for (m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+    printf("%-28s", mixes[m].name);
+    // tree.c has no delete
+    if (mixes[m].deletes == 0)
+      printf(" %8.2f", bench_mix(&mixes[m], 0, nvals, nvals, &ok));
+    else
+      printf(" %8s", "-");
+    for (nthreads = 1; ; nthreads = next_nthreads(nthreads, ncpus)) {
+      printf(" %8.2f", bench_mix(&mixes[m], nthreads, nvals, nvals, &ok));
+      fflush(stdout);
+      if (nthreads == ncpus)
+        break;
+    }
+    printf("\n");
+  }
+
+  if (!ok)
+    printf("\n**** refcnts don't match the inserts and deletes!\n");
+
+  return SUCCESS;
+}
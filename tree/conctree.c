@@ -0,0 +1,477 @@
+//
+// conctree.c
+//
+// the unbalanced tree of tree.c for many threads at once:
+//
+// finds take no locks, and just follow the (atomically loaded) links
+//
+// inserts take no locks either to find a value's place; a value that's
+// there already just has its refcnt atomically incremented, and a new
+// node is linked in under its parent's lock, after checking that the
+// link's still empty
+//
+// deletes decrement the refcnt; a node at 0 is left in place (an insert
+// revives it), unless it's a leaf, in which case it's unlinked under
+// its parent's and its own locks, and so on up while the parent's a
+// leaf at 0 too
+//
+// an unlinked node may still be being looked at by a find or insert
+// that got to it before, so it's only freed by epoch-based reclamation:
+// every operation announces the global epoch it started in, the epoch
+// only moves on when every thread in an operation has announced the
+// current one, and a node unlinked in epoch e is freed once the epoch
+// gets to e + 2, when no operation that could have seen it is left
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "common.h"
+#include "conctree.h"
+
+// spins on a node lock before yielding the cpu to whoever holds it
+#define CT_SPINS          100
+// retired nodes between attempts to move the epoch on
+#define CT_ADVANCE_NNODES 64
+
+#define LOAD(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define CAS(p, oldp, v) \
+  __atomic_compare_exchange_n((p), (oldp), (v), false, __ATOMIC_ACQ_REL, \
+                              __ATOMIC_ACQUIRE)
+
+static inline void
+cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static void
+node_lock(ct_node_t *n)
+{
+  int spins = 0;
+
+  while (__atomic_test_and_set(&n->lock, __ATOMIC_ACQUIRE)) {
+    while (__atomic_load_n(&n->lock, __ATOMIC_RELAXED)) {
+      if (++spins < CT_SPINS) {
+        cpu_relax();
+      }
+      else {
+        sched_yield();
+        spins = 0;
+      }
+    }
+  }
+}
+
+static void
+node_unlock(ct_node_t *n)
+{
+  __atomic_clear(&n->lock, __ATOMIC_RELEASE);
+}
+
+static ct_node_t *
+new_ct_node(int value)
+{
+  ct_node_t *n = malloc(sizeof(ct_node_t));
+  if (n == NULL)
+    return NULL;
+
+  n->value = value;
+  n->refcnt = 1;
+  n->left = NULL;
+  n->right = NULL;
+  n->next = NULL;
+  n->lock = 0;
+
+  return n;
+}
+
+static void
+free_list(ct_node_t *n)
+{
+  ct_node_t *next;
+
+  for (; n != NULL; n = next) {
+    next = n->next;
+    free(n);
+  }
+}
+
+// announce the current epoch; if it moves on meanwhile, announce again
+// (an old epoch would only hold it back, but there's no need)
+static void
+epoch_enter(ct_thread_t *th)
+{
+  ct_epoch_t *e = &th->tree->threads[th->slot];
+  uint64_t    epoch = LOAD(&th->tree->epoch);
+
+  for (;;) {
+    __atomic_store_n(&e->epoch, epoch, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->active, true, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&th->tree->epoch, __ATOMIC_SEQ_CST) == epoch)
+      break;
+    epoch = LOAD(&th->tree->epoch);
+  }
+}
+
+static void
+epoch_exit(ct_thread_t *th)
+{
+  STORE(&th->tree->threads[th->slot].active, false);
+}
+
+// move the epoch on if every active thread has caught up with it
+static void
+epoch_advance(ct_tree_t *tree)
+{
+  uint64_t epoch = __atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST);
+  int      t;
+
+  for (t = 0; t < CT_MAX_THREADS; t++) {
+    if (LOAD(&tree->threads[t].in_use) &&
+        __atomic_load_n(&tree->threads[t].active, __ATOMIC_SEQ_CST) &&
+        LOAD(&tree->threads[t].epoch) != epoch)
+      return;
+  }
+
+  CAS(&tree->epoch, &epoch, epoch + 1);
+}
+
+// free the retired lists that are 2 epochs old
+static void
+reclaim(ct_thread_t *th)
+{
+  uint64_t epoch = LOAD(&th->tree->epoch);
+  int      i;
+
+  for (i = 0; i < 3; i++) {
+    if (th->retired[i] != NULL && th->retired_epoch[i] + 2 <= epoch) {
+      free_list(th->retired[i]);
+      th->retired[i] = NULL;
+    }
+  }
+}
+
+// n has been unlinked: free it once no one can be looking at it
+static void
+retire(ct_thread_t *th, ct_node_t *n)
+{
+  uint64_t epoch = LOAD(&th->tree->epoch);
+  int      i = epoch % 3;
+
+  // a list in this slot is from epoch - 3 or before
+  if (th->retired[i] != NULL && th->retired_epoch[i] != epoch) {
+    free_list(th->retired[i]);
+    th->retired[i] = NULL;
+  }
+  th->retired_epoch[i] = epoch;
+  n->next = th->retired[i];
+  th->retired[i] = n;
+
+  if (++th->nretired % CT_ADVANCE_NNODES == 0) {
+    epoch_advance(th->tree);
+    reclaim(th);
+  }
+}
+
+// initialize an empty tree
+int
+ct_init(ct_tree_t *tree)
+{
+  if (tree == NULL)
+    return FAIL;
+
+  memset(tree, 0, sizeof(ct_tree_t));
+  pthread_mutex_init(&tree->lock, NULL);
+
+  return SUCCESS;
+}
+
+// claim an epoch slot for the calling thread; every thread needs its
+// own ct_thread_t to use the tree
+int
+ct_thread_init(ct_tree_t *tree, ct_thread_t *th)
+{
+  int t;
+
+  if (tree == NULL || th == NULL)
+    return FAIL;
+
+  memset(th, 0, sizeof(ct_thread_t));
+  th->tree = tree;
+  th->slot = -1;
+
+  pthread_mutex_lock(&tree->lock);
+  for (t = 0; t < CT_MAX_THREADS; t++) {
+    if (!tree->threads[t].in_use) {
+      tree->threads[t].active = false;
+      STORE(&tree->threads[t].in_use, true);
+      th->slot = t;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&tree->lock);
+
+  return (th->slot < 0) ? FAIL : SUCCESS;
+}
+
+// give up the thread's slot; what it's retired is left to ct_free_tree
+int
+ct_thread_done(ct_thread_t *th)
+{
+  ct_tree_t *tree;
+  ct_node_t *n;
+  int        i;
+
+  if (th == NULL || th->tree == NULL || th->slot < 0)
+    return FAIL;
+
+  tree = th->tree;
+  reclaim(th);
+
+  pthread_mutex_lock(&tree->lock);
+  for (i = 0; i < 3; i++) {
+    while ((n = th->retired[i]) != NULL) {
+      th->retired[i] = n->next;
+      n->next = tree->orphans;
+      tree->orphans = n;
+    }
+  }
+  STORE(&tree->threads[th->slot].in_use, false);
+  pthread_mutex_unlock(&tree->lock);
+
+  th->slot = -1;
+  return SUCCESS;
+}
+
+// insert a value into the tree; if it's already there, atomically
+// increment its refcnt
+int
+ct_insert_value(ct_thread_t *th, int value)
+{
+  ct_tree_t  *tree;
+  ct_node_t **link;
+  ct_node_t  *parent, *n, *new = NULL;
+  int         refcnt;
+  int         ret = SUCCESS;
+
+  if (th == NULL || th->slot < 0)
+    return FAIL;
+
+  tree = th->tree;
+  epoch_enter(th);
+
+ restart:
+  parent = NULL;
+  link = &tree->root;
+  n = LOAD(link);
+  for (;;) {
+    if (n == NULL) {
+      if (new == NULL && (new = new_ct_node(value)) == NULL) {
+        ret = FAIL;
+        break;
+      }
+      if (parent == NULL) {
+        if (CAS(&tree->root, &n, new)) {
+          new = NULL;
+          break;
+        }
+        // someone else got there first: go on down from what they put
+        continue;
+      }
+
+      node_lock(parent);
+      if (LOAD(&parent->refcnt) == CT_UNLINKED) {
+        // parent was unlinked, so this empty link is a dead end
+        node_unlock(parent);
+        goto restart;
+      }
+      n = LOAD(link);
+      if (n == NULL)
+        STORE(link, new);
+      node_unlock(parent);
+      if (n == NULL) {
+        new = NULL;
+        break;
+      }
+      continue;
+    }
+
+    if (value == n->value) {
+      refcnt = LOAD(&n->refcnt);
+      do {
+        if (refcnt == CT_UNLINKED)
+          goto restart;
+      } while (!CAS(&n->refcnt, &refcnt, refcnt + 1));
+      break;
+    }
+
+    parent = n;
+    link = (value < n->value) ? &n->left : &n->right;
+    n = LOAD(link);
+  }
+
+  epoch_exit(th);
+  // allocated, but someone else linked in value first
+  free(new);
+
+  return ret;
+}
+
+// find a value in the tree
+//
+// refcnt: *refcnt = times value has been inserted (less the deletes),
+// 0 if it's not there
+int
+ct_find_value(ct_thread_t *th, int value, int *refcnt)
+{
+  ct_node_t *n;
+  int        r = 0;
+
+  // sanity check of params
+  if (th == NULL || th->slot < 0 || refcnt == NULL)
+    return FAIL;
+
+  epoch_enter(th);
+  do {
+    r = 0;
+    n = LOAD(&th->tree->root);
+    while (n != NULL) {
+      if (n->value == value) {
+        r = LOAD(&n->refcnt);
+        break;
+      }
+      n = (value < n->value) ? LOAD(&n->left) : LOAD(&n->right);
+    }
+    // unlinked since it was found: value may have been put back since
+  } while (r == CT_UNLINKED);
+  epoch_exit(th);
+
+  *refcnt = (r > 0) ? r : 0;
+
+  return SUCCESS;
+}
+
+// unlink the node holding value if it's a leaf at refcnt 0, and then
+// its parent if that's left a leaf at 0; called in an operation
+static void
+try_unlink(ct_thread_t *th, int value)
+{
+  ct_tree_t  *tree = th->tree;
+  ct_node_t **link;
+  ct_node_t  *parent, *n;
+  int         zero;
+  bool        unlinked;
+
+  for (;;) {
+    parent = NULL;
+    link = &tree->root;
+    n = LOAD(link);
+    while (n != NULL && n->value != value) {
+      parent = n;
+      link = (value < n->value) ? &n->left : &n->right;
+      n = LOAD(link);
+    }
+    if (n == NULL)
+      return;
+
+    // always parent first, so no two threads can deadlock
+    if (parent != NULL)
+      node_lock(parent);
+    node_lock(n);
+    zero = 0;
+    unlinked =
+      (parent == NULL || LOAD(&parent->refcnt) != CT_UNLINKED) &&
+      LOAD(link) == n &&
+      LOAD(&n->left) == NULL && LOAD(&n->right) == NULL &&
+      CAS(&n->refcnt, &zero, CT_UNLINKED);
+    if (unlinked)
+      STORE(link, NULL);
+    node_unlock(n);
+    if (parent != NULL)
+      node_unlock(parent);
+
+    if (!unlinked)
+      return;
+    retire(th, n);
+
+    // the parent may be a leaf at 0 now
+    if (parent == NULL || LOAD(&parent->refcnt) != 0)
+      return;
+    value = parent->value;
+  }
+}
+
+// delete one reference to a value; fails if the value isn't in the tree
+int
+ct_delete_value(ct_thread_t *th, int value)
+{
+  ct_node_t *n;
+  int        refcnt;
+  int        ret = FAIL;
+
+  if (th == NULL || th->slot < 0)
+    return FAIL;
+
+  epoch_enter(th);
+  do {
+    refcnt = 0;
+    n = LOAD(&th->tree->root);
+    while (n != NULL && n->value != value)
+      n = (value < n->value) ? LOAD(&n->left) : LOAD(&n->right);
+    if (n != NULL) {
+      refcnt = LOAD(&n->refcnt);
+      while (refcnt > 0 && !CAS(&n->refcnt, &refcnt, refcnt - 1))
+        ;
+    }
+    // as in ct_find_value
+  } while (refcnt == CT_UNLINKED);
+
+  if (n != NULL) {
+    if (refcnt > 0) {
+      ret = SUCCESS;
+      if (refcnt == 1)
+        try_unlink(th, value);
+    }
+  }
+  epoch_exit(th);
+
+  return ret;
+}
+
+// free the tree and everything retired; no thread may be using it
+int
+ct_free_tree(ct_tree_t *tree)
+{
+  ct_node_t *n, *tmp;
+
+  if (tree == NULL)
+    return FAIL;
+
+  // flatten it by rotation as free_tree() does
+  n = tree->root;
+  while (n != NULL) {
+    if (n->left != NULL) {
+      tmp = n->left;
+      n->left = tmp->right;
+      tmp->right = n;
+      n = tmp;
+    }
+    else {
+      tmp = n->right;
+      free(n);
+      n = tmp;
+    }
+  }
+  free_list(tree->orphans);
+
+  pthread_mutex_destroy(&tree->lock);
+  return ct_init(tree);
+}
@@ -0,0 +1,74 @@
+//
+// conctree.h
+//
+// header file for the concurrent unbalanced tree
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef CONCTREE_H
+#define CONCTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// most threads using a tree at once
+#define CT_MAX_THREADS 128
+
+// refcnt 0: every reference deleted, but still linked (and revived by
+// the next insert); CT_UNLINKED: being or been unlinked, look again
+#define CT_UNLINKED (-1)
+
+typedef struct _ct_node_ {
+  int                value;
+  int                refcnt;   // atomic
+  struct _ct_node_  *left;     // atomic
+  struct _ct_node_  *right;    // atomic
+  struct _ct_node_  *next;     // on a retired list
+  uint8_t            lock;     // taken to change left or right
+} ct_node_t;
+
+// one per thread slot, on its own cache line
+typedef struct {
+  uint64_t epoch;      // the global epoch this thread's operating in
+  bool     active;     // in an operation
+  bool     in_use;     // slot claimed by a ct_thread_t
+  char     pad[64 - sizeof(uint64_t) - 2 * sizeof(bool)];
+} ct_epoch_t;
+
+typedef struct {
+  ct_node_t      *root;     // atomic
+  uint64_t        epoch;    // global epoch, atomic
+  ct_epoch_t      threads[CT_MAX_THREADS];
+  ct_node_t      *orphans;  // retired by threads that have finished
+  pthread_mutex_t lock;     // for orphans and claiming slots
+} ct_tree_t;
+
+// a thread's handle on the tree: its epoch slot, and the nodes it's
+// unlinked, by the epoch they were unlinked in, to be freed once no
+// thread can still be looking at them
+typedef struct {
+  ct_tree_t *tree;
+  int        slot;
+  ct_node_t *retired[3];
+  uint64_t   retired_epoch[3];
+  size_t     nretired;
+} ct_thread_t;
+
+extern int ct_init(ct_tree_t *tree);
+
+extern int ct_thread_init(ct_tree_t *tree, ct_thread_t *th);
+
+extern int ct_thread_done(ct_thread_t *th);
+
+extern int ct_insert_value(ct_thread_t *th, int value);
+
+extern int ct_find_value(ct_thread_t *th, int value, int *refcnt);
+
+extern int ct_delete_value(ct_thread_t *th, int value);
+
+extern int ct_free_tree(ct_tree_t *tree);
+
+#endif /* CONCTREE_H */
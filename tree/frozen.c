@@ -0,0 +1,329 @@
+//
+// frozen.c
+//
+// freezing the tree (or a sorted array) into an implicit layout for
+// read-mostly lookups: no pointers, just the values in one array in
+// search order, either
+//
+// Eytzinger: breadth first, node k's children at 2k and 2k + 1, so the
+// 16 descendants 4 levels down are the one cache line at 16k, which is
+// prefetched every step, and the search is a branch free loop
+//
+// van Emde Boas: the top half of the levels first, then each subtree
+// hanging off them, recursively, so a search crosses about
+// log2(n) / log2(B) blocks for any block size B, cache line or page;
+// children are found by the per-depth tables of Brodal, Fagerberg and
+// Jacob
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "iter.h"
+#include "frozen.h"
+
+#define FROZEN_ALIGN 64
+
+// cache aligned, so keys[16k .. 16k + 15] is one line
+static int *
+alloc_slots(size_t nslots)
+{
+  size_t bytes = nslots * sizeof(int);
+
+  bytes = (bytes + FROZEN_ALIGN - 1) & ~(size_t) (FROZEN_ALIGN - 1);
+  return aligned_alloc(FROZEN_ALIGN, bytes);
+}
+
+// slot k of the Eytzinger layout, and its subtree, in order
+static void
+eytzinger_fill(frozen_t *f, const int *vals, const int *cnts, size_t *next,
+               size_t k)
+{
+  if (k > f->n)
+    return;
+
+  eytzinger_fill(f, vals, cnts, next, 2 * k);
+  f->keys[k] = vals[*next];
+  f->refcnts[k] = cnts[*next];
+  (*next)++;
+  eytzinger_fill(f, vals, cnts, next, 2 * k + 1);
+}
+
+// the vEB tables for the subtree spanning depths [a .. a + h - 1]
+static void
+veb_split(frozen_t *f, int a, int h)
+{
+  int top, bottom;
+
+  if (h <= 1)
+    return;
+
+  top = h / 2;
+  bottom = h - top;
+  f->veb_depth[a + top] = a;
+  f->veb_top[a + top] = ((size_t) 1 << top) - 1;
+  f->veb_bottom[a + top] = ((size_t) 1 << bottom) - 1;
+
+  veb_split(f, a, top);
+  veb_split(f, a + top, bottom);
+}
+
+// vEB slot of the node at depth d > 0 with breadth first index k: past
+// its enclosing subtree's root (at pos[veb_depth[d]]) and top tree, in
+// the bottom tree picked by k's low bits
+static inline size_t
+veb_pos(frozen_t *f, size_t *pos, int d, size_t k)
+{
+  return pos[f->veb_depth[d]] + f->veb_top[d] +
+    (k & f->veb_top[d]) * f->veb_bottom[d];
+}
+
+// the node at depth d with breadth first index k, and its subtree, in
+// order; pos[] holds the slots on the path down to it
+static void
+veb_fill(frozen_t *f, const int *vals, const int *cnts, size_t *next,
+         size_t k, int d, size_t *pos)
+{
+  size_t p;
+
+  if (d >= f->height)
+    return;
+
+  pos[d] = (d == 0) ? 1 : veb_pos(f, pos, d, k);
+  p = pos[d];
+
+  veb_fill(f, vals, cnts, next, 2 * k, d + 1, pos);
+  if (*next < f->n) {
+    f->keys[p] = vals[*next];
+    f->refcnts[p] = cnts[*next];
+    (*next)++;
+  }
+  else {
+    f->keys[p] = INT_MAX;
+    f->refcnts[p] = 0;
+  }
+  veb_fill(f, vals, cnts, next, 2 * k + 1, d + 1, pos);
+}
+
+// lay out the n distinct vals[], inserted cnts[] times each
+static int
+freeze(frozen_t *f, const int *vals, const int *cnts, size_t n,
+       frozen_layout_t layout)
+{
+  size_t pos[FROZEN_MAX_HEIGHT];
+  size_t next = 0;
+
+  memset(f, 0, sizeof(frozen_t));
+  f->layout = layout;
+  f->n = n;
+  while (f->height < FROZEN_MAX_HEIGHT &&
+         ((size_t) 1 << f->height) - 1 < n)
+    f->height++;
+
+  if (layout == FROZEN_EYTZINGER)
+    f->nslots = n + 1;
+  else if (layout == FROZEN_VEB)
+    f->nslots = (size_t) 1 << f->height;
+  else
+    return FAIL;
+
+  f->keys = alloc_slots(f->nslots);
+  f->refcnts = alloc_slots(f->nslots);
+  if (f->keys == NULL || f->refcnts == NULL) {
+    frozen_free(f);
+    return FAIL;
+  }
+  f->keys[0] = INT_MAX;
+  f->refcnts[0] = 0;
+
+  if (layout == FROZEN_EYTZINGER) {
+    eytzinger_fill(f, vals, cnts, &next, 1);
+  }
+  else {
+    veb_split(f, 0, f->height);
+    veb_fill(f, vals, cnts, &next, 1, 0, pos);
+  }
+
+  return SUCCESS;
+}
+
+// freeze the tree into the given layout; the tree is left as it is
+int
+tree_freeze(frozen_t *f, node_t *tree, frozen_layout_t layout)
+{
+  tree_iter_t it;
+  node_t     *n;
+  int        *vals, *cnts;
+  size_t      nnodes = 0, i = 0;
+  int         ret = FAIL;
+
+  if (f == NULL)
+    return FAIL;
+
+  // count, then collect, the nodes in order
+  if (tree_iter_init(&it, tree, TREE_INORDER) != SUCCESS)
+    return FAIL;
+  while (tree_iter_next(&it, &n) == SUCCESS && n != NULL)
+    nnodes++;
+  tree_iter_free(&it);
+
+  vals = malloc((nnodes + 1) * sizeof(int));
+  cnts = malloc((nnodes + 1) * sizeof(int));
+  if (vals != NULL && cnts != NULL &&
+      tree_iter_init(&it, tree, TREE_INORDER) == SUCCESS) {
+    while (tree_iter_next(&it, &n) == SUCCESS && n != NULL && i < nnodes) {
+      vals[i] = n->value;
+      cnts[i++] = n->refcnt;
+    }
+    tree_iter_free(&it);
+    if (i == nnodes)
+      ret = freeze(f, vals, cnts, nnodes, layout);
+  }
+
+  free(vals);
+  free(cnts);
+  return ret;
+}
+
+// freeze sorted data[0 .. n - 1] into the given layout, equal values
+// becoming one slot's refcnt
+int
+frozen_from_sorted(frozen_t *f, const int *data, size_t n,
+                   frozen_layout_t layout)
+{
+  int   *vals, *cnts;
+  size_t i, ndistinct = 0;
+  int    ret = FAIL;
+
+  if (f == NULL || (data == NULL && n > 0))
+    return FAIL;
+
+  vals = malloc((n + 1) * sizeof(int));
+  cnts = malloc((n + 1) * sizeof(int));
+  if (vals != NULL && cnts != NULL) {
+    for (i = 0; i < n; i++) {
+      if (i == 0 || data[i] != data[i - 1]) {
+        vals[ndistinct] = data[i];
+        cnts[ndistinct++] = 1;
+      }
+      else {
+        cnts[ndistinct - 1]++;
+      }
+    }
+    ret = freeze(f, vals, cnts, ndistinct, layout);
+  }
+
+  free(vals);
+  free(cnts);
+  return ret;
+}
+
+// slot of the first value >= value, 0 if every value is smaller
+static inline size_t
+eytzinger_search(frozen_t *f, int value)
+{
+  const int *keys = f->keys;
+  size_t     k = 1;
+
+  while (k <= f->n) {
+    // the line 4 levels down; prefetches past the end don't fault
+    __builtin_prefetch(&keys[16 * k]);
+    k = 2 * k + (keys[k] < value);
+  }
+  // undo the right turns since the last left one, and that left one
+  k >>= __builtin_ffsl(~(long) k);
+
+  return k;
+}
+
+static inline size_t
+veb_search(frozen_t *f, int value)
+{
+  size_t pos[FROZEN_MAX_HEIGHT];
+  size_t k = 1, found = 0;
+  int    d;
+  bool   ge;
+
+  for (d = 0; d < f->height; d++) {
+    pos[d] = (d == 0) ? 1 : veb_pos(f, pos, d, k);
+    ge = (f->keys[pos[d]] >= value);
+    found = ge ? pos[d] : found;
+    k = 2 * k + !ge;
+  }
+
+  // padding isn't a value
+  return (f->refcnts[found] > 0) ? found : 0;
+}
+
+static inline size_t
+frozen_search(frozen_t *f, int value)
+{
+  return (f->layout == FROZEN_EYTZINGER) ?
+    eytzinger_search(f, value) : veb_search(f, value);
+}
+
+// find a value
+//
+// refcnt: *refcnt = times value has been inserted, 0 if it's not there
+int
+frozen_find_value(frozen_t *f, int value, int *refcnt)
+{
+  size_t slot;
+
+  // sanity check of params
+  if (f == NULL || f->keys == NULL || refcnt == NULL)
+    return FAIL;
+
+  slot = frozen_search(f, value);
+  *refcnt = (f->keys[slot] == value) ? f->refcnts[slot] : 0;
+
+  return SUCCESS;
+}
+
+// find the first value >= value
+//
+// found: *found = that value
+// refcnt: *refcnt = its refcnt, 0 if every value is smaller
+int
+frozen_lower_bound(frozen_t *f, int value, int *found, int *refcnt)
+{
+  size_t slot;
+
+  // sanity check of params
+  if (f == NULL || f->keys == NULL || found == NULL || refcnt == NULL)
+    return FAIL;
+
+  slot = frozen_search(f, value);
+  *found = f->keys[slot];
+  *refcnt = f->refcnts[slot];
+
+  return SUCCESS;
+}
+
+size_t
+frozen_memory(frozen_t *f)
+{
+  return (f == NULL) ? 0 : 2 * f->nslots * sizeof(int);
+}
+
+int
+frozen_free(frozen_t *f)
+{
+  if (f == NULL)
+    return FAIL;
+
+  free(f->keys);
+  free(f->refcnts);
+  f->keys = NULL;
+  f->refcnts = NULL;
+  f->n = 0;
+  f->nslots = 0;
+
+  return SUCCESS;
+}
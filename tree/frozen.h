@@ -0,0 +1,58 @@
+//
+// frozen.h
+//
+// header file for read-only snapshots of the tree in an implicit
+// (pointer free) search layout
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef FROZEN_H
+#define FROZEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "common.h"
+
+// a complete tree of 2^31 - 1 nodes is deeper than any int array
+#define FROZEN_MAX_HEIGHT 32
+
+typedef enum {
+  FROZEN_EYTZINGER,   // breadth first: node k's children are 2k, 2k + 1
+  FROZEN_VEB          // van Emde Boas: recursively, the top half of the
+                      // levels, then each subtree under them
+} frozen_layout_t;
+
+// keys[] and refcnts[] are parallel, and slot 0 is unused: Eytzinger
+// uses [1 .. n], vEB a complete tree in [1 .. 2^height - 1], the slots
+// past the last value padded with INT_MAX and a refcnt of 0
+typedef struct {
+  frozen_layout_t layout;
+  int            *keys;
+  int            *refcnts;
+  size_t          n;        // distinct values
+  size_t          nslots;
+  int             height;
+  // vEB: for each depth d that's the root of a bottom tree, the depth
+  // of the subtree it was split from, the top tree's and a bottom
+  // tree's sizes
+  int             veb_depth[FROZEN_MAX_HEIGHT];
+  size_t          veb_top[FROZEN_MAX_HEIGHT];
+  size_t          veb_bottom[FROZEN_MAX_HEIGHT];
+} frozen_t;
+
+extern int tree_freeze(frozen_t *f, node_t *tree, frozen_layout_t layout);
+
+extern int frozen_from_sorted(frozen_t *f, const int *data, size_t n,
+                              frozen_layout_t layout);
+
+extern int frozen_find_value(frozen_t *f, int value, int *refcnt);
+
+extern int frozen_lower_bound(frozen_t *f, int value, int *found,
+                              int *refcnt);
+
+extern size_t frozen_memory(frozen_t *f);
+
+extern int frozen_free(frozen_t *f);
+
+#endif /* FROZEN_H */
@@ -0,0 +1,134 @@
+//
+// frozenbench.c
+//
+// benchmarking lookups in the frozen Eytzinger and vEB layouts against
+// tree_search on a balanced tree of the same values, from L2 sized up
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "build.h"
+#include "frozen.h"
+#include "bench.h"
+
+// the smallest tree: 32K values are 256KB frozen (keys and refcnts)
+#define FROZEN_MIN_NVALS (32 * 1024)
+// each size is this many times the last
+#define FROZEN_STEP      8
+#define NLOOKUPS         (4 * 1024 * 1024)
+
+static int
+compare_int(const void *left, const void *right)
+{
+  int l = *(const int *) left;
+  int r = *(const int *) right;
+
+  return (l > r) - (l < r);
+}
+
+// time NLOOKUPS finds (or lower bounds) of probes[] in f, or in tree if f
+// is NULL; returns the refcnts found, to check against the others
+static size_t
+time_lookups(node_t *tree, frozen_t *f, bool lower, const int *probes,
+             double *ns)
+{
+  struct timeval tv_start, tv_end;
+  node_t *n;
+  size_t  i, total = 0;
+  int     refcnt, found;
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < NLOOKUPS; i++) {
+    if (f == NULL) {
+      n = tree_search(tree, probes[i]);
+      total += (n != NULL && n->value == probes[i]) ? n->refcnt : 0;
+    }
+    else if (lower) {
+      frozen_lower_bound(f, probes[i], &found, &refcnt);
+      total += refcnt;
+    }
+    else {
+      frozen_find_value(f, probes[i], &refcnt);
+      total += refcnt;
+    }
+  }
+  gettimeofday(&tv_end, NULL);
+
+  *ns = elapsed(&tv_start, &tv_end) * 1E9 / NLOOKUPS;
+  return total;
+}
+
+static int
+bench_size(size_t nvals)
+{
+  node_t  *tree, *nodes;
+  frozen_t eytz, veb;
+  int     *sorted, *probes;
+  size_t   i, total_tree, total_lower;
+  double   ns_tree, ns_ef, ns_el, ns_vf, ns_vl;
+  bool     ok = true;
+
+  sorted = malloc(nvals * sizeof(int));
+  probes = malloc(NLOOKUPS * sizeof(int));
+  if (sorted == NULL || probes == NULL) {
+    printf("error: cannot allocate memory for values\n");
+    return FAIL;
+  }
+  for (i = 0; i < nvals; i++)
+    sorted[i] = (int) random();
+  // half the probes are there, half (almost all) aren't
+  for (i = 0; i < NLOOKUPS; i++)
+    probes[i] = (i & 1) ? sorted[random() % nvals] : (int) random();
+  qsort(sorted, nvals, sizeof(int), &compare_int);
+
+  if (tree_build_from_sorted(&tree, &nodes, sorted, nvals, true) != SUCCESS ||
+      tree_freeze(&eytz, tree, FROZEN_EYTZINGER) != SUCCESS ||
+      tree_freeze(&veb, tree, FROZEN_VEB) != SUCCESS) {
+    printf("error: cannot allocate memory for %zu values\n", nvals);
+    return FAIL;
+  }
+
+  total_tree = time_lookups(tree, NULL, false, probes, &ns_tree);
+  free(nodes);
+
+  if (time_lookups(NULL, &eytz, false, probes, &ns_ef) != total_tree)
+    ok = false;
+  if (time_lookups(NULL, &veb, false, probes, &ns_vf) != total_tree)
+    ok = false;
+  total_lower = time_lookups(NULL, &eytz, true, probes, &ns_el);
+  if (time_lookups(NULL, &veb, true, probes, &ns_vl) != total_lower)
+    ok = false;
+
+  printf("%10zu %9.1f MB %10.1f %10.1f %10.1f %10.1f %10.1f\n", nvals,
+         frozen_memory(&eytz) / 1E6, ns_tree, ns_ef, ns_el, ns_vf, ns_vl);
+  if (!ok)
+    printf("\n**** frozen lookups don't match the tree!\n");
+
+  frozen_free(&eytz);
+  frozen_free(&veb);
+  free(sorted);
+  free(probes);
+  return SUCCESS;
+}
+
+int
+frozen_bench(size_t nvals)
+{
+  size_t n;
+
+  printf("lookups, ns per op:\n");
+  printf("%10s %12s %10s %10s %10s %10s %10s\n", "values", "frozen",
+         "tree", "eytz find", "eytz lb", "vEB find", "vEB lb");
+
+  for (n = FROZEN_MIN_NVALS; n < nvals; n *= FROZEN_STEP) {
+    if (bench_size(n) != SUCCESS)
+      return FAIL;
+  }
+  return bench_size(nvals);
+}
@@ -0,0 +1,122 @@
+//
+// idxbench.c
+//
+// benchmarking the compact index tree (with and without the refcnts
+// split off) against the pointer tree: memory per node, inserts, finds
+// and an in-order walk
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "idxtree.h"
+#include "bench.h"
+
+// idx_walk_inorder callback: adds up the refcnts
+static int
+sum_refcnt(int value, int refcnt, void *arg)
+{
+  (void) value;
+  *(size_t *) arg += refcnt;
+  return SUCCESS;
+}
+
+static void
+print_result(const char *name, size_t nvals, double bytes_per_node,
+             double insert_secs, double find_secs, size_t nfound)
+{
+  printf("  %-16s %5.1f bytes per node, insert %7.1f ns, find %7.1f ns\n",
+         name, bytes_per_node, insert_secs * 1E9 / nvals,
+         find_secs * 1E9 / nvals);
+  if (nfound != nvals)
+    printf("\n**** %s lost values!\n", name);
+}
+
+int
+idx_bench(size_t nvals)
+{
+  struct timeval tv_start, tv_end;
+  node_t    *tree = NULL;
+  node_t    *found;
+  idx_tree_t idx;
+  int       *vals;
+  int        refcnt;
+  size_t     i, nfound, nnodes = 0, total;
+  double     insert_secs, find_secs;
+  int        method;
+
+  vals = malloc(nvals * sizeof(int));
+  if (vals == NULL) {
+    printf("error: cannot allocate memory for values\n");
+    return FAIL;
+  }
+  for (i = 0; i < nvals; i++)
+    vals[i] = (int) random();
+
+  printf("%zu random values (times per operation):\n", nvals);
+
+  for (method = 0; method < 3; method++) {
+    nfound = 0;
+    if (method == 0) {
+      gettimeofday(&tv_start, NULL);
+      for (i = 0; i < nvals; i++)
+        insert_value(&tree, vals[i]);
+      gettimeofday(&tv_end, NULL);
+      insert_secs = elapsed(&tv_start, &tv_end);
+
+      gettimeofday(&tv_start, NULL);
+      for (i = 0; i < nvals; i++) {
+        find_value(tree, vals[i], &found);
+        nfound += (found != NULL);
+      }
+      gettimeofday(&tv_end, NULL);
+      find_secs = elapsed(&tv_start, &tv_end);
+
+      // a node_t costs what malloc really hands out, plus its header
+      print_result("pointer", nvals,
+                   (double) (malloc_usable_size(tree) + sizeof(size_t)),
+                   insert_secs, find_secs, nfound);
+      free_tree(tree);
+      continue;
+    }
+
+    idx_init(&idx, method == 2);
+    gettimeofday(&tv_start, NULL);
+    for (i = 0; i < nvals; i++)
+      idx_insert_value(&idx, vals[i]);
+    gettimeofday(&tv_end, NULL);
+    insert_secs = elapsed(&tv_start, &tv_end);
+
+    gettimeofday(&tv_start, NULL);
+    for (i = 0; i < nvals; i++) {
+      idx_find_value(&idx, vals[i], &refcnt);
+      nfound += (refcnt > 0);
+    }
+    gettimeofday(&tv_end, NULL);
+    find_secs = elapsed(&tv_start, &tv_end);
+
+    nnodes = idx.nslots - 1;
+    print_result((method == 1) ? "index" : "index hot/cold", nvals,
+                 (double) idx_memory(&idx) / nnodes,
+                 insert_secs, find_secs, nfound);
+
+    total = 0;
+    gettimeofday(&tv_start, NULL);
+    idx_walk_inorder(&idx, &sum_refcnt, &total);
+    gettimeofday(&tv_end, NULL);
+    printf("  %-16s in-order walk %.1f ns per node\n", "",
+           elapsed(&tv_start, &tv_end) * 1E9 / nnodes);
+    if (total != nvals)
+      printf("\n**** index tree walk lost values!\n");
+    idx_free_tree(&idx);
+  }
+
+  free(vals);
+  return SUCCESS;
+}
@@ -0,0 +1,242 @@
+//
+// idxtree.c
+//
+// the unbalanced tree of tree.c with compact nodes: they're all in one
+// pool, which grows by realloc (indices, unlike pointers, survive the
+// move), and link to their children by 32-bit pool index, so a node is
+// 16 bytes instead of 24, or 12 if the refcnts are split off into their
+// own array
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "idxtree.h"
+
+#define IDX_INITIAL_SLOTS 1024
+
+static inline idx_hot_t *
+hot_node(idx_tree_t *tree, uint32_t i)
+{
+  return (idx_hot_t *) ((char *) tree->nodes + (size_t) i * tree->stride);
+}
+
+static inline int *
+refcnt_of(idx_tree_t *tree, uint32_t i)
+{
+  if (tree->split)
+    return &tree->refcnts[i];
+  return &((idx_node_t *) tree->nodes)[i].refcnt;
+}
+
+// take the next pool slot for value, growing the pool if it's full;
+// returns IDX_NIL if it can't (any idx_hot_t pointers are stale after)
+static uint32_t
+new_idx_node(idx_tree_t *tree, int value)
+{
+  idx_hot_t *n;
+  void      *nodes;
+  int       *refcnts;
+  uint32_t   capacity, i;
+
+  if (tree->nslots == tree->capacity) {
+    if (tree->capacity == UINT32_MAX)
+      return IDX_NIL;
+    capacity = (tree->capacity > UINT32_MAX / 2) ?
+      UINT32_MAX : tree->capacity * 2;
+
+    nodes = realloc(tree->nodes, (size_t) capacity * tree->stride);
+    if (nodes == NULL)
+      return IDX_NIL;
+    tree->nodes = nodes;
+    if (tree->split) {
+      refcnts = realloc(tree->refcnts, (size_t) capacity * sizeof(int));
+      if (refcnts == NULL)
+        return IDX_NIL;
+      tree->refcnts = refcnts;
+    }
+    tree->capacity = capacity;
+  }
+
+  i = tree->nslots++;
+  n = hot_node(tree, i);
+  n->value = value;
+  n->left = IDX_NIL;
+  n->right = IDX_NIL;
+  *refcnt_of(tree, i) = 1;
+
+  return i;
+}
+
+// initialize an empty tree, with the refcnts split off or not
+int
+idx_init(idx_tree_t *tree, bool split)
+{
+  if (tree == NULL)
+    return FAIL;
+
+  tree->split = split;
+  tree->stride = split ? sizeof(idx_hot_t) : sizeof(idx_node_t);
+  tree->capacity = IDX_INITIAL_SLOTS;
+  tree->nodes = malloc(IDX_INITIAL_SLOTS * tree->stride);
+  tree->refcnts = split ? malloc(IDX_INITIAL_SLOTS * sizeof(int)) : NULL;
+  if (tree->nodes == NULL || (split && tree->refcnts == NULL)) {
+    free(tree->nodes);
+    free(tree->refcnts);
+    tree->nodes = NULL;
+    tree->refcnts = NULL;
+    return FAIL;
+  }
+  tree->root = IDX_NIL;
+  tree->nslots = 1;
+
+  return SUCCESS;
+}
+
+// insert a value into the tree; if it's already there, increment its
+// refcnt
+int
+idx_insert_value(idx_tree_t *tree, int value)
+{
+  idx_hot_t *n;
+  uint32_t   i, next, new;
+
+  if (tree == NULL || tree->nodes == NULL)
+    return FAIL;
+
+  if (tree->root == IDX_NIL) {
+    tree->root = new_idx_node(tree, value);
+    return (tree->root == IDX_NIL) ? FAIL : SUCCESS;
+  }
+
+  // find the place in the tree to insert this value
+  i = tree->root;
+  for (;;) {
+    n = hot_node(tree, i);
+    if (value == n->value) {
+      (*refcnt_of(tree, i))++;
+      return SUCCESS;
+    }
+    next = (value < n->value) ? n->left : n->right;
+    if (next == IDX_NIL)
+      break;
+    i = next;
+  }
+
+  new = new_idx_node(tree, value);
+  if (new == IDX_NIL)
+    return FAIL;
+
+  // the pool may have moved
+  n = hot_node(tree, i);
+  if (value < n->value)
+    n->left = new;
+  else
+    n->right = new;
+
+  return SUCCESS;
+}
+
+// find a value in the tree
+//
+// refcnt: *refcnt = times value has been inserted, 0 if it's not there
+int
+idx_find_value(idx_tree_t *tree, int value, int *refcnt)
+{
+  idx_hot_t *n;
+  uint32_t   i;
+
+  // sanity check of params
+  if (tree == NULL || refcnt == NULL)
+    return FAIL;
+
+  *refcnt = 0;
+  i = tree->root;
+  while (i != IDX_NIL) {
+    n = hot_node(tree, i);
+    if (n->value == value) {
+      *refcnt = *refcnt_of(tree, i);
+      break;
+    }
+    i = (value < n->value) ? n->left : n->right;
+  }
+
+  return SUCCESS;
+}
+
+// call fn on every node in order, with an explicit stack rather than
+// recursion (the tree may be a list)
+int
+idx_walk_inorder(idx_tree_t *tree, idx_visit_fn fn, void *arg)
+{
+  uint32_t *stack, *tmp;
+  size_t    top = 0, cap = 64;
+  uint32_t  i;
+  int       ret = SUCCESS;
+
+  if (tree == NULL || fn == NULL)
+    return FAIL;
+
+  stack = malloc(cap * sizeof(uint32_t));
+  if (stack == NULL)
+    return FAIL;
+
+  i = tree->root;
+  while (ret == SUCCESS && (i != IDX_NIL || top > 0)) {
+    if (i != IDX_NIL) {
+      if (top == cap) {
+        cap *= 2;
+        tmp = realloc(stack, cap * sizeof(uint32_t));
+        if (tmp == NULL) {
+          ret = FAIL;
+          break;
+        }
+        stack = tmp;
+      }
+      stack[top++] = i;
+      i = hot_node(tree, i)->left;
+    }
+    else {
+      i = stack[--top];
+      ret = fn(hot_node(tree, i)->value, *refcnt_of(tree, i), arg);
+      i = hot_node(tree, i)->right;
+    }
+  }
+
+  free(stack);
+  return ret;
+}
+
+// bytes of pool in use (the pool itself may be up to twice that)
+size_t
+idx_memory(idx_tree_t *tree)
+{
+  if (tree == NULL)
+    return 0;
+
+  return (size_t) tree->nslots *
+    (tree->stride + (tree->split ? sizeof(int) : 0));
+}
+
+// free the whole tree, which is just the pool
+int
+idx_free_tree(idx_tree_t *tree)
+{
+  if (tree == NULL)
+    return FAIL;
+
+  free(tree->nodes);
+  free(tree->refcnts);
+  tree->nodes = NULL;
+  tree->refcnts = NULL;
+  tree->root = IDX_NIL;
+  tree->nslots = 1;
+  tree->capacity = 0;
+
+  return SUCCESS;
+}
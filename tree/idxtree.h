@@ -0,0 +1,61 @@
+//
+// idxtree.h
+//
+// header file for the compact unbalanced tree: nodes in one pool,
+// linked by 32-bit indices instead of pointers
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef IDXTREE_H
+#define IDXTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// pool slot 0 is never used, so a zero link means no child
+#define IDX_NIL 0
+
+// what a search touches: the value and the links
+typedef struct {
+  int       value;
+  uint32_t  left;
+  uint32_t  right;
+} idx_hot_t;
+
+// a whole node, 16 bytes (4 to a cache line) against node_t's 24
+typedef struct {
+  idx_hot_t hot;
+  int       refcnt;
+} idx_node_t;
+
+// split: the pool holds 12-byte idx_hot_t nodes, and the refcnts live
+// in a parallel array that searches never read
+typedef struct {
+  void     *nodes;
+  int      *refcnts;    // split only
+  size_t    stride;     // sizeof(idx_hot_t) or sizeof(idx_node_t)
+  uint32_t  root;
+  uint32_t  nslots;     // slots in use, counting slot 0
+  uint32_t  capacity;
+  bool      split;
+} idx_tree_t;
+
+// called by idx_walk_inorder() for every node; a return value other than
+// SUCCESS stops the walk
+typedef int (*idx_visit_fn)(int value, int refcnt, void *arg);
+
+extern int idx_init(idx_tree_t *tree, bool split);
+
+extern int idx_insert_value(idx_tree_t *tree, int value);
+
+extern int idx_find_value(idx_tree_t *tree, int value, int *refcnt);
+
+extern int idx_walk_inorder(idx_tree_t *tree, idx_visit_fn fn, void *arg);
+
+extern size_t idx_memory(idx_tree_t *tree);
+
+extern int idx_free_tree(idx_tree_t *tree);
+
+#endif /* IDXTREE_H */
@@ -0,0 +1,305 @@
+//
+// iter.c
+//
+// cursors over the tree in order, pre order, post order and level
+// order, with an explicit stack (or queue) instead of recursion, so a
+// tree that's degenerated into a list can't blow the call stack; and
+// on top of them lower_bound and range_scan, plus an in order walk by
+// Morris threading that needs no stack at all
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "iter.h"
+
+#define ITER_INITIAL_NODES 64
+
+// push n onto the stack (or the tail of the queue), growing it if need
+// be; for level order, the consumed head of the queue is reused first
+static int
+iter_push(tree_iter_t *it, node_t *n)
+{
+  node_t **nodes;
+
+  if (it->top == it->cap) {
+    if (it->head > it->cap / 2) {
+      memmove(it->nodes, &it->nodes[it->head],
+              (it->top - it->head) * sizeof(node_t *));
+      it->top -= it->head;
+      it->head = 0;
+    }
+    else {
+      nodes = realloc(it->nodes, 2 * it->cap * sizeof(node_t *));
+      if (nodes == NULL)
+        return FAIL;
+      it->nodes = nodes;
+      it->cap *= 2;
+    }
+  }
+
+  it->nodes[it->top++] = n;
+  return SUCCESS;
+}
+
+// start a cursor over the tree in the given order
+int
+tree_iter_init(tree_iter_t *it, node_t *tree, tree_order_t order)
+{
+  if (it == NULL)
+    return FAIL;
+
+  it->order = order;
+  it->head = 0;
+  it->top = 0;
+  it->cap = ITER_INITIAL_NODES;
+  it->cur = NULL;
+  it->last = NULL;
+  it->nodes = malloc(it->cap * sizeof(node_t *));
+  if (it->nodes == NULL)
+    return FAIL;
+
+  switch (order) {
+    case TREE_INORDER:
+    case TREE_POSTORDER:
+    it->cur = tree;
+    break;
+
+    case TREE_PREORDER:
+    case TREE_LEVELORDER:
+    if (tree != NULL)
+      iter_push(it, tree);
+    break;
+
+    default:
+    tree_iter_free(it);
+    return FAIL;
+  }
+
+  return SUCCESS;
+}
+
+// start an in order cursor at the first node with a value >= value;
+// the stack ends up holding just the nodes where the search went left,
+// which are the ones still to come
+int
+tree_iter_seek(tree_iter_t *it, node_t *tree, int value)
+{
+  node_t *n;
+
+  if (tree_iter_init(it, NULL, TREE_INORDER) != SUCCESS)
+    return FAIL;
+
+  n = tree;
+  while (n != NULL) {
+    if (n->value >= value) {
+      if (iter_push(it, n) != SUCCESS) {
+        tree_iter_free(it);
+        return FAIL;
+      }
+      n = n->left;
+    }
+    else {
+      n = n->right;
+    }
+  }
+
+  return SUCCESS;
+}
+
+// advance the cursor
+//
+// next: *next = the next node, NULL once they've all been returned
+int
+tree_iter_next(tree_iter_t *it, node_t **next)
+{
+  node_t *n;
+
+  // sanity check of params
+  if (it == NULL || next == NULL || it->nodes == NULL)
+    return FAIL;
+
+  *next = NULL;
+
+  switch (it->order) {
+    case TREE_INORDER:
+    while (it->cur != NULL) {
+      if (iter_push(it, it->cur) != SUCCESS)
+        return FAIL;
+      it->cur = it->cur->left;
+    }
+    if (it->top == 0)
+      break;
+    n = it->nodes[--it->top];
+    it->cur = n->right;
+    *next = n;
+    break;
+
+    case TREE_PREORDER:
+    if (it->top == 0)
+      break;
+    n = it->nodes[--it->top];
+    // right first, so the left comes off first
+    if ((n->right != NULL && iter_push(it, n->right) != SUCCESS) ||
+        (n->left != NULL && iter_push(it, n->left) != SUCCESS))
+      return FAIL;
+    *next = n;
+    break;
+
+    case TREE_POSTORDER:
+    for (;;) {
+      while (it->cur != NULL) {
+        if (iter_push(it, it->cur) != SUCCESS)
+          return FAIL;
+        it->cur = it->cur->left;
+      }
+      if (it->top == 0)
+        break;
+      // a node comes off once its right subtree's done with (only its
+      // address is compared, so the caller may free what it's been
+      // given)
+      n = it->nodes[it->top - 1];
+      if (n->right != NULL && n->right != it->last) {
+        it->cur = n->right;
+      }
+      else {
+        it->top--;
+        it->last = n;
+        *next = n;
+        break;
+      }
+    }
+    break;
+
+    case TREE_LEVELORDER:
+    if (it->head == it->top)
+      break;
+    n = it->nodes[it->head++];
+    if ((n->left != NULL && iter_push(it, n->left) != SUCCESS) ||
+        (n->right != NULL && iter_push(it, n->right) != SUCCESS))
+      return FAIL;
+    *next = n;
+    break;
+  }
+
+  return SUCCESS;
+}
+
+int
+tree_iter_free(tree_iter_t *it)
+{
+  if (it == NULL)
+    return FAIL;
+
+  free(it->nodes);
+  it->nodes = NULL;
+  it->head = 0;
+  it->top = 0;
+  it->cap = 0;
+
+  return SUCCESS;
+}
+
+// find the first node with a value >= value
+//
+// found: *found = that node, NULL if every value is smaller
+int
+lower_bound(node_t *tree, int value, node_t **found)
+{
+  node_t *n;
+
+  // sanity check of params
+  if (found == NULL)
+    return FAIL;
+
+  *found = NULL;
+  n = tree;
+  while (n != NULL) {
+    if (n->value >= value) {
+      *found = n;
+      n = n->left;
+    }
+    else {
+      n = n->right;
+    }
+  }
+
+  return SUCCESS;
+}
+
+// call fn for every node with a value in [lo .. hi], in order
+int
+range_scan(node_t *tree, int lo, int hi, tree_scan_fn fn, void *arg)
+{
+  tree_iter_t it;
+  node_t     *n;
+  int         ret = SUCCESS;
+
+  if (fn == NULL)
+    return FAIL;
+  if (tree == NULL || lo > hi)
+    return SUCCESS;
+
+  if (tree_iter_seek(&it, tree, lo) != SUCCESS)
+    return FAIL;
+
+  for (;;) {
+    ret = tree_iter_next(&it, &n);
+    if (ret != SUCCESS || n == NULL || n->value > hi)
+      break;
+    if (fn(n, arg) != SUCCESS)
+      break;
+  }
+
+  tree_iter_free(&it);
+  return ret;
+}
+
+// call fn for every node in order, by Morris threading: the rightmost
+// node of each left subtree is pointed back at the subtree's parent on
+// the way down, and restored on the way back up, so there's no stack,
+// but the tree is being modified until the walk's done
+int
+tree_walk_morris(node_t *tree, tree_scan_fn fn, void *arg)
+{
+  node_t *n, *pred;
+  bool    stopped = false;
+
+  if (fn == NULL)
+    return FAIL;
+
+  n = tree;
+  while (n != NULL) {
+    if (n->left == NULL) {
+      if (!stopped && fn(n, arg) != SUCCESS)
+        stopped = true;
+      n = n->right;
+      continue;
+    }
+
+    pred = n->left;
+    while (pred->right != NULL && pred->right != n)
+      pred = pred->right;
+
+    if (pred->right == NULL) {
+      // first time here: thread it and go down to the left
+      pred->right = n;
+      n = n->left;
+    }
+    else {
+      // back up from the left subtree: unthread it, this node's next
+      pred->right = NULL;
+      // once stopped, keep going only to undo the threads
+      if (!stopped && fn(n, arg) != SUCCESS)
+        stopped = true;
+      n = n->right;
+    }
+  }
+
+  return SUCCESS;
+}
@@ -0,0 +1,54 @@
+//
+// iter.h
+//
+// header file for the tree iterators and range queries
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef ITER_H
+#define ITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "common.h"
+
+typedef enum {
+  TREE_INORDER,
+  TREE_PREORDER,
+  TREE_POSTORDER,
+  TREE_LEVELORDER
+} tree_order_t;
+
+// a cursor over the tree; nodes is a stack, or for level order a queue
+// from head to top
+typedef struct {
+  tree_order_t order;
+  node_t     **nodes;
+  size_t       head;
+  size_t       top;
+  size_t       cap;
+  node_t      *cur;    // in and post order: subtree still to go down
+  node_t      *last;   // post order: the node returned last
+} tree_iter_t;
+
+// called by range_scan() and tree_walk_morris() for every node; a return
+// value other than SUCCESS stops the scan
+typedef int (*tree_scan_fn)(node_t *node, void *arg);
+
+extern int tree_iter_init(tree_iter_t *it, node_t *tree, tree_order_t order);
+
+extern int tree_iter_seek(tree_iter_t *it, node_t *tree, int value);
+
+extern int tree_iter_next(tree_iter_t *it, node_t **next);
+
+extern int tree_iter_free(tree_iter_t *it);
+
+extern int lower_bound(node_t *tree, int value, node_t **found);
+
+extern int range_scan(node_t *tree, int lo, int hi, tree_scan_fn fn,
+                      void *arg);
+
+extern int tree_walk_morris(node_t *tree, tree_scan_fn fn, void *arg);
+
+#endif /* ITER_H */
@@ -0,0 +1,151 @@
+//
+// iterbench.c
+//
+// benchmarking the tree cursors, Morris walk, range_scan and
+// lower_bound against a recursive walk
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "iter.h"
+#include "bench.h"
+
+// range scans in the narrow scan test, each over about this many nodes
+#define NSCANS     100000
+#define SCAN_NODES 100
+
+// tree_scan_fn: adds up the refcnts
+static int
+sum_refcnt(node_t *node, void *arg)
+{
+  *(size_t *) arg += node->refcnt;
+  return SUCCESS;
+}
+
+// the recursive walk the cursors replace
+static void
+walk_recursive(node_t *tree, size_t *total)
+{
+  if (tree == NULL)
+    return;
+
+  walk_recursive(tree->left, total);
+  *total += tree->refcnt;
+  walk_recursive(tree->right, total);
+}
+
+static void
+print_result(const char *name, size_t nnodes, double secs, size_t total,
+             size_t nvals)
+{
+  printf("  %-18s %7.1f M nodes/s\n", name, nnodes / secs / 1E6);
+  if (total != nvals)
+    printf("\n**** %s lost values!\n", name);
+}
+
+int
+iter_bench(size_t nvals)
+{
+  static const struct {
+    const char  *name;
+    tree_order_t order;
+  } orders[] = {
+    { "in order",    TREE_INORDER },
+    { "pre order",   TREE_PREORDER },
+    { "post order",  TREE_POSTORDER },
+    { "level order", TREE_LEVELORDER },
+  };
+  struct timeval tv_start, tv_end;
+  tree_iter_t it;
+  node_t *tree = NULL;
+  node_t *n;
+  size_t  i, o, nnodes = 0, total, nscanned;
+  double  secs;
+  long    width, lo;
+  int    *probes;
+
+  for (i = 0; i < nvals; i++)
+    insert_value(&tree, (int) random());
+
+  // every walk should visit this many nodes
+  tree_iter_init(&it, tree, TREE_INORDER);
+  while (tree_iter_next(&it, &n) == SUCCESS && n != NULL)
+    nnodes++;
+  tree_iter_free(&it);
+
+  printf("tree of %zu random values, %zu nodes:\n", nvals, nnodes);
+
+  total = 0;
+  gettimeofday(&tv_start, NULL);
+  walk_recursive(tree, &total);
+  gettimeofday(&tv_end, NULL);
+  print_result("recursive", nnodes, elapsed(&tv_start, &tv_end), total,
+               nvals);
+
+  for (o = 0; o < sizeof(orders) / sizeof(orders[0]); o++) {
+    total = 0;
+    gettimeofday(&tv_start, NULL);
+    tree_iter_init(&it, tree, orders[o].order);
+    while (tree_iter_next(&it, &n) == SUCCESS && n != NULL)
+      total += n->refcnt;
+    tree_iter_free(&it);
+    gettimeofday(&tv_end, NULL);
+    print_result(orders[o].name, nnodes, elapsed(&tv_start, &tv_end), total,
+                 nvals);
+  }
+
+  total = 0;
+  gettimeofday(&tv_start, NULL);
+  tree_walk_morris(tree, &sum_refcnt, &total);
+  gettimeofday(&tv_end, NULL);
+  print_result("Morris in order", nnodes, elapsed(&tv_start, &tv_end), total,
+               nvals);
+
+  total = 0;
+  gettimeofday(&tv_start, NULL);
+  range_scan(tree, INT_MIN, INT_MAX, &sum_refcnt, &total);
+  gettimeofday(&tv_end, NULL);
+  print_result("range_scan (all)", nnodes, elapsed(&tv_start, &tv_end), total,
+               nvals);
+
+  // narrow scans: mostly the seek
+  width = (long) RAND_MAX / (long) nnodes * SCAN_NODES;
+  nscanned = 0;
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < NSCANS; i++) {
+    lo = random() % ((long) RAND_MAX - width);
+    total = 0;
+    range_scan(tree, (int) lo, (int) (lo + width), &sum_refcnt, &total);
+    nscanned += total;
+  }
+  gettimeofday(&tv_end, NULL);
+  secs = elapsed(&tv_start, &tv_end);
+  printf("  %-18s %7.1f ns per scan of %.1f values\n", "range_scan (narrow)",
+         secs * 1E9 / NSCANS, (double) nscanned / NSCANS);
+
+  probes = malloc(nvals * sizeof(int));
+  if (probes == NULL) {
+    printf("error: cannot allocate memory for values\n");
+    free_tree(tree);
+    return FAIL;
+  }
+  for (i = 0; i < nvals; i++)
+    probes[i] = (int) random();
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++)
+    lower_bound(tree, probes[i], &n);
+  gettimeofday(&tv_end, NULL);
+  printf("  %-18s %7.1f ns per call\n", "lower_bound",
+         elapsed(&tv_start, &tv_end) * 1E9 / nvals);
+
+  free(probes);
+  free_tree(tree);
+  return SUCCESS;
+}
@@ -0,0 +1,191 @@
+//
+// orderbench.c
+//
+// benchmarking the red-black tree's order statistics (rb_select,
+// rb_rank, rb_count_range) against getting the same answers by walking
+// the tree in order, for percentile queries
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "rbtree.h"
+#include "bench.h"
+
+// queries by the O(log n) functions, and by walking (each of which
+// walks on average half the tree)
+#define NQUERIES      100000
+#define NWALK_QUERIES 9
+
+static rb_node_t *
+first_node(rb_tree_t *tree)
+{
+  rb_node_t *n = tree->root;
+
+  while (n != NULL && n->left != NULL)
+    n = n->left;
+  return n;
+}
+
+// in order successor, by the parent links
+static rb_node_t *
+next_node(rb_node_t *n)
+{
+  if (n->right != NULL) {
+    n = n->right;
+    while (n->left != NULL)
+      n = n->left;
+    return n;
+  }
+  while (n->parent != NULL && n == n->parent->right)
+    n = n->parent;
+  return n->parent;
+}
+
+static rb_node_t *
+walk_select(rb_tree_t *tree, size_t k)
+{
+  rb_node_t *n;
+  size_t     seen = 0;
+
+  for (n = first_node(tree); n != NULL; n = next_node(n)) {
+    seen += n->refcnt;
+    if (k < seen)
+      break;
+  }
+  return n;
+}
+
+static size_t
+walk_rank(rb_tree_t *tree, int value)
+{
+  rb_node_t *n;
+  size_t     rank = 0;
+
+  for (n = first_node(tree); n != NULL && n->value < value; n = next_node(n))
+    rank += n->refcnt;
+  return rank;
+}
+
+static size_t
+walk_count_range(rb_tree_t *tree, int lo, int hi)
+{
+  rb_node_t *n;
+  size_t     count = 0;
+
+  for (n = first_node(tree); n != NULL && n->value <= hi; n = next_node(n)) {
+    if (n->value >= lo)
+      count += n->refcnt;
+  }
+  return count;
+}
+
+static void
+print_result(const char *name, double secs, double walk_secs)
+{
+  printf("  %-16s %10.1f ns %14.3f ms %12.0fx\n", name,
+         secs * 1E9 / NQUERIES, walk_secs * 1E3 / NWALK_QUERIES,
+         (walk_secs / NWALK_QUERIES) / (secs / NQUERIES));
+}
+
+int
+order_bench(size_t nvals)
+{
+  struct timeval tv_start, tv_end;
+  rb_tree_t  tree;
+  rb_node_t *n;
+  size_t    *ks, i, k, rank, count, sum = 0, walk_sum = 0;
+  int        lo, hi;
+  double     secs, walk_secs;
+
+  ks = malloc(NQUERIES * sizeof(size_t));
+  if (ks == NULL) {
+    printf("error: cannot allocate memory for queries\n");
+    return FAIL;
+  }
+
+  rb_init(&tree);
+  for (i = 0; i < nvals; i++)
+    rb_insert_value(&tree, (int) random());
+
+  // random percentiles for the fast queries, the deciles for the walks
+  for (i = 0; i < NQUERIES; i++)
+    ks[i] = (size_t) random() % nvals;
+
+  printf("%zu random values, %zu nodes, per query:\n", nvals, tree.nnodes);
+  printf("  %-16s %13s %17s %13s\n", "", "O(log n)", "walk", "speedup");
+
+  // select: the value at a percentile
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < NQUERIES; i++) {
+    rb_select(&tree, ks[i], &n);
+    sum += n->value;
+  }
+  gettimeofday(&tv_end, NULL);
+  secs = elapsed(&tv_start, &tv_end);
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 1; i <= NWALK_QUERIES; i++) {
+    k = nvals / (NWALK_QUERIES + 1) * i;
+    n = walk_select(&tree, k);
+    walk_sum += n->value;
+    rb_select(&tree, k, &n);
+    walk_sum -= n->value;
+  }
+  gettimeofday(&tv_end, NULL);
+  walk_secs = elapsed(&tv_start, &tv_end);
+  print_result("rb_select", secs, walk_secs);
+
+  // rank: the percentile of a value
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < NQUERIES; i++) {
+    rb_rank(&tree, (int) ks[i] * (RAND_MAX / nvals), &rank);
+    sum += rank;
+  }
+  gettimeofday(&tv_end, NULL);
+  secs = elapsed(&tv_start, &tv_end);
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 1; i <= NWALK_QUERIES; i++) {
+    lo = (int) (RAND_MAX / (NWALK_QUERIES + 1) * i);
+    rb_rank(&tree, lo, &rank);
+    walk_sum += walk_rank(&tree, lo) - rank;
+  }
+  gettimeofday(&tv_end, NULL);
+  walk_secs = elapsed(&tv_start, &tv_end);
+  print_result("rb_rank", secs, walk_secs);
+
+  // count_range: the values between two percentiles' values
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < NQUERIES; i++) {
+    lo = (int) random();
+    hi = lo + (int) ((RAND_MAX - lo) / 2);
+    rb_count_range(&tree, lo, hi, &count);
+    sum += count;
+  }
+  gettimeofday(&tv_end, NULL);
+  secs = elapsed(&tv_start, &tv_end);
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 1; i <= NWALK_QUERIES; i++) {
+    lo = (int) (RAND_MAX / (NWALK_QUERIES + 1) * (i - 1));
+    hi = (int) (RAND_MAX / (NWALK_QUERIES + 1) * (i + 1));
+    rb_count_range(&tree, lo, hi, &count);
+    walk_sum += walk_count_range(&tree, lo, hi) - count;
+  }
+  gettimeofday(&tv_end, NULL);
+  walk_secs = elapsed(&tv_start, &tv_end);
+  print_result("rb_count_range", secs, walk_secs);
+
+  // the walks' answers less the O(log n) ones'
+  if (walk_sum != 0 || sum == 0 || rb_check(&tree) != SUCCESS)
+    printf("\n**** order statistics don't match the walks!\n");
+
+  rb_free_tree(&tree);
+  free(ks);
+  return SUCCESS;
+}
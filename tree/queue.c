@@ -12,11 +12,26 @@
 #include "common.h"
 #include "queue.h"
 
+// where queue elements are allocated from, if not malloc
+arena_t *queue_arena = NULL;
+
+// free a queue element allocated by new_queue_element
+static void free_queue_element(q_element_t *e)
+{
+  if (queue_arena != NULL)
+    arena_free(queue_arena, e);
+  else
+    free(e);
+}
+
 // create and initialize a queue element
 q_element_t * new_queue_element(node_t *node)
 {
   q_element_t * e;
-  e = malloc(sizeof(q_element_t));
+  if (queue_arena != NULL)
+    e = arena_alloc(queue_arena);
+  else
+    e = malloc(sizeof(q_element_t));
   if (e != NULL) {
     e->packet = node;
     e->next = NULL;
@@ -71,7 +86,7 @@ node_t * deQ(queue_t *q)
   // base case: one element in queue
   if (q->oldest == q->newest) {
     n = q->oldest->packet;
-    free(q->oldest);
+    free_queue_element(q->oldest);
     q->oldest = q->newest = NULL;
   }
   else {
@@ -86,7 +101,7 @@ node_t * deQ(queue_t *q)
     }
 
     // free memory from the oldest element
-    free(q->oldest);
+    free_queue_element(q->oldest);
 
     // set up the oldest element to be iter
     q->oldest = iter;
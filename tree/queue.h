@@ -10,6 +10,7 @@
 #define QUEUE_H
 
 #include "common.h"
+#include "arena.h"
 
 typedef struct _q_elt_ {
   node_t          *packet;
@@ -22,6 +23,10 @@ typedef struct {
   q_element_t     *prev_oldest; // optimization: not used yet
 } queue_t;
 
+// if set, queue elements come from (and go back to) this arena
+// instead of malloc
+extern arena_t *queue_arena;
+
 extern int initQ(queue_t *q);
 
 extern int enQ(queue_t *q, node_t *n);
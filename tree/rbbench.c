@@ -0,0 +1,181 @@
+//
+// rbbench.c
+//
+// benchmarking the red-black tree against the unbalanced tree on
+// sorted, reverse sorted and random inserts
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "tree.h"
+#include "rbtree.h"
+#include "bench.h"
+
+// sorted input makes the unbalanced tree a list, and n inserts take
+// O(n^2), so it only gets this many
+#define MAX_UNBALANCED_SORTED 32768
+
+// height of the unbalanced tree, without recursion (it may be a list)
+static size_t
+tree_height(node_t *tree)
+{
+  node_t **stack;
+  size_t  *depth;
+  size_t   top = 0, height = 0, d, cap = 1024;
+  node_t  *n;
+
+  if (tree == NULL)
+    return 0;
+
+  stack = malloc(cap * sizeof(node_t *));
+  depth = malloc(cap * sizeof(size_t));
+  if (stack == NULL || depth == NULL)
+    return 0;
+
+  stack[top] = tree;
+  depth[top++] = 1;
+  while (top > 0) {
+    top--;
+    n = stack[top];
+    d = depth[top];
+    if (d > height)
+      height = d;
+    if (top + 2 > cap) {
+      cap *= 2;
+      stack = realloc(stack, cap * sizeof(node_t *));
+      depth = realloc(depth, cap * sizeof(size_t));
+      if (stack == NULL || depth == NULL)
+        return 0;
+    }
+    if (n->left != NULL) {
+      stack[top] = n->left;
+      depth[top++] = d + 1;
+    }
+    if (n->right != NULL) {
+      stack[top] = n->right;
+      depth[top++] = d + 1;
+    }
+  }
+
+  free(stack);
+  free(depth);
+  return height;
+}
+
+static void
+bench_unbalanced(int *vals, size_t nvals)
+{
+  struct timeval tv_start, tv_end;
+  node_t *tree = NULL;
+  node_t *found;
+  size_t  i, nfound = 0;
+  double  insert_secs, find_secs;
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++)
+    insert_value(&tree, vals[i]);
+  gettimeofday(&tv_end, NULL);
+  insert_secs = elapsed(&tv_start, &tv_end);
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++) {
+    find_value(tree, vals[i], &found);
+    nfound += (found != NULL);
+  }
+  gettimeofday(&tv_end, NULL);
+  find_secs = elapsed(&tv_start, &tv_end);
+
+  printf("  unbalanced: %10zu values: insert %8.1f ns, find %8.1f ns, "
+         "height %zu\n", nvals, insert_secs * 1E9 / nvals,
+         find_secs * 1E9 / nvals, tree_height(tree));
+  if (nfound != nvals)
+    printf("\n**** unbalanced tree lost values!\n");
+
+  free_tree(tree);
+}
+
+static void
+bench_rb(int *vals, size_t nvals)
+{
+  struct timeval tv_start, tv_end;
+  rb_tree_t  tree;
+  rb_node_t *found;
+  size_t     i, nfound = 0, height;
+  double     insert_secs, find_secs, delete_secs;
+  bool       ok;
+
+  rb_init(&tree);
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++)
+    rb_insert_value(&tree, vals[i]);
+  gettimeofday(&tv_end, NULL);
+  insert_secs = elapsed(&tv_start, &tv_end);
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++) {
+    rb_find_value(&tree, vals[i], &found);
+    nfound += (found != NULL);
+  }
+  gettimeofday(&tv_end, NULL);
+  find_secs = elapsed(&tv_start, &tv_end);
+
+  rb_height(&tree, &height);
+  ok = (rb_check(&tree) == SUCCESS && nfound == nvals);
+
+  gettimeofday(&tv_start, NULL);
+  for (i = 0; i < nvals; i++)
+    rb_delete_value(&tree, vals[i]);
+  gettimeofday(&tv_end, NULL);
+  delete_secs = elapsed(&tv_start, &tv_end);
+
+  printf("  red-black:  %10zu values: insert %8.1f ns, find %8.1f ns, "
+         "delete %8.1f ns, height %zu\n", nvals, insert_secs * 1E9 / nvals,
+         find_secs * 1E9 / nvals, delete_secs * 1E9 / nvals, height);
+  if (!ok || tree.root != NULL)
+    printf("\n**** red-black tree is broken!\n");
+
+  rb_free_tree(&tree);
+}
+
+int
+rb_bench(size_t nvals)
+{
+  static const char *orders[] = { "sorted", "reverse", "random" };
+  int   *vals;
+  size_t i, o, nunbalanced;
+
+  vals = malloc(nvals * sizeof(int));
+  if (vals == NULL) {
+    printf("error: cannot allocate memory for values\n");
+    return FAIL;
+  }
+
+  for (o = 0; o < 3; o++) {
+    for (i = 0; i < nvals; i++) {
+      if (o == 0)
+        vals[i] = (int) i;
+      else if (o == 1)
+        vals[i] = (int) (nvals - i);
+      else
+        vals[i] = (int) random();
+    }
+
+    printf("%s inserts (times per operation):\n", orders[o]);
+
+    nunbalanced = nvals;
+    if (o < 2 && nunbalanced > MAX_UNBALANCED_SORTED)
+      nunbalanced = MAX_UNBALANCED_SORTED;
+    bench_unbalanced(vals, nunbalanced);
+    bench_rb(vals, nvals);
+    printf("\n");
+  }
+
+  free(vals);
+  return SUCCESS;
+}
@@ -0,0 +1,593 @@
+//
+// rbtree.c
+//
+// red-black tree with the same duplicate semantics as tree.c (a value
+// inserted again just bumps its node's refcnt); insert, find, delete
+// and free are all iterative, and the height stays under
+// 2 * log2(n + 1), so sorted input doesn't degenerate into a list;
+// every node also counts the values in its subtree, kept up through
+// the rotations, so the kth smallest value, a value's rank, and the
+// number of values in a range are all O(log n) too
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "rbtree.h"
+
+// create a new (red) rb_node_t containing value
+static rb_node_t *
+new_rb_node(int value)
+{
+  rb_node_t *n = malloc(sizeof(rb_node_t));
+  if (n == NULL)
+    return NULL;
+
+  n->value = value;
+  n->refcnt = 1;
+  n->left = NULL;
+  n->right = NULL;
+  n->parent = NULL;
+  n->count = 1;
+  n->red = true;
+
+  return n;
+}
+
+static inline bool
+is_red(rb_node_t *n)
+{
+  return n != NULL && n->red;
+}
+
+static inline size_t
+count_of(rb_node_t *n)
+{
+  return (n == NULL) ? 0 : n->count;
+}
+
+static inline void
+update_count(rb_node_t *n)
+{
+  n->count = count_of(n->left) + count_of(n->right) + n->refcnt;
+}
+
+// replace x by its right child y, x becoming y's left child
+static void
+rotate_left(rb_tree_t *tree, rb_node_t *x)
+{
+  rb_node_t *y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+
+  y->parent = x->parent;
+  if (x->parent == NULL)
+    tree->root = y;
+  else if (x == x->parent->left)
+    x->parent->left = y;
+  else
+    x->parent->right = y;
+
+  y->left = x;
+  x->parent = y;
+
+  // y's subtree is what x's was
+  y->count = x->count;
+  update_count(x);
+}
+
+// replace x by its left child y, x becoming y's right child
+static void
+rotate_right(rb_tree_t *tree, rb_node_t *x)
+{
+  rb_node_t *y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+
+  y->parent = x->parent;
+  if (x->parent == NULL)
+    tree->root = y;
+  else if (x == x->parent->right)
+    x->parent->right = y;
+  else
+    x->parent->left = y;
+
+  y->right = x;
+  x->parent = y;
+
+  y->count = x->count;
+  update_count(x);
+}
+
+// put subtree v where subtree u was
+static void
+transplant(rb_tree_t *tree, rb_node_t *u, rb_node_t *v)
+{
+  if (u->parent == NULL)
+    tree->root = v;
+  else if (u == u->parent->left)
+    u->parent->left = v;
+  else
+    u->parent->right = v;
+
+  if (v != NULL)
+    v->parent = u->parent;
+}
+
+// restore the red-black properties after the red node x was added
+static void
+insert_fixup(rb_tree_t *tree, rb_node_t *x)
+{
+  rb_node_t *p, *g, *u;
+
+  while ((p = x->parent) != NULL && p->red) {
+    // p is red, so it isn't the root and g exists
+    g = p->parent;
+
+    if (p == g->left) {
+      u = g->right;
+      if (is_red(u)) {
+        // red uncle: push the blackness down from g and go on from g
+        p->red = false;
+        u->red = false;
+        g->red = true;
+        x = g;
+      }
+      else {
+        if (x == p->right) {
+          x = p;
+          rotate_left(tree, x);
+          p = x->parent;
+        }
+        p->red = false;
+        g->red = true;
+        rotate_right(tree, g);
+      }
+    }
+    else {
+      u = g->left;
+      if (is_red(u)) {
+        p->red = false;
+        u->red = false;
+        g->red = true;
+        x = g;
+      }
+      else {
+        if (x == p->left) {
+          x = p;
+          rotate_right(tree, x);
+          p = x->parent;
+        }
+        p->red = false;
+        g->red = true;
+        rotate_left(tree, g);
+      }
+    }
+  }
+
+  tree->root->red = false;
+}
+
+// restore the red-black properties after a black node was removed
+// from above x (which may be NULL, hence its parent xp)
+static void
+delete_fixup(rb_tree_t *tree, rb_node_t *x, rb_node_t *xp)
+{
+  rb_node_t *w;
+
+  while (x != tree->root && !is_red(x)) {
+    if (x == xp->left) {
+      // x is short a black node, so its sibling w can't be NULL
+      w = xp->right;
+      if (w->red) {
+        w->red = false;
+        xp->red = true;
+        rotate_left(tree, xp);
+        w = xp->right;
+      }
+      if (!is_red(w->left) && !is_red(w->right)) {
+        w->red = true;
+        x = xp;
+        xp = x->parent;
+      }
+      else {
+        if (!is_red(w->right)) {
+          w->left->red = false;
+          w->red = true;
+          rotate_right(tree, w);
+          w = xp->right;
+        }
+        w->red = xp->red;
+        xp->red = false;
+        w->right->red = false;
+        rotate_left(tree, xp);
+        x = tree->root;
+      }
+    }
+    else {
+      w = xp->left;
+      if (w->red) {
+        w->red = false;
+        xp->red = true;
+        rotate_right(tree, xp);
+        w = xp->left;
+      }
+      if (!is_red(w->right) && !is_red(w->left)) {
+        w->red = true;
+        x = xp;
+        xp = x->parent;
+      }
+      else {
+        if (!is_red(w->left)) {
+          w->right->red = false;
+          w->red = true;
+          rotate_left(tree, w);
+          w = xp->left;
+        }
+        w->red = xp->red;
+        xp->red = false;
+        w->left->red = false;
+        rotate_right(tree, xp);
+        x = tree->root;
+      }
+    }
+  }
+
+  if (x != NULL)
+    x->red = false;
+}
+
+// initialize an empty tree
+int
+rb_init(rb_tree_t *tree)
+{
+  if (tree == NULL)
+    return FAIL;
+
+  tree->root = NULL;
+  tree->nnodes = 0;
+
+  return SUCCESS;
+}
+
+// insert a value into the tree; if it's already there, increment its
+// refcnt
+int
+rb_insert_value(rb_tree_t *tree, int value)
+{
+  rb_node_t *parent = NULL;
+  rb_node_t *n;
+
+  if (tree == NULL)
+    return FAIL;
+
+  // find the place in the tree to insert this value, counting it in
+  // every subtree on the way down
+  n = tree->root;
+  while (n != NULL) {
+    n->count++;
+    if (value == n->value) {
+      n->refcnt++;
+      return SUCCESS;
+    }
+    parent = n;
+    n = (value < n->value) ? n->left : n->right;
+  }
+
+  n = new_rb_node(value);
+  if (n == NULL) {
+    for (; parent != NULL; parent = parent->parent)
+      parent->count--;
+    return FAIL;
+  }
+
+  n->parent = parent;
+  if (parent == NULL)
+    tree->root = n;
+  else if (value < parent->value)
+    parent->left = n;
+  else
+    parent->right = n;
+  tree->nnodes++;
+
+  insert_fixup(tree, n);
+
+  return SUCCESS;
+}
+
+// find a value in the tree if it exists
+//
+// found: *found = address of node containing value, if found
+// found: *found = NULL if value does not exist in tree
+int
+rb_find_value(rb_tree_t *tree, int value, rb_node_t **found)
+{
+  rb_node_t *n;
+
+  // sanity check of params
+  if (tree == NULL || found == NULL)
+    return FAIL;
+
+  n = tree->root;
+  while (n != NULL && n->value != value)
+    n = (value < n->value) ? n->left : n->right;
+
+  *found = n;
+
+  return SUCCESS;
+}
+
+// delete one reference to a value: decrement its refcnt, and remove its
+// node when that gets to 0; fails if the value isn't in the tree
+int
+rb_delete_value(rb_tree_t *tree, int value)
+{
+  rb_node_t *z, *y, *x, *xp;
+  bool       y_red;
+
+  if (rb_find_value(tree, value, &z) != SUCCESS || z == NULL)
+    return FAIL;
+
+  if (--z->refcnt > 0) {
+    // one less value under z and everything above it
+    for (y = z; y != NULL; y = y->parent)
+      y->count--;
+    return SUCCESS;
+  }
+
+  // y is the node that's actually unlinked from its place (z itself,
+  // or z's successor which then takes over z's place and color), x
+  // the node that moves into y's place
+  y = z;
+  y_red = y->red;
+  if (z->left == NULL) {
+    x = z->right;
+    xp = z->parent;
+    transplant(tree, z, z->right);
+  }
+  else if (z->right == NULL) {
+    x = z->left;
+    xp = z->parent;
+    transplant(tree, z, z->left);
+  }
+  else {
+    y = z->right;
+    while (y->left != NULL)
+      y = y->left;
+    y_red = y->red;
+    x = y->right;
+
+    if (y->parent == z) {
+      xp = y;
+    }
+    else {
+      xp = y->parent;
+      transplant(tree, y, y->right);
+      y->right = z->right;
+      y->right->parent = y;
+    }
+    transplant(tree, z, y);
+    y->left = z->left;
+    y->left->parent = y;
+    y->red = z->red;
+  }
+
+  free(z);
+  tree->nnodes--;
+
+  // only the subtrees from where x went up to the root have changed
+  // (y, if it moved, is on that path)
+  for (y = xp; y != NULL; y = y->parent)
+    update_count(y);
+
+  if (!y_red)
+    delete_fixup(tree, x, xp);
+
+  return SUCCESS;
+}
+
+// find the kth smallest value (from 0), counting each value refcnt
+// times
+//
+// found: *found = address of node containing that value
+// found: *found = NULL if k >= the number of values
+int
+rb_select(rb_tree_t *tree, size_t k, rb_node_t **found)
+{
+  rb_node_t *n;
+  size_t     left;
+
+  // sanity check of params
+  if (tree == NULL || found == NULL)
+    return FAIL;
+
+  n = tree->root;
+  while (n != NULL) {
+    left = count_of(n->left);
+    if (k < left) {
+      n = n->left;
+    }
+    else if (k < left + n->refcnt) {
+      break;
+    }
+    else {
+      k -= left + n->refcnt;
+      n = n->right;
+    }
+  }
+
+  *found = n;
+
+  return SUCCESS;
+}
+
+// number of values < value, or <= value if inclusive
+static size_t
+count_below(rb_tree_t *tree, int value, bool inclusive)
+{
+  rb_node_t *n = tree->root;
+  size_t     below = 0;
+
+  while (n != NULL) {
+    if (value < n->value || (value == n->value && !inclusive)) {
+      n = n->left;
+    }
+    else {
+      below += count_of(n->left) + n->refcnt;
+      if (value == n->value)
+        break;
+      n = n->right;
+    }
+  }
+
+  return below;
+}
+
+// rank: *rank = number of values smaller than value (so it's value's
+// index in sorted order if it's there)
+int
+rb_rank(rb_tree_t *tree, int value, size_t *rank)
+{
+  if (tree == NULL || rank == NULL)
+    return FAIL;
+
+  *rank = count_below(tree, value, false);
+
+  return SUCCESS;
+}
+
+// count: *count = number of values in [lo .. hi]
+int
+rb_count_range(rb_tree_t *tree, int lo, int hi, size_t *count)
+{
+  if (tree == NULL || count == NULL)
+    return FAIL;
+
+  *count = (lo > hi) ? 0 :
+    count_below(tree, hi, true) - count_below(tree, lo, false);
+
+  return SUCCESS;
+}
+
+// height of the subtree (number of nodes on its longest path); the
+// recursion is only as deep as the tree, i.e. O(log n)
+static size_t
+rb_height_sub(rb_node_t *n)
+{
+  size_t l, r;
+
+  if (n == NULL)
+    return 0;
+
+  l = rb_height_sub(n->left);
+  r = rb_height_sub(n->right);
+
+  return 1 + ((l > r) ? l : r);
+}
+
+int
+rb_height(rb_tree_t *tree, size_t *height)
+{
+  if (tree == NULL || height == NULL)
+    return FAIL;
+
+  *height = rb_height_sub(tree->root);
+
+  return SUCCESS;
+}
+
+// black height of the subtree, or -1 if it breaks a red-black or
+// search tree property
+static long
+rb_check_sub(rb_node_t *n, rb_node_t *parent, size_t *nnodes)
+{
+  long lh, rh;
+
+  if (n == NULL)
+    return 1;
+
+  (*nnodes)++;
+  if (n->parent != parent || n->refcnt < 1)
+    return -1;
+  if (n->red && (is_red(n->left) || is_red(n->right)))
+    return -1;
+  if ((n->left != NULL && n->left->value >= n->value) ||
+      (n->right != NULL && n->right->value <= n->value))
+    return -1;
+  if (n->count != count_of(n->left) + count_of(n->right) + n->refcnt)
+    return -1;
+
+  lh = rb_check_sub(n->left, n, nnodes);
+  rh = rb_check_sub(n->right, n, nnodes);
+  if (lh < 0 || rh < 0 || lh != rh)
+    return -1;
+
+  return lh + (n->red ? 0 : 1);
+}
+
+// verify the tree: search order, parent links, subtree counts, no red
+// node with a red child, the same number of black nodes on every path,
+// and the count
+int
+rb_check(rb_tree_t *tree)
+{
+  size_t nnodes = 0;
+
+  if (tree == NULL)
+    return FAIL;
+  if (is_red(tree->root))
+    return FAIL;
+  if (rb_check_sub(tree->root, NULL, &nnodes) < 0)
+    return FAIL;
+  if (nnodes != tree->nnodes)
+    return FAIL;
+
+  return SUCCESS;
+}
+
+// free the tree, bottom up along the parent links rather than by
+// recursion
+int
+rb_free_tree(rb_tree_t *tree)
+{
+  rb_node_t *n, *parent;
+
+  if (tree == NULL)
+    return FAIL;
+
+  n = tree->root;
+  while (n != NULL) {
+    if (n->left != NULL) {
+      n = n->left;
+    }
+    else if (n->right != NULL) {
+      n = n->right;
+    }
+    else {
+      // a leaf: unlink it from its parent and free it
+      parent = n->parent;
+      if (parent != NULL) {
+        if (parent->left == n)
+          parent->left = NULL;
+        else
+          parent->right = NULL;
+      }
+      free(n);
+      n = parent;
+    }
+  }
+
+  tree->root = NULL;
+  tree->nnodes = 0;
+
+  return SUCCESS;
+}
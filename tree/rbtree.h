@@ -0,0 +1,52 @@
+//
+// rbtree.h
+//
+// header file for the red-black tree
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// like node_t, plus a parent link, a color, and the number of values in
+// the subtree (counting each node refcnt times) for order statistics
+typedef struct _rb_node_ {
+  int                value;
+  int                refcnt;
+  struct _rb_node_  *left;
+  struct _rb_node_  *right;
+  struct _rb_node_  *parent;
+  size_t             count;
+  bool               red;
+} rb_node_t;
+
+typedef struct {
+  rb_node_t *root;
+  size_t     nnodes;   // distinct values
+} rb_tree_t;
+
+extern int rb_init(rb_tree_t *tree);
+
+extern int rb_insert_value(rb_tree_t *tree, int value);
+
+extern int rb_find_value(rb_tree_t *tree, int value, rb_node_t **found);
+
+extern int rb_delete_value(rb_tree_t *tree, int value);
+
+extern int rb_select(rb_tree_t *tree, size_t k, rb_node_t **found);
+
+extern int rb_rank(rb_tree_t *tree, int value, size_t *rank);
+
+extern int rb_count_range(rb_tree_t *tree, int lo, int hi, size_t *count);
+
+extern int rb_height(rb_tree_t *tree, size_t *height);
+
+extern int rb_check(rb_tree_t *tree);
+
+extern int rb_free_tree(rb_tree_t *tree);
+
+#endif /* RBTREE_H */
@@ -8,19 +8,32 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <stdbool.h>
 
 #include "common.h"
+#include "tree.h"
 #include "queue.h"
+#include "iter.h"
+#include "bench.h"
 
-const bool debug = true;
+// print every insert (the benchmarks turn this off)
+bool debug = true;
+
+// where nodes are allocated from, if not malloc
+arena_t *node_arena = NULL;
 
 // create a new node_t and configure it with input value
 node_t *
 new_node(int value)
 {
-  node_t * n = malloc(sizeof(node_t));
+  node_t * n;
+
+  if (node_arena != NULL)
+    n = arena_alloc(node_arena);
+  else
+    n = malloc(sizeof(node_t));
   if (n == NULL)
     return NULL;
 
@@ -32,6 +45,16 @@ new_node(int value)
   return n;
 }
 
+// free a node_t allocated by new_node
+void
+free_node(node_t *node)
+{
+  if (node_arena != NULL)
+    arena_free(node_arena, node);
+  else
+    free(node);
+}
+
 // copy a node_t (just the contents, not the pointers)
 //
 // function is currently unused
@@ -104,6 +127,63 @@ find_value(node_t *tree, int value, node_t **found)
   return SUCCESS;
 }
 
+// find keys[0 .. n - 1], many at once: a window of FIND_BATCH searches
+// is walked round robin, each going down one level per round and
+// prefetching the node it'll look at next round, so the cache misses of
+// different searches overlap instead of each waiting on the last
+// (asynchronous memory access chaining)
+//
+// results: results[i] = address of node containing keys[i], or NULL
+int
+find_values(node_t *tree, const int *keys, size_t n, node_t **results)
+{
+  node_t *cur[FIND_BATCH];
+  size_t  idx[FIND_BATCH];
+  size_t  next = 0, nslots, nactive, s;
+  node_t *c;
+  int     key;
+
+  // sanity check of params
+  if ((keys == NULL || results == NULL) && n > 0)
+    return FAIL;
+
+  for (nslots = 0; nslots < FIND_BATCH && next < n; nslots++) {
+    idx[nslots] = next++;
+    cur[nslots] = tree;
+  }
+
+  nactive = nslots;
+  while (nactive > 0) {
+    for (s = 0; s < nslots; s++) {
+      if (idx[s] == n)
+        continue;
+
+      c = cur[s];
+      key = keys[idx[s]];
+      if (c == NULL || c->value == key) {
+        // done: start the next search in this slot
+        results[idx[s]] = c;
+        if (next < n) {
+          idx[s] = next++;
+          cur[s] = tree;
+        }
+        else {
+          idx[s] = n;
+          nactive--;
+        }
+        continue;
+      }
+
+      c = (key < c->value) ? c->left : c->right;
+      if (c != NULL)
+        __builtin_prefetch(c);
+      cur[s] = c;
+    }
+  }
+
+  return SUCCESS;
+}
+
 // insert a value into the tree
 int
 insert_value(node_t **tree, int value)
@@ -189,77 +269,88 @@ print_node(node_t *node)
   return SUCCESS;
 }
 
-// print out the tree's values
-int
-print_tree_dfs_prefix(node_t *tree)
+// print out the tree's values in the given order, by a cursor rather
+// than recursion
+static int
+print_tree_order(node_t *tree, tree_order_t order)
 {
-  // base condition of recursion
-  if (!tree)
-    return SUCCESS;
+  tree_iter_t it;
+  node_t     *n;
+  int         ret;
 
-#undef recurse
-#define recurse(X) print_tree_dfs_prefix(X)
+  if (tree_iter_init(&it, tree, order) != SUCCESS)
+    return FAIL;
 
-  print_node(tree);
-  recurse(tree->left);
-  recurse(tree->right);
+  while ((ret = tree_iter_next(&it, &n)) == SUCCESS && n != NULL)
+    print_node(n);
 
-  return SUCCESS;
+  tree_iter_free(&it);
+  return ret;
 }
 
+// print out the tree's values
 int
-print_tree_dfs_postfix(node_t *tree)
+print_tree_dfs_prefix(node_t *tree)
 {
-  // base condition of recursion
-  if (!tree)
-    return SUCCESS;
-
-#undef recurse
-#define recurse(X) print_tree_dfs_postfix(X)
-
-  recurse(tree->left);
-  recurse(tree->right);
-  print_node(tree);
+  return print_tree_order(tree, TREE_PREORDER);
+}
 
-  return SUCCESS;
+int
+print_tree_dfs_postfix(node_t *tree)
+{
+  return print_tree_order(tree, TREE_POSTORDER);
 }
 
 int
 print_tree_dfs_infix(node_t *tree)
 {
-  // base condition of recursion
-  if (!tree)
-    return SUCCESS;
-
-#undef recurse
-#define recurse(X) print_tree_dfs_infix(X)
-
-  recurse(tree->left);
-  print_node(tree);
-  recurse(tree->right);
-
-  return SUCCESS;
+  return print_tree_order(tree, TREE_INORDER);
 }
 
-// recursive subroutine of print_tree_dfs_right_nodes_only_inorder
+// a node on print_tree_dfs_right_nodes_only_inorder's stack, and
+// whether it's its parent's right child
+typedef struct {
+  node_t *node;
+  bool    is_right;
+} right_entry_t;
+
+// subroutine of print_tree_dfs_right_nodes_only_inorder: an in order
+// walk with an explicit stack (which grows as need be), so a
+// degenerate tree can't overflow the call stack
 int print_tree_dfs_right_nodes_only_inorder_sub(node_t *tree, bool is_right)
 {
-  // base condition of recursion
-  if (tree == NULL)
-    return SUCCESS;
+  right_entry_t *stack, *bigger, e;
+  size_t         top = 0, cap = 64;
 
-#undef recurse
-#define recurse(X,Y) print_tree_dfs_right_nodes_only_inorder_sub(X,Y)
+  stack = malloc(cap * sizeof(right_entry_t));
+  if (stack == NULL)
+    return FAIL;
 
-  if (tree->left)
-    recurse(tree->left, false);
+  while (tree != NULL || top > 0) {
+    // go down the left spine, remembering the way back up
+    for (; tree != NULL; tree = tree->left, is_right = false) {
+      if (top == cap) {
+        bigger = realloc(stack, 2 * cap * sizeof(right_entry_t));
+        if (bigger == NULL) {
+          free(stack);
+          return FAIL;
+        }
+        stack = bigger;
+        cap *= 2;
+      }
+      stack[top].node = tree;
+      stack[top++].is_right = is_right;
+    }
 
-  if (is_right)
-    print_node(tree);
+    e = stack[--top];
+    if (e.is_right)
+      print_node(e.node);
 
-  if (tree->right)
-    recurse(tree->right, true);
+    tree = e.node->right;
+    is_right = true;
+  }
 
+  free(stack);
   return SUCCESS;
 }
 
@@ -312,18 +403,27 @@ print_tree_bfs_right_nodes_only(node_t *tree)
 }
 
 
-// free the list
+// free the tree, without recursion or a stack: rotate each left child
+// up until the root has none, then free the root and go on with its
+// right subtree
 int
 free_tree(node_t *tree)
 {
   node_t *tmp;
 
-  if (tree == NULL)
-    return SUCCESS;
-
-  free_tree(tree->left);
-  free_tree(tree->right);
-  free(tree);
+  while (tree != NULL) {
+    if (tree->left != NULL) {
+      tmp = tree->left;
+      tree->left = tmp->right;
+      tmp->right = tree;
+      tree = tmp;
+    }
+    else {
+      tmp = tree->right;
+      free_node(tree);
+      tree = tmp;
+    }
+  }
 
   return SUCCESS;
 }
@@ -374,12 +474,128 @@ test_insert()
 }
 
 
+static void
+usage()
+{
+  printf(
+         "usage:\n\n"
+         "trees\n"
+         "trees -r | -b | -a | -i | -w | -s | -f | -c | -l | -o [-n nvals]\n\n"
+         "with no arguments, runs the insert test\n"
+         "-r benchmarks the red-black tree against the unbalanced tree\n"
+         "on nvals (default 10,000,000) sorted, reverse sorted and random\n"
+         "values\n"
+         "-b benchmarks the B+tree against the unbalanced and red-black\n"
+         "trees on nvals random values\n"
+         "-a benchmarks the arena allocator against malloc for tree and\n"
+         "queue nodes\n"
+         "-i benchmarks the compact index tree against the pointer tree\n"
+         "-w benchmarks the tree cursors, range_scan and lower_bound\n"
+         "-s benchmarks building a balanced tree from sorted values\n"
+         "against inserting them one by one\n"
+         "-f benchmarks lookups in the frozen Eytzinger and vEB layouts\n"
+         "against the tree, at sizes from 32K values up to nvals\n"
+         "(-n 134217728 takes the frozen arrays to 1GB)\n"
+         "-c benchmarks the concurrent tree on mixes of inserts, finds\n"
+         "and deletes from 1 thread to one per cpu\n"
+         "-l benchmarks batched lookups (find_values) against a loop of\n"
+         "find_value\n"
+         "-o benchmarks the red-black tree's order statistics (select,\n"
+         "rank, count in range) against walking the tree\n\n"
+         );
+  exit(-1);
+}
+
 int
 main (int argc, char *argv[])
 {
-  printf("test insert: ");
-  test_insert();
-  printf("\n");
+  size_t nvals = 10000000;
+  bool   do_rb = false;
+  bool   do_bp = false;
+  bool   do_arena = false;
+  bool   do_idx = false;
+  bool   do_iter = false;
+  bool   do_build = false;
+  bool   do_frozen = false;
+  bool   do_conc = false;
+  bool   do_batch = false;
+  bool   do_order = false;
+  int    i;
+
+  if (argc == 1) {
+    printf("test insert: ");
+    test_insert();
+    printf("\n");
 
-  return SUCCESS;
+    return SUCCESS;
+  }
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0) {
+      do_rb = true;
+    }
+    else if (strcmp(argv[i], "-b") == 0) {
+      do_bp = true;
+    }
+    else if (strcmp(argv[i], "-a") == 0) {
+      do_arena = true;
+    }
+    else if (strcmp(argv[i], "-i") == 0) {
+      do_idx = true;
+    }
+    else if (strcmp(argv[i], "-w") == 0) {
+      do_iter = true;
+    }
+    else if (strcmp(argv[i], "-s") == 0) {
+      do_build = true;
+    }
+    else if (strcmp(argv[i], "-f") == 0) {
+      do_frozen = true;
+    }
+    else if (strcmp(argv[i], "-c") == 0) {
+      do_conc = true;
+    }
+    else if (strcmp(argv[i], "-l") == 0) {
+      do_batch = true;
+    }
+    else if (strcmp(argv[i], "-o") == 0) {
+      do_order = true;
+    }
+    else if (strcmp(argv[i], "-n") == 0) {
+      i++;
+      if (i == argc || atol(argv[i]) <= 0)
+        usage();
+      nvals = (size_t) atol(argv[i]);
+    }
+    else {
+      usage();
+    }
+  }
+
+  // the benchmarks insert millions of values
+  debug = false;
+
+  if (do_rb)
+    return rb_bench(nvals);
+  if (do_bp)
+    return bp_bench(nvals);
+  if (do_arena)
+    return arena_bench(nvals);
+  if (do_idx)
+    return idx_bench(nvals);
+  if (do_iter)
+    return iter_bench(nvals);
+  if (do_build)
+    return build_bench(nvals);
+  if (do_frozen)
+    return frozen_bench(nvals);
+  if (do_conc)
+    return conc_bench(nvals);
+  if (do_batch)
+    return batch_bench(nvals);
+  if (do_order)
+    return order_bench(nvals);
+
+  usage();
+  return FAIL;
 }
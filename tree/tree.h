@@ -0,0 +1,43 @@
+//
+// tree.h
+//
+// header file for the unbalanced binary tree in tree.c
+//
+// Copyright (c) 2020, Martin Reames
+//
+
+#ifndef TREE_H
+#define TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "common.h"
+#include "arena.h"
+
+// print every insert (on by default; the benchmarks turn it off)
+extern bool debug;
+
+// if set, nodes come from (and go back to) this arena instead of malloc
+extern arena_t *node_arena;
+
+extern node_t *new_node(int value);
+
+extern void free_node(node_t *node);
+
+extern node_t *tree_search(node_t *tree, int value);
+
+extern int find_value(node_t *tree, int value, node_t **found);
+
+// searches find_values() has going at once
+#define FIND_BATCH 16
+
+extern int find_values(node_t *tree, const int *keys, size_t n,
+                       node_t **results);
+
+extern int insert_value(node_t **tree, int value);
+
+extern int print_node(node_t *node);
+
+extern int free_tree(node_t *tree);
+
+#endif /* TREE_H */